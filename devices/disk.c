@@ -59,6 +59,7 @@ struct disk {
 
 	long long read_cnt;         /* Number of sectors read. */
 	long long write_cnt;        /* Number of sectors written. */
+	bool frozen;                /* Drop writes, see disk_freeze(). */
 };
 
 /* An ATA channel (aka controller).
@@ -134,6 +135,7 @@ disk_init (void) {
 			d->capacity = 0;
 
 			d->read_cnt = d->write_cnt = 0;
+			d->frozen = false;
 		}
 
 		/* Register interrupt handler. */
@@ -238,6 +240,9 @@ disk_write (struct disk *d, disk_sector_t sec_no, const void *buffer) {
 	ASSERT (d != NULL);
 	ASSERT (buffer != NULL);
 
+	if (d->frozen)
+		return;
+
 	c = d->channel;
 	lock_acquire (&c->lock);
 	select_sector (d, sec_no);
@@ -250,6 +255,14 @@ disk_write (struct disk *d, disk_sector_t sec_no, const void *buffer) {
 	lock_release (&c->lock);
 }
 
+/* Makes every later disk_write() to D do nothing, as if the machine
+   lost power.  Used by tests to simulate a crash. */
+void
+disk_freeze (struct disk *d) {
+	ASSERT (d != NULL);
+	d->frozen = true;
+}
+
 /* Disk detection and identification. */
 
 static void print_ata_string (char *string, size_t size);
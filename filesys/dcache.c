@@ -0,0 +1,204 @@
+/* dcache.c: Cache of directory lookups.
+ *
+ * Maps a directory, identified by the sector of its inode, and a
+ * name in it to the inode sector that the name refers to, or to
+ * DCACHE_ABSENT if the directory has no such name.  Opening the
+ * same names again, or probing for names that do not exist, then
+ * skips the directory search.
+ *
+ * dir_lookup() fills the cache and dir_add() and dir_remove() drop
+ * the names they change, all while holding the directory lock, so a
+ * lookup can never insert a result that a concurrent change has
+ * already made stale.  The cache holds DCACHE_SIZE names and evicts
+ * with the clock algorithm, like the buffer cache. */
+
+#include "filesys/dcache.h"
+#include <debug.h>
+#include <hash.h>
+#include <string.h>
+#include "filesys/directory.h"
+#include "threads/interrupt.h"
+#include "threads/synch.h"
+
+/* A cached name. */
+struct dcache_entry {
+	struct hash_elem elem;      /* Element in `names', if VALID. */
+	bool valid;                 /* Holds a name? */
+	bool accessed;              /* Used since the clock hand passed? */
+	disk_sector_t parent;       /* Inode sector of the directory. */
+	disk_sector_t sector;       /* Inode sector of NAME, or
+	                               DCACHE_ABSENT. */
+	char name[NAME_MAX + 1];
+};
+
+static struct dcache_entry entries[DCACHE_SIZE];
+static struct hash names;   /* Valid entries by (PARENT, NAME). */
+static struct lock dcache_lock;
+static size_t clock_hand;
+
+/* Statistics, read by tests via int 0x4a. */
+static long long hit_cnt;
+static long long miss_cnt;
+
+static uint64_t dcache_hash (const struct hash_elem *, void *aux);
+static bool dcache_less (const struct hash_elem *, const struct hash_elem *,
+		void *aux);
+static void register_dcache_inspect_intr (void);
+
+/* Initializes the directory lookup cache. */
+void
+dcache_init (void) {
+	if (!hash_init (&names, dcache_hash, dcache_less, NULL))
+		PANIC ("cannot allocate the directory lookup cache");
+	lock_init (&dcache_lock);
+	register_dcache_inspect_intr ();
+}
+
+/* Returns the valid entry for NAME in directory PARENT, or a null
+ * pointer.  Must be called with dcache_lock held. */
+static struct dcache_entry *
+find (disk_sector_t parent, const char *name) {
+	struct dcache_entry key;
+	struct hash_elem *e;
+
+	if (strlen (name) > NAME_MAX)
+		return NULL;
+	key.parent = parent;
+	strlcpy (key.name, name, sizeof key.name);
+	e = hash_find (&names, &key.elem);
+	return e != NULL ? hash_entry (e, struct dcache_entry, elem) : NULL;
+}
+
+/* Drops entry E from the cache.  Must be called with dcache_lock
+ * held. */
+static void
+drop (struct dcache_entry *e) {
+	hash_delete (&names, &e->elem);
+	e->valid = false;
+}
+
+/* Looks up NAME in directory PARENT.  If the cache knows the
+ * answer, stores the inode sector of NAME, or DCACHE_ABSENT if
+ * there is no such name, in *SECTORP and returns true.  Otherwise
+ * returns false. */
+bool
+dcache_lookup (disk_sector_t parent, const char *name,
+		disk_sector_t *sectorp) {
+	struct dcache_entry *e;
+
+	lock_acquire (&dcache_lock);
+	e = find (parent, name);
+	if (e != NULL) {
+		e->accessed = true;
+		*sectorp = e->sector;
+		hit_cnt++;
+	} else
+		miss_cnt++;
+	lock_release (&dcache_lock);
+	return e != NULL;
+}
+
+/* Records that NAME in directory PARENT refers to the inode in
+ * SECTOR, or that it does not exist if SECTOR is DCACHE_ABSENT. */
+void
+dcache_insert (disk_sector_t parent, const char *name,
+		disk_sector_t sector) {
+	struct dcache_entry *e;
+
+	if (strlen (name) > NAME_MAX)
+		return;
+
+	lock_acquire (&dcache_lock);
+	e = find (parent, name);
+	if (e == NULL) {
+		/* Take the first entry that is free or was not used since
+		 * the hand last passed it. */
+		for (;;) {
+			e = &entries[clock_hand];
+			clock_hand = (clock_hand + 1) % DCACHE_SIZE;
+			if (!e->valid)
+				break;
+			if (!e->accessed) {
+				drop (e);
+				break;
+			}
+			e->accessed = false;
+		}
+		e->parent = parent;
+		strlcpy (e->name, name, sizeof e->name);
+		e->valid = true;
+		hash_insert (&names, &e->elem);
+	}
+	e->sector = sector;
+	e->accessed = true;
+	lock_release (&dcache_lock);
+}
+
+/* Forgets what is known about NAME in directory PARENT. */
+void
+dcache_invalidate (disk_sector_t parent, const char *name) {
+	struct dcache_entry *e;
+
+	lock_acquire (&dcache_lock);
+	e = find (parent, name);
+	if (e != NULL)
+		drop (e);
+	lock_release (&dcache_lock);
+}
+
+/* Forgets every name in directory PARENT, whose inode sector is
+ * about to be freed and may be reused for another directory. */
+void
+dcache_purge (disk_sector_t parent) {
+	size_t i;
+
+	lock_acquire (&dcache_lock);
+	for (i = 0; i < DCACHE_SIZE; i++)
+		if (entries[i].valid && entries[i].parent == parent)
+			drop (&entries[i]);
+	lock_release (&dcache_lock);
+}
+
+static uint64_t
+dcache_hash (const struct hash_elem *e_, void *aux UNUSED) {
+	const struct dcache_entry *e = hash_entry (e_, struct dcache_entry, elem);
+	return hash_string (e->name) ^ hash_int (e->parent);
+}
+
+static bool
+dcache_less (const struct hash_elem *a_, const struct hash_elem *b_,
+		void *aux UNUSED) {
+	const struct dcache_entry *a = hash_entry (a_, struct dcache_entry, elem);
+	const struct dcache_entry *b = hash_entry (b_, struct dcache_entry, elem);
+
+	if (a->parent != b->parent)
+		return a->parent < b->parent;
+	return strcmp (a->name, b->name) < 0;
+}
+
+static void
+inspect_dcache (struct intr_frame *f) {
+	switch (f->R.rdx) {
+		case 0:
+			f->R.rax = hit_cnt;
+			break;
+		case 1:
+			f->R.rax = miss_cnt;
+			break;
+		default:
+			f->R.rax = -1;
+			break;
+	}
+}
+
+/* Tool for testing the directory lookup cache. Calling this function
+ * via int 0x4a.
+ * Input:
+ *   @RDX - 0 for hits, 1 for misses
+ * Output:
+ *   @RAX - The requested count since boot. */
+static void
+register_dcache_inspect_intr (void) {
+	intr_register_int (0x4a, 3, INTR_OFF, inspect_dcache,
+			"Inspect Directory Lookup Cache");
+}
@@ -1,12 +1,21 @@
 #include "filesys/directory.h"
+#include <stdint.h>
 #include <stdio.h>
 #include <string.h>
+#include <hash.h>
 #include <list.h>
+#include <round.h>
+#include "filesys/dcache.h"
 #include "filesys/filesys.h"
+#include "filesys/free-map.h"
 #include "filesys/inode.h"
+#include "filesys/journal.h"
 #include "threads/malloc.h"
 
-/* A directory. */
+/* A directory.
+ * Several `struct dir's may share one inode, so the directory lock
+ * lives in the inode (see inode_lock_dir()); every operation that
+ * reads or changes entries holds it. */
 struct dir {
 	struct inode *inode;                /* Backing store. */
 	off_t pos;                          /* Current position. */
@@ -19,6 +28,41 @@ struct dir_entry {
 	bool in_use;                        /* In use or free? */
 };
 
+/* Directories are a linear array of entries.  Once a directory has
+ * more than DIR_INDEX_THRESHOLD entry slots it also gets a hash
+ * index, kept in a file of its own, so that looking up, adding and
+ * removing a name no longer reads every entry.
+ *
+ * The index file starts with a struct dir_index_header followed by
+ * CAP slots.  A slot holds SLOT_EMPTY, SLOT_REMOVED or 1 plus the
+ * number of an entry.  The entry for a name is found by linear
+ * probing from the slot that the name hashes to.
+ *
+ * An index has at most DIR_INDEX_MAX_CAP slots, so that creating or
+ * growing one fits in an operation of its own (see
+ * dir_update_index()); a directory with more entries than half of
+ * that goes without. */
+#define DIR_INDEX_THRESHOLD 64
+#define DIR_INDEX_MAX_CAP 1024
+#define SLOT_EMPTY 0
+#define SLOT_REMOVED UINT32_MAX
+
+struct dir_index_header {
+	uint32_t cap;                       /* Number of slots, a power of 2. */
+	uint32_t cnt;                       /* Slots that refer to entries. */
+	uint32_t used;                      /* CNT plus SLOT_REMOVED slots. */
+	uint32_t free_hint;                 /* No free entry before this one. */
+};
+
+/* Sectors of the largest index, and the credits of the operation
+ * that updates an index: allocating and writing the index's inode,
+ * filling in the index, pointing the directory's inode at it, and
+ * releasing the index again should that fail. */
+#define INDEX_SECTORS DIV_ROUND_UP (sizeof (struct dir_index_header) \
+		+ DIR_INDEX_MAX_CAP * sizeof (uint32_t), DISK_SECTOR_SIZE)
+#define INDEX_CREDITS (INODE_WRITE_CREDITS (INDEX_SECTORS) \
+		+ INDEX_SECTORS + 4)
+
 /* Creates a directory with space for ENTRY_CNT entries in the
  * given SECTOR.  Returns true if successful, false on failure. */
 bool
@@ -32,6 +76,7 @@ struct dir *
 dir_open (struct inode *inode) {
 	struct dir *dir = calloc (1, sizeof *dir);
 	if (inode != NULL && dir != NULL) {
+		inode_set_metadata (inode);
 		dir->inode = inode;
 		dir->pos = 0;
 		return dir;
@@ -71,6 +116,238 @@ dir_get_inode (struct dir *dir) {
 	return dir->inode;
 }
 
+/* Reads entry number IDX of DIR into *EP.  Returns false at end of
+ * file. */
+static bool
+read_entry (const struct dir *dir, size_t idx, struct dir_entry *ep) {
+	return inode_read_at (dir->inode, ep, sizeof *ep, idx * sizeof *ep)
+		== sizeof *ep;
+}
+
+/* Opens and returns the hash index of DIR, or a null pointer if DIR
+ * has none.  The index is looked up afresh on every operation, since
+ * another `struct dir' for the same inode may have created it. */
+static struct inode *
+index_open (const struct dir *dir) {
+	disk_sector_t sector = inode_get_dir_index (dir->inode);
+	struct inode *index = sector != 0 ? inode_open (sector) : NULL;
+
+	if (index != NULL)
+		inode_set_metadata (index);
+	return index;
+}
+
+static bool
+index_read_header (struct inode *index, struct dir_index_header *h) {
+	return inode_read_at (index, h, sizeof *h, 0) == sizeof *h;
+}
+
+static bool
+index_write_header (struct inode *index, const struct dir_index_header *h) {
+	return inode_write_at (index, h, sizeof *h, 0) == sizeof *h;
+}
+
+/* Returns slot I of INDEX. */
+static uint32_t
+index_get (struct inode *index, uint32_t i) {
+	uint32_t slot = SLOT_EMPTY;
+	inode_read_at (index, &slot, sizeof slot,
+			sizeof (struct dir_index_header) + i * sizeof slot);
+	return slot;
+}
+
+/* Sets slot I of INDEX to SLOT. */
+static bool
+index_set (struct inode *index, uint32_t i, uint32_t slot) {
+	return inode_write_at (index, &slot, sizeof slot,
+			sizeof (struct dir_index_header) + i * sizeof slot) == sizeof slot;
+}
+
+/* Returns the first slot to probe for NAME in an index with header
+ * H. */
+static uint32_t
+index_home (const struct dir_index_header *h, const char *name) {
+	return hash_string (name) & (h->cap - 1);
+}
+
+/* Finds NAME through INDEX, whose header is H.  On success, stores
+ * the entry into *EP, the number of the entry into *IDXP and the
+ * slot that refers to it into *SLOTP. */
+static bool
+index_find (const struct dir *dir, struct inode *index,
+		const struct dir_index_header *h, const char *name,
+		struct dir_entry *ep, size_t *idxp, uint32_t *slotp) {
+	uint32_t i, n;
+
+	for (i = index_home (h, name), n = 0; n < h->cap;
+			i = (i + 1) & (h->cap - 1), n++) {
+		uint32_t slot = index_get (index, i);
+		if (slot == SLOT_EMPTY)
+			break;
+		if (slot == SLOT_REMOVED)
+			continue;
+		if (read_entry (dir, slot - 1, ep) && ep->in_use
+				&& !strcmp (name, ep->name)) {
+			*idxp = slot - 1;
+			*slotp = i;
+			return true;
+		}
+	}
+	return false;
+}
+
+/* Records in INDEX, whose header is H, that entry IDX is named NAME.
+ * NAME must not be in the index yet.  Fails if every slot is in use;
+ * dir_update_index() grows the index long before.  Does not write H
+ * back. */
+static bool
+index_insert (struct inode *index, struct dir_index_header *h,
+		const char *name, size_t idx) {
+	uint32_t i, n;
+
+	for (i = index_home (h, name), n = 0; n < h->cap;
+			i = (i + 1) & (h->cap - 1), n++) {
+		uint32_t slot = index_get (index, i);
+		if (slot == SLOT_EMPTY || slot == SLOT_REMOVED) {
+			if (!index_set (index, i, idx + 1))
+				return false;
+			h->cnt++;
+			if (slot == SLOT_EMPTY)
+				h->used++;
+			return true;
+		}
+	}
+	return false;
+}
+
+/* Rebuilds INDEX of DIR from DIR's entries, with enough slots to be
+ * at most a quarter full but no more than DIR_INDEX_MAX_CAP, and
+ * writes the header H.  Fails, before changing INDEX, if DIR has too
+ * many entries for the index to be at most half full. */
+static bool
+index_rebuild (struct dir *dir, struct inode *index,
+		struct dir_index_header *h) {
+	static const uint32_t zeros[DISK_SECTOR_SIZE / sizeof (uint32_t)];
+	struct dir_entry e;
+	size_t idx, live = 0;
+	off_t ofs, size;
+
+	for (idx = 0; read_entry (dir, idx, &e); idx++)
+		if (e.in_use)
+			live++;
+
+	h->cap = 2 * DIR_INDEX_THRESHOLD;
+	while (h->cap < 4 * live && h->cap < DIR_INDEX_MAX_CAP)
+		h->cap *= 2;
+	if (live * 2 > h->cap)
+		return false;
+	h->cnt = h->used = 0;
+	h->free_hint = UINT32_MAX;
+
+	size = h->cap * sizeof (uint32_t);
+	for (ofs = 0; ofs < size; ofs += sizeof zeros) {
+		off_t chunk = size - ofs < (off_t) sizeof zeros
+			? size - ofs : (off_t) sizeof zeros;
+		if (inode_write_at (index, zeros, chunk, sizeof *h + ofs) != chunk)
+			return false;
+	}
+
+	for (idx = 0; read_entry (dir, idx, &e); idx++)
+		if (e.in_use) {
+			if (!index_insert (index, h, e.name, idx))
+				return false;
+		} else if (h->free_hint == UINT32_MAX)
+			h->free_hint = idx;
+	if (h->free_hint == UINT32_MAX)
+		h->free_hint = idx;
+	return index_write_header (index, h);
+}
+
+/* Removes from INDEX the slot that refers to entry IDX, named NAME,
+ * leaving a SLOT_REMOVED marker so that probes for other names go
+ * on past it. */
+static void
+index_remove (struct inode *index, const char *name, size_t idx) {
+	struct dir_index_header h;
+	uint32_t i, slot;
+
+	if (!index_read_header (index, &h))
+		return;
+	for (i = index_home (&h, name); (slot = index_get (index, i)) != SLOT_EMPTY;
+			i = (i + 1) & (h.cap - 1))
+		if (slot == idx + 1) {
+			if (index_set (index, i, SLOT_REMOVED)) {
+				h.cnt--;
+				if (idx < h.free_hint)
+					h.free_hint = idx;
+				index_write_header (index, &h);
+			}
+			return;
+		}
+}
+
+/* Gives DIR a hash index.  Failing leaves DIR without one, which is
+ * slower but still correct. */
+static void
+index_create (struct dir *dir) {
+	struct dir_index_header h;
+	disk_sector_t sector;
+	struct inode *index;
+
+	if (free_map_allocate_near (inode_get_inumber (dir->inode), 1,
+				&sector) == 0)
+		return;
+	if (!inode_create (sector, 0)) {
+		free_map_release (sector, 1);
+		return;
+	}
+	index = inode_open (sector);
+	if (index != NULL)
+		inode_set_metadata (index);
+	if (index != NULL && index_rebuild (dir, index, &h)) {
+		inode_set_dir_index (dir->inode, sector);
+		inode_close (index);
+		return;
+	}
+	if (index != NULL) {
+		inode_remove (index);
+		inode_close (index);
+	} else
+		free_map_release (sector, 1);
+}
+
+/* Gives DIR a hash index once it has DIR_INDEX_THRESHOLD entry
+ * slots, grows the index once more than half of its slots are in
+ * use, and drops it if it cannot grow any more.  Runs in an
+ * operation of its own, after the one that added an entry, since the
+ * index may take more sectors than the entry.  Failing leaves DIR
+ * without an index, which is slower but still correct. */
+void
+dir_update_index (struct dir *dir) {
+	struct dir_index_header h;
+	struct inode *index;
+	size_t slot_cnt;
+
+	ASSERT (dir != NULL);
+
+	journal_begin (INDEX_CREDITS);
+	inode_lock_dir (dir->inode);
+	index = index_open (dir);
+	slot_cnt = inode_length (dir->inode) / sizeof (struct dir_entry);
+	if (index == NULL) {
+		if (slot_cnt > DIR_INDEX_THRESHOLD
+				&& slot_cnt <= DIR_INDEX_MAX_CAP / 2)
+			index_create (dir);
+	} else if (index_read_header (index, &h) && h.used * 2 > h.cap
+			&& !index_rebuild (dir, index, &h)) {
+		inode_set_dir_index (dir->inode, 0);
+		inode_remove (index);
+	}
+	inode_close (index);
+	inode_unlock_dir (dir->inode);
+	journal_end ();
+}
+
 /* Searches DIR for a file with the given NAME.
  * If successful, returns true, sets *EP to the directory entry
  * if EP is non-null, and sets *OFSP to the byte offset of the
@@ -85,6 +362,23 @@ lookup (const struct dir *dir, const char *name,
 	ASSERT (dir != NULL);
 	ASSERT (name != NULL);
 
+	struct inode *index = index_open (dir);
+	if (index != NULL) {
+		struct dir_index_header h;
+		size_t idx;
+		uint32_t slot;
+		bool found = index_read_header (index, &h)
+			&& index_find (dir, index, &h, name, &e, &idx, &slot);
+		inode_close (index);
+		if (found) {
+			if (ep != NULL)
+				*ep = e;
+			if (ofsp != NULL)
+				*ofsp = idx * sizeof e;
+		}
+		return found;
+	}
+
 	for (ofs = 0; inode_read_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
 			ofs += sizeof e)
 		if (e.in_use && !strcmp (name, e.name)) {
@@ -105,14 +399,21 @@ bool
 dir_lookup (const struct dir *dir, const char *name,
 		struct inode **inode) {
 	struct dir_entry e;
+	disk_sector_t parent, sector;
 
 	ASSERT (dir != NULL);
 	ASSERT (name != NULL);
 
-	if (lookup (dir, name, &e, NULL))
-		*inode = inode_open (e.inode_sector);
-	else
-		*inode = NULL;
+	/* Names looked up before are answered by the cache, including
+	 * names that were not found. */
+	parent = inode_get_inumber (dir->inode);
+	inode_lock_dir (dir->inode);
+	if (!dcache_lookup (parent, name, &sector)) {
+		sector = lookup (dir, name, &e, NULL) ? e.inode_sector : DCACHE_ABSENT;
+		dcache_insert (parent, name, sector);
+	}
+	*inode = sector != DCACHE_ABSENT ? inode_open (sector) : NULL;
+	inode_unlock_dir (dir->inode);
 
 	return *inode != NULL;
 }
@@ -126,6 +427,8 @@ dir_lookup (const struct dir *dir, const char *name,
 bool
 dir_add (struct dir *dir, const char *name, disk_sector_t inode_sector) {
 	struct dir_entry e;
+	struct dir_index_header h;
+	struct inode *index = NULL;
 	off_t ofs;
 	bool success = false;
 
@@ -137,17 +440,23 @@ dir_add (struct dir *dir, const char *name, disk_sector_t inode_sector) {
 		return false;
 
 	/* Check that NAME is not in use. */
+	inode_lock_dir (dir->inode);
 	if (lookup (dir, name, NULL, NULL))
 		goto done;
 
 	/* Set OFS to offset of free slot.
 	 * If there are no free slots, then it will be set to the
-	 * current end-of-file.
+	 * current end-of-file.  An index remembers where the search may
+	 * start.
 
 	 * inode_read_at() will only return a short read at end of file.
 	 * Otherwise, we'd need to verify that we didn't get a short
 	 * read due to something intermittent such as low memory. */
-	for (ofs = 0; inode_read_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
+	index = index_open (dir);
+	if (index != NULL && !index_read_header (index, &h))
+		goto done;
+	for (ofs = index != NULL ? h.free_hint * sizeof e : 0;
+			inode_read_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
 			ofs += sizeof e)
 		if (!e.in_use)
 			break;
@@ -158,15 +467,34 @@ dir_add (struct dir *dir, const char *name, disk_sector_t inode_sector) {
 	e.inode_sector = inode_sector;
 	success = inode_write_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
 
+	/* Keep the index up to date.  An entry it cannot find would
+	 * look absent, so it is erased again if that fails. */
+	if (success && index != NULL) {
+		h.free_hint = ofs / sizeof e + 1;
+		success = index_insert (index, &h, name, ofs / sizeof e)
+			&& index_write_header (index, &h);
+		if (!success) {
+			e.in_use = false;
+			inode_write_at (dir->inode, &e, sizeof e, ofs);
+		}
+	}
+	if (success)
+		dcache_invalidate (inode_get_inumber (dir->inode), name);
+
 done:
+	inode_close (index);
+	inode_unlock_dir (dir->inode);
 	return success;
 }
 
 /* Removes any entry for NAME in DIR.
  * Returns true if successful, false on failure,
- * which occurs only if there is no file with the given NAME. */
+ * which occurs only if there is no file with the given NAME.
+ * On success, sets *INODEP to the removed inode, which the caller
+ * must close once it is outside any operation, since that releases
+ * its sectors; otherwise, sets *INODEP to a null pointer. */
 bool
-dir_remove (struct dir *dir, const char *name) {
+dir_remove (struct dir *dir, const char *name, struct inode **inodep) {
 	struct dir_entry e;
 	struct inode *inode = NULL;
 	bool success = false;
@@ -176,6 +504,7 @@ dir_remove (struct dir *dir, const char *name) {
 	ASSERT (name != NULL);
 
 	/* Find directory entry. */
+	inode_lock_dir (dir->inode);
 	if (!lookup (dir, name, &e, &ofs))
 		goto done;
 
@@ -189,12 +518,29 @@ dir_remove (struct dir *dir, const char *name) {
 	if (inode_write_at (dir->inode, &e, sizeof e, ofs) != sizeof e)
 		goto done;
 
+	/* Drop it from the index. */
+	struct inode *index = index_open (dir);
+	if (index != NULL) {
+		index_remove (index, name, ofs / sizeof e);
+		inode_close (index);
+	}
+
+	/* Forget the name, and the names inside it should it be a
+	 * directory, before its sector can be reused. */
+	dcache_invalidate (inode_get_inumber (dir->inode), name);
+	dcache_purge (e.inode_sector);
+
 	/* Remove inode. */
 	inode_remove (inode);
 	success = true;
 
 done:
-	inode_close (inode);
+	inode_unlock_dir (dir->inode);
+	if (!success) {
+		inode_close (inode);
+		inode = NULL;
+	}
+	*inodep = inode;
 	return success;
 }
 
@@ -204,13 +550,17 @@ done:
 bool
 dir_readdir (struct dir *dir, char name[NAME_MAX + 1]) {
 	struct dir_entry e;
+	bool found = false;
 
+	inode_lock_dir (dir->inode);
 	while (inode_read_at (dir->inode, &e, sizeof e, dir->pos) == sizeof e) {
 		dir->pos += sizeof e;
 		if (e.in_use) {
 			strlcpy (name, e.name, NAME_MAX + 1);
-			return true;
+			found = true;
+			break;
 		}
 	}
-	return false;
+	inode_unlock_dir (dir->inode);
+	return found;
 }
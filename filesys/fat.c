@@ -1,8 +1,12 @@
 #include "filesys/fat.h"
+#include <bitmap.h>
 #include "devices/disk.h"
 #include "filesys/filesys.h"
+#include "filesys/journal.h"
+#include "filesys/page_cache.h"
 #include "threads/malloc.h"
 #include "threads/synch.h"
+#include <stdint.h>
 #include <stdio.h>
 #include <string.h>
 
@@ -16,20 +20,40 @@ struct fat_boot {
 	unsigned int root_dir_cluster;
 };
 
-/* FAT FS */
+/* FAT FS
+ *
+ * The whole FAT is kept in memory.  WRITE_LOCK protects FAT,
+ * LAST_CLST, RELEASED and DIRTY, which has a bit for every FAT sector
+ * changed since the FAT was last written, so that fat_flush() writes
+ * only those.
+ *
+ * Removed clusters keep their FAT entries, and so stay allocated,
+ * until fat_flush() runs as part of a journal commit: before that,
+ * metadata on disk may still refer to them, and they must not be
+ * reused and overwritten.  RELEASED has a bit for each of them. */
 struct fat_fs {
 	struct fat_boot bs;
 	unsigned int *fat;
-	unsigned int fat_length;
-	disk_sector_t data_start;
-	cluster_t last_clst;
+	unsigned int fat_length;    /* Number of clusters, including 0. */
+	disk_sector_t data_start;   /* Sector of cluster 0. */
+	cluster_t last_clst;        /* Where to look for a free cluster. */
 	struct lock write_lock;
+	struct bitmap *released;    /* Removed, not yet free clusters. */
+	struct bitmap *dirty;       /* Changed FAT sectors. */
 };
 
 static struct fat_fs *fat_fs;
 
+/* Number of clusters a chain that cannot grow in place moves ahead
+ * by, so that it has room to keep growing before the next chain in
+ * the same position lands next to it. */
+#define FAT_GROW_WINDOW 8
+
 void fat_boot_create (void);
 void fat_fs_init (void);
+static cluster_t fat_entry (cluster_t clst);
+static void fat_set_entry (cluster_t clst, cluster_t val);
+static cluster_t fat_find_window (void);
 
 void
 fat_init (void) {
@@ -53,6 +77,7 @@ fat_init (void) {
 
 void
 fat_open (void) {
+	free (fat_fs->fat);
 	fat_fs->fat = calloc (fat_fs->fat_length, sizeof (cluster_t));
 	if (fat_fs->fat == NULL)
 		PANIC ("FAT load failed");
@@ -78,8 +103,12 @@ fat_open (void) {
 			free (bounce);
 		}
 	}
+	bitmap_set_all (fat_fs->released, false);
+	bitmap_set_all (fat_fs->dirty, false);
 }
 
+/* Writes the boot sector to disk.  The FAT itself reaches the disk
+ * through the journal, so the last commit must come first. */
 void
 fat_close (void) {
 	// Write FAT boot sector
@@ -89,27 +118,50 @@ fat_close (void) {
 	memcpy (bounce, &fat_fs->bs, sizeof (fat_fs->bs));
 	disk_write (filesys_disk, FAT_BOOT_SECTOR, bounce);
 	free (bounce);
+}
 
-	// Write FAT directly to the disk
-	uint8_t *buffer = (uint8_t *) fat_fs->fat;
-	off_t bytes_wrote = 0;
-	off_t bytes_left = sizeof (fat_fs->fat);
-	const off_t fat_size_in_bytes = fat_fs->fat_length * sizeof (cluster_t);
-	for (unsigned i = 0; i < fat_fs->bs.fat_sectors; i++) {
-		bytes_left = fat_size_in_bytes - bytes_wrote;
-		if (bytes_left >= DISK_SECTOR_SIZE) {
-			disk_write (filesys_disk, fat_fs->bs.fat_start + i,
-			            buffer + bytes_wrote);
-			bytes_wrote += DISK_SECTOR_SIZE;
-		} else {
-			bounce = calloc (1, DISK_SECTOR_SIZE);
-			if (bounce == NULL)
-				PANIC ("FAT close failed");
-			memcpy (bounce, buffer + bytes_wrote, bytes_left);
-			disk_write (filesys_disk, fat_fs->bs.fat_start + i, bounce);
-			bytes_wrote += bytes_left;
-			free (bounce);
+/* Frees the clusters removed since the last call, and writes every
+ * FAT sector that changed since the FAT was read or last written to
+ * the buffer cache, as metadata.  Called by journal commits only.
+ *
+ * Each sector is copied out under the write lock but written after
+ * releasing it, so that nothing that the buffer cache may wait for
+ * has to wait for the lock. */
+void
+fat_flush (void) {
+	static uint8_t sector[DISK_SECTOR_SIZE];
+	off_t fat_size_in_bytes;
+	size_t i = 0;
+
+	/* Nothing to do before the FAT is loaded. */
+	if (fat_fs == NULL || fat_fs->fat == NULL)
+		return;
+	fat_size_in_bytes = fat_fs->fat_length * sizeof (cluster_t);
+
+	lock_acquire (&fat_fs->write_lock);
+	while ((i = bitmap_scan (fat_fs->released, i, 1, true)) != BITMAP_ERROR) {
+		fat_set_entry (i, 0);
+		bitmap_reset (fat_fs->released, i);
+	}
+	lock_release (&fat_fs->write_lock);
+
+	for (i = 0; ; i++) {
+		off_t ofs, size;
+
+		lock_acquire (&fat_fs->write_lock);
+		i = bitmap_scan (fat_fs->dirty, i, 1, true);
+		if (i == BITMAP_ERROR) {
+			lock_release (&fat_fs->write_lock);
+			break;
 		}
+		bitmap_reset (fat_fs->dirty, i);
+		ofs = (off_t) i * DISK_SECTOR_SIZE;
+		size = fat_size_in_bytes - ofs < DISK_SECTOR_SIZE
+			? fat_size_in_bytes - ofs : DISK_SECTOR_SIZE;
+		memcpy (sector, (uint8_t *) fat_fs->fat + ofs, size);
+		lock_release (&fat_fs->write_lock);
+
+		page_cache_write_meta (fat_fs->bs.fat_start + i, sector, 0, size);
 	}
 }
 
@@ -120,13 +172,39 @@ fat_create (void) {
 	fat_fs_init ();
 
 	// Create FAT table
+	free (fat_fs->fat);
 	fat_fs->fat = calloc (fat_fs->fat_length, sizeof (cluster_t));
 	if (fat_fs->fat == NULL)
 		PANIC ("FAT creation failed");
 
+	// Cluster 0 means "no cluster", so it is never handed out
+	fat_put (0, EOChain);
+
 	// Set up ROOT_DIR_CLST
 	fat_put (ROOT_DIR_CLUSTER, EOChain);
 
+	// Write the whole FAT directly, since nothing on disk refers to
+	// it yet and it may not fit into one journal transaction.
+	uint8_t *buffer = (uint8_t *) fat_fs->fat;
+	const off_t fat_size_in_bytes = fat_fs->fat_length * sizeof (cluster_t);
+	uint8_t *bounce = calloc (1, DISK_SECTOR_SIZE);
+	if (bounce == NULL)
+		PANIC ("FAT creation failed");
+	for (unsigned i = 0; i < fat_fs->bs.fat_sectors; i++) {
+		off_t ofs = (off_t) i * DISK_SECTOR_SIZE;
+		off_t size = fat_size_in_bytes - ofs;
+		if (size >= DISK_SECTOR_SIZE)
+			disk_write (filesys_disk, fat_fs->bs.fat_start + i, buffer + ofs);
+		else {
+			memset (bounce, 0, DISK_SECTOR_SIZE);
+			if (size > 0)
+				memcpy (bounce, buffer + ofs, size);
+			disk_write (filesys_disk, fat_fs->bs.fat_start + i, bounce);
+		}
+	}
+	free (bounce);
+	bitmap_set_all (fat_fs->dirty, false);
+
 	// Fill up ROOT_DIR_CLUSTER region with 0
 	uint8_t *buf = calloc (1, DISK_SECTOR_SIZE);
 	if (buf == NULL)
@@ -144,7 +222,7 @@ fat_boot_create (void) {
 	    .magic = FAT_MAGIC,
 	    .sectors_per_cluster = SECTORS_PER_CLUSTER,
 	    .total_sectors = disk_size (filesys_disk),
-	    .fat_start = 1,
+	    .fat_start = JOURNAL_SECTOR + JOURNAL_SECTORS,
 	    .fat_sectors = fat_sectors,
 	    .root_dir_cluster = ROOT_DIR_CLUSTER,
 	};
@@ -152,42 +230,310 @@ fat_boot_create (void) {
 
 void
 fat_fs_init (void) {
-	/* TODO: Your code goes here. */
+	fat_fs->data_start = fat_fs->bs.fat_start + fat_fs->bs.fat_sectors;
+	fat_fs->fat_length = (fat_fs->bs.total_sectors - fat_fs->data_start)
+		/ SECTORS_PER_CLUSTER;
+	fat_fs->last_clst = ROOT_DIR_CLUSTER + 1;
+	lock_init (&fat_fs->write_lock);
+
+	if (fat_fs->dirty != NULL)
+		bitmap_destroy (fat_fs->dirty);
+	fat_fs->dirty = bitmap_create (fat_fs->bs.fat_sectors);
+	if (fat_fs->released != NULL)
+		bitmap_destroy (fat_fs->released);
+	fat_fs->released = bitmap_create (fat_fs->fat_length);
+	if (fat_fs->dirty == NULL || fat_fs->released == NULL)
+		PANIC ("FAT init failed");
 }
 
 /*----------------------------------------------------------------------------*/
 /* FAT handling                                                               */
 /*----------------------------------------------------------------------------*/
 
+/* Returns the FAT entry of CLST.  The write lock must be held. */
+static cluster_t
+fat_entry (cluster_t clst) {
+	ASSERT (clst < fat_fs->fat_length);
+	return fat_fs->fat[clst];
+}
+
+/* Sets the FAT entry of CLST to VAL and marks its FAT sector dirty.
+ * The write lock must be held. */
+static void
+fat_set_entry (cluster_t clst, cluster_t val) {
+	ASSERT (clst < fat_fs->fat_length);
+	fat_fs->fat[clst] = val;
+	bitmap_mark (fat_fs->dirty, clst * sizeof (cluster_t) / DISK_SECTOR_SIZE);
+}
+
 /* Add a cluster to the chain.
  * If CLST is 0, start a new chain.
- * Returns 0 if fails to allocate a new cluster. */
+ * Returns 0 if fails to allocate a new cluster.
+ * The cluster right after CLST is taken if it is free, so that the
+ * chain stays contiguous.  If another chain took it, the chain moves
+ * to a window of free clusters instead, so that chains growing at
+ * the same time do not interleave.  Otherwise the search for a free
+ * cluster starts where the previous one ended, so allocation does
+ * not rescan the used start of the FAT.  The new cluster is filled
+ * with zeros. */
 cluster_t
 fat_create_chain (cluster_t clst) {
-	/* TODO: Your code goes here. */
+	static char zeros[DISK_SECTOR_SIZE];
+	cluster_t new = 0;
+	unsigned int i;
+
+	lock_acquire (&fat_fs->write_lock);
+	if (clst != 0 && clst + 1 < fat_fs->fat_length && fat_entry (clst + 1) == 0)
+		new = clst + 1;
+	else if (clst != 0)
+		new = fat_find_window ();
+	for (i = 1; new == 0 && i < fat_fs->fat_length; i++) {
+		cluster_t c = fat_fs->last_clst;
+		fat_fs->last_clst = c + 1 < fat_fs->fat_length ? c + 1 : 1;
+		if (fat_entry (c) == 0) {
+			new = c;
+			break;
+		}
+	}
+	if (new != 0) {
+		fat_set_entry (new, EOChain);
+		if (clst != 0)
+			fat_set_entry (clst, new);
+	}
+	lock_release (&fat_fs->write_lock);
+
+	if (new != 0)
+		for (i = 0; i < SECTORS_PER_CLUSTER; i++)
+			page_cache_write (cluster_to_sector (new) + i, zeros, 0,
+					DISK_SECTOR_SIZE);
+	return new;
+}
+
+/* Returns the first cluster of a run of FAT_GROW_WINDOW free
+ * clusters at or after LAST_CLST, wrapping around once, and moves
+ * LAST_CLST past the run.  Returns 0 if there is no such run.  The
+ * write lock must be held. */
+static cluster_t
+fat_find_window (void) {
+	cluster_t c = fat_fs->last_clst;
+	unsigned int i, run = 0;
+
+	for (i = 1; i < fat_fs->fat_length; i++) {
+		if (c == 1)
+			run = 0;
+		if (fat_entry (c) != 0)
+			run = 0;
+		else if (++run == FAT_GROW_WINDOW) {
+			c -= FAT_GROW_WINDOW - 1;
+			fat_fs->last_clst = c + FAT_GROW_WINDOW < fat_fs->fat_length
+				? c + FAT_GROW_WINDOW : 1;
+			return c;
+		}
+		c = c + 1 < fat_fs->fat_length ? c + 1 : 1;
+	}
+	return 0;
+}
+
+/* Releases up to CNT clusters of a chain, starting from CLST, and
+ * marks their FAT sectors dirty, since the next commit frees them.
+ * Returns the cluster that follows them.  The write lock must be
+ * held. */
+static cluster_t
+release_clusters (cluster_t clst, size_t cnt) {
+	for (; cnt > 0 && clst != 0 && clst != EOChain; cnt--) {
+		ASSERT (!bitmap_test (fat_fs->released, clst));
+		bitmap_mark (fat_fs->released, clst);
+		bitmap_mark (fat_fs->dirty,
+				clst * sizeof (cluster_t) / DISK_SECTOR_SIZE);
+		clst = fat_entry (clst);
+	}
+	return clst;
 }
 
 /* Remove the chain of clusters starting from CLST.
- * If PCLST is 0, assume CLST as the start of the chain. */
+ * If PCLST is 0, assume CLST as the start of the chain.
+ * The clusters become free when the journal next commits. */
 void
 fat_remove_chain (cluster_t clst, cluster_t pclst) {
-	/* TODO: Your code goes here. */
+	lock_acquire (&fat_fs->write_lock);
+	if (pclst != 0)
+		fat_set_entry (pclst, EOChain);
+	release_clusters (clst, SIZE_MAX);
+	lock_release (&fat_fs->write_lock);
+}
+
+/* Removes the first CNT clusters, or all if there are fewer, of the
+ * chain that starts at CLST, and returns the cluster that follows
+ * them, 0 or EOChain if none does.  The FAT entries of the removed
+ * clusters are cleared when the journal next commits, so the caller
+ * must remember where the rest of the chain starts. */
+cluster_t
+fat_remove_chain_part (cluster_t clst, size_t cnt) {
+	lock_acquire (&fat_fs->write_lock);
+	clst = release_clusters (clst, cnt);
+	lock_release (&fat_fs->write_lock);
+	return clst;
+}
+
+/* Returns the number of FAT sectors that the next commit writes. */
+size_t
+fat_dirty_cnt (void) {
+	size_t cnt;
+
+	if (fat_fs == NULL || fat_fs->dirty == NULL)
+		return 0;
+	lock_acquire (&fat_fs->write_lock);
+	cnt = bitmap_count (fat_fs->dirty, 0, bitmap_size (fat_fs->dirty), true);
+	lock_release (&fat_fs->write_lock);
+	return cnt;
 }
 
 /* Update a value in the FAT table. */
 void
 fat_put (cluster_t clst, cluster_t val) {
-	/* TODO: Your code goes here. */
+	lock_acquire (&fat_fs->write_lock);
+	fat_set_entry (clst, val);
+	lock_release (&fat_fs->write_lock);
 }
 
 /* Fetch a value in the FAT table. */
 cluster_t
 fat_get (cluster_t clst) {
-	/* TODO: Your code goes here. */
+	lock_acquire (&fat_fs->write_lock);
+	cluster_t val = fat_entry (clst);
+	lock_release (&fat_fs->write_lock);
+	return val;
+}
+
+/* Stores the number of free clusters into *FREE_CNT, the number of
+ * runs they form into *EXTENT_CNT and the length of the longest run
+ * into *LARGEST. */
+void
+fat_stats (size_t *free_cnt, size_t *extent_cnt, size_t *largest) {
+	size_t run = 0;
+	cluster_t c;
+
+	*free_cnt = *extent_cnt = *largest = 0;
+	lock_acquire (&fat_fs->write_lock);
+	for (c = 1; c < fat_fs->fat_length; c++) {
+		if (fat_entry (c) != 0) {
+			run = 0;
+			continue;
+		}
+		if (run++ == 0)
+			++*extent_cnt;
+		++*free_cnt;
+		if (run > *largest)
+			*largest = run;
+	}
+	lock_release (&fat_fs->write_lock);
 }
 
 /* Covert a cluster # to a sector number. */
 disk_sector_t
 cluster_to_sector (cluster_t clst) {
-	/* TODO: Your code goes here. */
+	ASSERT (clst < fat_fs->fat_length);
+	return fat_fs->data_start + clst * SECTORS_PER_CLUSTER;
+}
+
+/* Converts SECTOR, which must be in the data area, to the number of
+ * the cluster that contains it. */
+cluster_t
+sector_to_cluster (disk_sector_t sector) {
+	ASSERT (sector >= fat_fs->data_start);
+	return (sector - fat_fs->data_start) / SECTORS_PER_CLUSTER;
+}
+
+/*----------------------------------------------------------------------------*/
+/* Chain position cache                                                       */
+/*----------------------------------------------------------------------------*/
+
+/* Initializes CHAIN for the chain that starts at START, 0 if the
+ * chain is still empty. */
+void
+fat_chain_init (struct fat_chain *chain, cluster_t start) {
+	chain->start = start;
+	chain->marks = NULL;
+	chain->mark_cnt = 0;
+	chain->mark_cap = 0;
+	chain->last_pos = 0;
+	chain->last_clst = start;
+	lock_init (&chain->lock);
+}
+
+/* Frees the memory held by CHAIN, but not the chain itself. */
+void
+fat_chain_destroy (struct fat_chain *chain) {
+	free (chain->marks);
+	chain->marks = NULL;
+	chain->mark_cnt = chain->mark_cap = 0;
+}
+
+/* Remembers CLST as the cluster at the next multiple of
+ * FAT_CHAIN_STRIDE.  Forgetting it when out of memory only makes
+ * later lookups slower. */
+static void
+chain_add_mark (struct fat_chain *chain, cluster_t clst) {
+	if (chain->mark_cnt == chain->mark_cap) {
+		size_t cap = chain->mark_cap ? 2 * chain->mark_cap : 8;
+		cluster_t *marks = realloc (chain->marks, cap * sizeof *marks);
+		if (marks == NULL)
+			return;
+		chain->marks = marks;
+		chain->mark_cap = cap;
+	}
+	chain->marks[chain->mark_cnt++] = clst;
+}
+
+/* Returns the cluster at position POS of CHAIN, counting from 0.
+ * If the chain is shorter, returns 0, unless CREATE, in which case
+ * the chain is first extended with zeroed clusters up to POS; then
+ * 0 means that the disk is full.  The walk starts at the closest
+ * remembered position at or before POS, which is the previous lookup
+ * for sequential access. */
+cluster_t
+fat_chain_get (struct fat_chain *chain, size_t pos, bool create) {
+	size_t cur, m;
+	cluster_t clst;
+
+	lock_acquire (&chain->lock);
+	if (chain->start == 0) {
+		if (create)
+			chain->start = chain->last_clst = fat_create_chain (0);
+		if (chain->start == 0) {
+			lock_release (&chain->lock);
+			return 0;
+		}
+	}
+
+	m = pos / FAT_CHAIN_STRIDE;
+	if (m > chain->mark_cnt)
+		m = chain->mark_cnt;
+	cur = m * FAT_CHAIN_STRIDE;
+	clst = m == 0 ? chain->start : chain->marks[m - 1];
+	if (chain->last_pos <= pos && chain->last_pos > cur) {
+		cur = chain->last_pos;
+		clst = chain->last_clst;
+	}
+
+	while (cur < pos) {
+		cluster_t next = fat_get (clst);
+		if (next == EOChain) {
+			if (!create || (next = fat_create_chain (clst)) == 0) {
+				clst = 0;
+				break;
+			}
+		}
+		clst = next;
+		cur++;
+		if (cur % FAT_CHAIN_STRIDE == 0
+				&& cur / FAT_CHAIN_STRIDE == chain->mark_cnt + 1)
+			chain_add_mark (chain, clst);
+	}
+	if (clst != 0) {
+		chain->last_pos = cur;
+		chain->last_clst = clst;
+	}
+	lock_release (&chain->lock);
+	return clst;
 }
@@ -1,15 +1,32 @@
 #include "filesys/file.h"
 #include <debug.h>
 #include "filesys/inode.h"
+#include "filesys/pipe.h"
 #include "threads/malloc.h"
+#include "devices/disk.h"
+
+/* Read-ahead window bounds, in sectors.  The window starts at
+ * RA_MIN_SECTORS when a sequential read is detected and doubles
+ * with every further sequential read, up to RA_MAX_SECTORS. */
+#define RA_MIN_SECTORS 4
+#define RA_MAX_SECTORS 16
 
 /* An open file. */
 struct file {
 	struct inode *inode;        /* File's inode. */
 	off_t pos;                  /* Current position. */
 	bool deny_write;            /* Has file_deny_write() been called? */
+	int ref_cnt;                /* Number of references, see file_ref(). */
+	struct pipe *pipe;          /* Pipe this is an end of, or NULL. */
+	bool pipe_writer;           /* Write end rather than read end? */
+	off_t ra_next;              /* Offset a sequential read starts at. */
+	off_t ra_end;               /* End of the range already read ahead. */
+	int ra_window;              /* Read-ahead window in sectors, 0 if
+	                               the last read was not sequential. */
 };
 
+static void file_read_ahead (struct file *, off_t ofs, off_t size);
+
 /* Opens a file for the given INODE, of which it takes ownership,
  * and returns the new file.  Returns a null pointer if an
  * allocation fails or if INODE is null. */
@@ -20,6 +37,7 @@ file_open (struct inode *inode) {
 		file->inode = inode;
 		file->pos = 0;
 		file->deny_write = false;
+		file->ref_cnt = 1;
 		return file;
 	} else {
 		inode_close (inode);
@@ -28,10 +46,39 @@ file_open (struct inode *inode) {
 	}
 }
 
+/* Opens and returns a new read end, or write end if WRITER, of
+ * PIPE.  Returns a null pointer if an allocation fails. */
+struct file *
+file_open_pipe (struct pipe *pipe, bool writer) {
+	struct file *file = calloc (1, sizeof *file);
+	if (file != NULL) {
+		file->ref_cnt = 1;
+		file->pipe = pipe;
+		file->pipe_writer = writer;
+		pipe_attach (pipe, writer);
+	}
+	return file;
+}
+
+/* Returns the pipe FILE is an end of, or a null pointer if FILE is
+ * not a pipe end. */
+struct pipe *
+file_get_pipe (struct file *file) {
+	return file->pipe;
+}
+
+/* Returns true if FILE is the write end of a pipe. */
+bool
+file_is_pipe_writer (struct file *file) {
+	return file->pipe != NULL && file->pipe_writer;
+}
+
 /* Opens and returns a new file for the same inode as FILE.
  * Returns a null pointer if unsuccessful. */
 struct file *
 file_reopen (struct file *file) {
+	if (file->pipe != NULL)
+		return file_open_pipe (file->pipe, file->pipe_writer);
 	return file_open (inode_reopen (file->inode));
 }
 
@@ -39,6 +86,8 @@ file_reopen (struct file *file) {
  * same inode as FILE. Returns a null pointer if unsuccessful. */
 struct file *
 file_duplicate (struct file *file) {
+	if (file->pipe != NULL)
+		return file_reopen (file);
 	struct file *nfile = file_open (inode_reopen (file->inode));
 	if (nfile) {
 		nfile->pos = file->pos;
@@ -48,14 +97,33 @@ file_duplicate (struct file *file) {
 	return nfile;
 }
 
-/* Closes FILE. */
+/* Adds a reference to FILE, so that it stays open, sharing its
+ * position, until file_close() has been called once more than
+ * file_ref().  Returns FILE. */
+struct file *
+file_ref (struct file *file) {
+	file->ref_cnt++;
+	return file;
+}
+
+/* Returns the number of references to FILE. */
+int
+file_ref_cnt (struct file *file) {
+	return file->ref_cnt;
+}
+
+/* Drops a reference to FILE and closes it if that was the last. */
 void
 file_close (struct file *file) {
-	if (file != NULL) {
+	if (file == NULL || --file->ref_cnt > 0)
+		return;
+	if (file->pipe != NULL)
+		pipe_detach (file->pipe, file->pipe_writer);
+	else {
 		file_allow_write (file);
 		inode_close (file->inode);
-		free (file);
 	}
+	free (file);
 }
 
 /* Returns the inode encapsulated by FILE. */
@@ -71,11 +139,43 @@ file_get_inode (struct file *file) {
  * Advances FILE's position by the number of bytes read. */
 off_t
 file_read (struct file *file, void *buffer, off_t size) {
+	if (file->pipe != NULL)
+		return file->pipe_writer ? -1 : pipe_read (file->pipe, buffer, size);
 	off_t bytes_read = inode_read_at (file->inode, buffer, size, file->pos);
+	file_read_ahead (file, file->pos, bytes_read);
 	file->pos += bytes_read;
 	return bytes_read;
 }
 
+/* Updates FILE's read-ahead state after a read of SIZE bytes at OFS
+ * and, if reads of FILE look sequential, starts reading the next
+ * window of sectors into the buffer cache.  A read that starts where
+ * the previous one ended grows the window; any other read collapses
+ * it, so random access does not pay for sectors it never uses. */
+static void
+file_read_ahead (struct file *file, off_t ofs, off_t size) {
+	if (size > 0 && ofs == file->ra_next) {
+		if (file->ra_window == 0)
+			file->ra_window = RA_MIN_SECTORS;
+		else if (file->ra_window < RA_MAX_SECTORS)
+			file->ra_window *= 2;
+	} else {
+		file->ra_window = 0;
+		file->ra_end = 0;
+	}
+	file->ra_next = ofs + size;
+	if (file->ra_window == 0)
+		return;
+
+	/* Only ask for what earlier read-ahead has not covered yet. */
+	off_t start = file->ra_end > file->ra_next ? file->ra_end : file->ra_next;
+	off_t end = file->ra_next + file->ra_window * DISK_SECTOR_SIZE;
+	if (start < end) {
+		inode_read_ahead (file->inode, start, end - start);
+		file->ra_end = end;
+	}
+}
+
 /* Reads SIZE bytes from FILE into BUFFER,
  * starting at offset FILE_OFS in the file.
  * Returns the number of bytes actually read,
@@ -83,18 +183,21 @@ file_read (struct file *file, void *buffer, off_t size) {
  * The file's current position is unaffected. */
 off_t
 file_read_at (struct file *file, void *buffer, off_t size, off_t file_ofs) {
+	if (file->pipe != NULL)
+		return -1;
 	return inode_read_at (file->inode, buffer, size, file_ofs);
 }
 
 /* Writes SIZE bytes from BUFFER into FILE,
  * starting at the file's current position.
  * Returns the number of bytes actually written,
- * which may be less than SIZE if end of file is reached.
- * (Normally we'd grow the file in that case, but file growth is
- * not yet implemented.)
+ * which may be less than SIZE if the disk is full.
+ * Writing past end of file grows the file.
  * Advances FILE's position by the number of bytes read. */
 off_t
 file_write (struct file *file, const void *buffer, off_t size) {
+	if (file->pipe != NULL)
+		return file->pipe_writer ? pipe_write (file->pipe, buffer, size) : -1;
 	off_t bytes_written = inode_write_at (file->inode, buffer, size, file->pos);
 	file->pos += bytes_written;
 	return bytes_written;
@@ -103,16 +206,69 @@ file_write (struct file *file, const void *buffer, off_t size) {
 /* Writes SIZE bytes from BUFFER into FILE,
  * starting at offset FILE_OFS in the file.
  * Returns the number of bytes actually written,
- * which may be less than SIZE if end of file is reached.
- * (Normally we'd grow the file in that case, but file growth is
- * not yet implemented.)
+ * which may be less than SIZE if the disk is full.
+ * Writing past end of file grows the file.
  * The file's current position is unaffected. */
 off_t
 file_write_at (struct file *file, const void *buffer, off_t size,
 		off_t file_ofs) {
+	if (file->pipe != NULL)
+		return -1;
 	return inode_write_at (file->inode, buffer, size, file_ofs);
 }
 
+/* Reads from FILE into the IOVCNT segments of IOV, in order,
+ * starting at the file's current position.
+ * Returns the number of bytes actually read and advances FILE's
+ * position by that amount. */
+off_t
+file_readv (struct file *file, const struct iovec *iov, int iovcnt) {
+	if (file->pipe != NULL)
+		return file->pipe_writer ? -1 : pipe_readv (file->pipe, iov, iovcnt);
+	off_t bytes_read = inode_readv_at (file->inode, iov, iovcnt, file->pos);
+	file_read_ahead (file, file->pos, bytes_read);
+	file->pos += bytes_read;
+	return bytes_read;
+}
+
+/* Reads from FILE into the IOVCNT segments of IOV, in order,
+ * starting at offset FILE_OFS in the file.
+ * Returns the number of bytes actually read.
+ * The file's current position is unaffected. */
+off_t
+file_readv_at (struct file *file, const struct iovec *iov, int iovcnt,
+		off_t file_ofs) {
+	if (file->pipe != NULL)
+		return -1;
+	return inode_readv_at (file->inode, iov, iovcnt, file_ofs);
+}
+
+/* Writes the IOVCNT segments of IOV, in order, into FILE
+ * starting at the file's current position.
+ * Returns the number of bytes actually written and advances
+ * FILE's position by that amount. */
+off_t
+file_writev (struct file *file, const struct iovec *iov, int iovcnt) {
+	if (file->pipe != NULL)
+		return file->pipe_writer ? pipe_writev (file->pipe, iov, iovcnt) : -1;
+	off_t bytes_written = inode_writev_at (file->inode, iov, iovcnt,
+			file->pos);
+	file->pos += bytes_written;
+	return bytes_written;
+}
+
+/* Writes the IOVCNT segments of IOV, in order, into FILE
+ * starting at offset FILE_OFS in the file.
+ * Returns the number of bytes actually written.
+ * The file's current position is unaffected. */
+off_t
+file_writev_at (struct file *file, const struct iovec *iov, int iovcnt,
+		off_t file_ofs) {
+	if (file->pipe != NULL)
+		return -1;
+	return inode_writev_at (file->inode, iov, iovcnt, file_ofs);
+}
+
 /* Prevents write operations on FILE's underlying inode
  * until file_allow_write() is called or FILE is closed. */
 void
@@ -136,10 +292,13 @@ file_allow_write (struct file *file) {
 	}
 }
 
-/* Returns the size of FILE in bytes. */
+/* Returns the size of FILE in bytes, or -1 if FILE is a pipe
+ * end. */
 off_t
 file_length (struct file *file) {
 	ASSERT (file != NULL);
+	if (file->pipe != NULL)
+		return -1;
 	return inode_length (file->inode);
 }
 
@@ -2,11 +2,17 @@
 #include <debug.h>
 #include <stdio.h>
 #include <string.h>
+#include "filesys/dcache.h"
 #include "filesys/file.h"
 #include "filesys/free-map.h"
 #include "filesys/inode.h"
+#include "filesys/journal.h"
 #include "filesys/directory.h"
+#include "filesys/page_cache.h"
 #include "devices/disk.h"
+#ifdef USERPROG
+#include "userprog/process.h"
+#endif
 
 /* The disk that contains the file system. */
 struct disk *filesys_disk;
@@ -21,7 +27,14 @@ filesys_init (bool format) {
 	if (filesys_disk == NULL)
 		PANIC ("hd0:1 (hdb) not present, file system initialization failed");
 
+	page_cache_init ();
+	journal_init ();
 	inode_init ();
+	dcache_init ();
+
+	/* Finish the last transaction before anything reads the disk. */
+	if (!format)
+		journal_recover ();
 
 #ifdef EFILESYS
 	fat_init ();
@@ -45,14 +58,30 @@ filesys_init (bool format) {
  * to disk. */
 void
 filesys_done (void) {
+#ifdef USERPROG
+	/* Close the executables the exec cache holds open, so that
+	 * removed ones release their sectors. */
+	exec_cache_flush ();
+#endif
+	/* The last commit also writes the free map or the FAT. */
+	journal_commit ();
 	/* Original FS */
 #ifdef EFILESYS
 	fat_close ();
 #else
 	free_map_close ();
 #endif
+	page_cache_flush ();
 }
 
+/* Credits of the operations below (see journal.c).  Creating a file
+ * allocates and writes its inode, writes its directory entry, which
+ * may straddle two sectors past the directory's end, and sets a slot
+ * and the header of the directory's index.  Removing one erases the
+ * entry and sets the same two index sectors. */
+#define CREATE_CREDITS (2 + INODE_WRITE_CREDITS (2) + 2)
+#define REMOVE_CREDITS (INODE_WRITE_CREDITS (2) + 2)
+
 /* Creates a file named NAME with the given INITIAL_SIZE.
  * Returns true if successful, false otherwise.
  * Fails if a file named NAME already exists,
@@ -61,12 +90,31 @@ bool
 filesys_create (const char *name, off_t initial_size) {
 	disk_sector_t inode_sector = 0;
 	struct dir *dir = dir_open_root ();
-	bool success = (dir != NULL
-			&& free_map_allocate (1, &inode_sector)
-			&& inode_create (inode_sector, initial_size)
+	bool success;
+
+	/* Files of a directory are kept close to it. */
+	journal_begin (CREATE_CREDITS);
+	success = (dir != NULL
+			&& free_map_allocate_near (
+				inode_get_inumber (dir_get_inode (dir)), 1, &inode_sector)
+			&& inode_create (inode_sector, 0)
 			&& dir_add (dir, name, inode_sector));
 	if (!success && inode_sector != 0)
 		free_map_release (inode_sector, 1);
+	journal_end ();
+
+	/* The directory's index and the file's initial size take
+	 * operations of their own. */
+	if (success) {
+		dir_update_index (dir);
+		if (initial_size > 0) {
+			struct inode *inode = inode_open (inode_sector);
+			success = inode != NULL && inode_extend (inode, initial_size);
+			inode_close (inode);
+			if (!success)
+				filesys_remove (name);
+		}
+	}
 	dir_close (dir);
 
 	return success;
@@ -96,9 +144,17 @@ filesys_open (const char *name) {
 bool
 filesys_remove (const char *name) {
 	struct dir *dir = dir_open_root ();
-	bool success = dir != NULL && dir_remove (dir, name);
+	struct inode *inode = NULL;
+	bool success;
+
+	journal_begin (REMOVE_CREDITS);
+	success = dir != NULL && dir_remove (dir, name, &inode);
+	journal_end ();
 	dir_close (dir);
 
+	/* Releases the file's sectors, unless it is still open. */
+	inode_close (inode);
+
 	return success;
 }
 
@@ -106,15 +162,20 @@ filesys_remove (const char *name) {
 static void
 do_format (void) {
 	printf ("Formatting file system...");
+	journal_create ();
 
 #ifdef EFILESYS
-	/* Create FAT and save it to the disk. */
+	/* Create FAT and the root directory and save them to the disk. */
 	fat_create ();
+	if (!dir_create (ROOT_DIR_SECTOR, 16))
+		PANIC ("root directory creation failed");
+	journal_commit ();
 	fat_close ();
 #else
 	free_map_create ();
 	if (!dir_create (ROOT_DIR_SECTOR, 16))
 		PANIC ("root directory creation failed");
+	journal_commit ();
 	free_map_close ();
 #endif
 
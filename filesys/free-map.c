@@ -1,12 +1,46 @@
 #include "filesys/free-map.h"
 #include <bitmap.h>
 #include <debug.h>
+#include <round.h>
 #include "filesys/file.h"
 #include "filesys/filesys.h"
 #include "filesys/inode.h"
+#include "filesys/journal.h"
+#include "threads/synch.h"
+#ifdef EFILESYS
+#include "filesys/fat.h"
+#endif
 
+/* Number of free map bits stored in one sector of its file. */
+#define BITS_PER_SECTOR (DISK_SECTOR_SIZE * 8)
+
+/* The free map lives in memory.  Changes only mark the sectors of
+ * the free map file that hold the changed bits dirty, and
+ * free_map_flush() writes those sectors when the journal commits
+ * (see journal.c).
+ *
+ * Released sectors are not free at once.  Until the transaction that
+ * releases them commits, the metadata on disk may still refer to
+ * them, so they must not be reused and overwritten.  They are kept
+ * in RELEASED and only become free in free_map_flush(), which the
+ * commit calls while it holds every operation back.
+ *
+ * Sectors reserved for a growing inode are kept in RESERVED, not in
+ * the free map, until they are claimed.  The free map on disk thus
+ * never shows them in use, and a crash does not leak them. */
 static struct file *free_map_file;   /* Free map file. */
 static struct bitmap *free_map;      /* Free map, one bit per disk sector. */
+static struct bitmap *released;      /* Released, not yet free sectors. */
+static struct bitmap *reserved;      /* Reserved, not yet used sectors. */
+static struct bitmap *dirty_sectors; /* Changed sectors of free_map_file. */
+static struct lock free_map_lock;    /* Protects the above. */
+
+#ifndef EFILESYS
+static void mark_dirty (size_t start, size_t cnt);
+static void free_released (void);
+static size_t scan_free (size_t start, size_t cnt);
+static size_t find_near (disk_sector_t goal, size_t cnt, size_t *cntp);
+#endif
 
 /* Initializes the free map. */
 void
@@ -16,32 +50,248 @@ free_map_init (void) {
 		PANIC ("bitmap creation failed--disk is too large");
 	bitmap_mark (free_map, FREE_MAP_SECTOR);
 	bitmap_mark (free_map, ROOT_DIR_SECTOR);
+	bitmap_set_multiple (free_map, JOURNAL_SECTOR, JOURNAL_SECTORS, true);
+	released = bitmap_create (bitmap_size (free_map));
+	reserved = bitmap_create (bitmap_size (free_map));
+	if (released == NULL || reserved == NULL)
+		PANIC ("bitmap creation failed--disk is too large");
+	dirty_sectors = bitmap_create (DIV_ROUND_UP (bitmap_size (free_map),
+				BITS_PER_SECTOR));
+	if (dirty_sectors == NULL)
+		PANIC ("bitmap creation failed--disk is too large");
+	lock_init (&free_map_lock);
+}
+
+#ifndef EFILESYS
+/* Records that the free map bits START through START + CNT
+ * (exclusive) changed.  free_map_lock must be held. */
+static void
+mark_dirty (size_t start, size_t cnt) {
+	size_t first = start / BITS_PER_SECTOR;
+	size_t last = (start + cnt - 1) / BITS_PER_SECTOR;
+
+	bitmap_set_multiple (dirty_sectors, first, last - first + 1, true);
+}
+
+/* Frees the sectors released since the last commit.  free_map_lock
+ * must be held. */
+static void
+free_released (void) {
+	size_t start = 0;
+
+	while ((start = bitmap_scan (released, start, 1, true)) != BITMAP_ERROR) {
+		size_t cnt = 1;
+		while (start + cnt < bitmap_size (released)
+				&& bitmap_test (released, start + cnt))
+			cnt++;
+		bitmap_set_multiple (released, start, cnt, false);
+		bitmap_set_multiple (free_map, start, cnt, false);
+		mark_dirty (start, cnt);
+		start += cnt;
+	}
 }
 
+/* Returns the first sector at or after START that begins a run of
+ * CNT sectors that are neither in use nor reserved, or BITMAP_ERROR
+ * if there is none.  free_map_lock must be held. */
+static size_t
+scan_free (size_t start, size_t cnt) {
+	while ((start = bitmap_scan (free_map, start, cnt, false)) != BITMAP_ERROR
+			&& !bitmap_none (reserved, start, cnt))
+		start++;
+	return start;
+}
+
+/* Finds up to CNT consecutive free sectors close to GOAL, as
+ * described for free_map_allocate_near(), stores how many into
+ * *CNTP and returns the first, or BITMAP_ERROR if the disk is full.
+ * free_map_lock must be held. */
+static size_t
+find_near (disk_sector_t goal, size_t cnt, size_t *cntp) {
+	size_t size = bitmap_size (free_map);
+	size_t start, n = 0;
+
+	if (goal >= size)
+		goal = 0;
+	start = scan_free (goal, 1);
+	if (start != goal) {
+		start = scan_free (goal, cnt);
+		if (start == BITMAP_ERROR)
+			start = scan_free (0, cnt);
+		if (start == BITMAP_ERROR)
+			start = scan_free (0, 1);
+	}
+	if (start != BITMAP_ERROR)
+		while (n < cnt && start + n < size
+				&& !bitmap_test (free_map, start + n)
+				&& !bitmap_test (reserved, start + n))
+			n++;
+	*cntp = n;
+	return start;
+}
+#endif
+
 /* Allocates CNT consecutive sectors from the free map and stores
  * the first into *SECTORP.
  * Returns true if successful, false if all sectors were
  * available. */
 bool
 free_map_allocate (size_t cnt, disk_sector_t *sectorp) {
-	disk_sector_t sector = bitmap_scan_and_flip (free_map, 0, cnt, false);
-	if (sector != BITMAP_ERROR
-			&& free_map_file != NULL
-			&& !bitmap_write (free_map, free_map_file)) {
-		bitmap_set_multiple (free_map, sector, cnt, false);
-		sector = BITMAP_ERROR;
+#ifdef EFILESYS
+	/* With the FAT, single sectors are one-cluster chains. */
+	ASSERT (cnt == 1 && SECTORS_PER_CLUSTER == 1);
+	cluster_t clst = fat_create_chain (0);
+	if (clst != 0)
+		*sectorp = cluster_to_sector (clst);
+	return clst != 0;
+#else
+	lock_acquire (&free_map_lock);
+	disk_sector_t sector = scan_free (0, cnt);
+	if (sector != BITMAP_ERROR) {
+		bitmap_set_multiple (free_map, sector, cnt, true);
+		mark_dirty (sector, cnt);
 	}
+	lock_release (&free_map_lock);
 	if (sector != BITMAP_ERROR)
 		*sectorp = sector;
 	return sector != BITMAP_ERROR;
+#endif
+}
+
+/* Allocates up to CNT consecutive sectors close to GOAL, stores
+ * the first into *SECTORP and returns how many were allocated, at
+ * least 1, or 0 if the disk is full.
+ *
+ * GOAL itself is preferred, since it usually follows the last
+ * sector of the run being extended.  Otherwise the first run of CNT
+ * free sectors after GOAL is taken, and only if there is none, the
+ * first free sector anywhere. */
+size_t
+free_map_allocate_near (disk_sector_t goal, size_t cnt,
+		disk_sector_t *sectorp) {
+	ASSERT (cnt > 0);
+#ifdef EFILESYS
+	/* The FAT allocates cluster by cluster and keeps its own hint. */
+	(void) goal;
+	return free_map_allocate (1, sectorp) ? 1 : 0;
+#else
+	size_t start, n;
+
+	lock_acquire (&free_map_lock);
+	start = find_near (goal, cnt, &n);
+	if (n > 0) {
+		bitmap_set_multiple (free_map, start, n, true);
+		mark_dirty (start, n);
+	}
+	lock_release (&free_map_lock);
+	if (n > 0)
+		*sectorp = start;
+	return n;
+#endif
+}
+
+#ifndef EFILESYS
+/* Reserves up to CNT consecutive sectors close to GOAL, like
+ * free_map_allocate_near(), but without marking them in use.  Each
+ * reserved sector must be claimed with free_map_claim() before it is
+ * used, or given back with free_map_unreserve(). */
+size_t
+free_map_reserve_near (disk_sector_t goal, size_t cnt,
+		disk_sector_t *sectorp) {
+	size_t start, n;
+
+	ASSERT (cnt > 0);
+	lock_acquire (&free_map_lock);
+	start = find_near (goal, cnt, &n);
+	if (n > 0)
+		bitmap_set_multiple (reserved, start, n, true);
+	lock_release (&free_map_lock);
+	if (n > 0)
+		*sectorp = start;
+	return n;
+}
+
+/* Marks the reserved SECTOR in use. */
+void
+free_map_claim (disk_sector_t sector) {
+	lock_acquire (&free_map_lock);
+	ASSERT (bitmap_test (reserved, sector));
+	bitmap_reset (reserved, sector);
+	bitmap_mark (free_map, sector);
+	mark_dirty (sector, 1);
+	lock_release (&free_map_lock);
+}
+
+/* Gives back CNT reserved sectors starting at SECTOR.  They were
+ * never in use, so they are free at once. */
+void
+free_map_unreserve (disk_sector_t sector, size_t cnt) {
+	lock_acquire (&free_map_lock);
+	ASSERT (bitmap_all (reserved, sector, cnt));
+	bitmap_set_multiple (reserved, sector, cnt, false);
+	lock_release (&free_map_lock);
 }
+#endif
 
-/* Makes CNT sectors starting at SECTOR available for use. */
+/* Makes CNT sectors starting at SECTOR available for use, once the
+ * current transaction commits. */
 void
 free_map_release (disk_sector_t sector, size_t cnt) {
+#ifdef EFILESYS
+	ASSERT (cnt == 1);
+	fat_remove_chain (sector_to_cluster (sector), 0);
+#else
+	lock_acquire (&free_map_lock);
 	ASSERT (bitmap_all (free_map, sector, cnt));
-	bitmap_set_multiple (free_map, sector, cnt, false);
-	bitmap_write (free_map, free_map_file);
+	ASSERT (bitmap_none (released, sector, cnt));
+	bitmap_set_multiple (released, sector, cnt, true);
+	mark_dirty (sector, cnt);
+	lock_release (&free_map_lock);
+#endif
+}
+
+/* Returns the number of sectors of the free map, or of the FAT,
+ * that the next commit writes, counting those that hold released
+ * sectors. */
+size_t
+free_map_dirty_cnt (void) {
+#ifdef EFILESYS
+	return fat_dirty_cnt ();
+#else
+	size_t cnt;
+
+	lock_acquire (&free_map_lock);
+	cnt = bitmap_count (dirty_sectors, 0, bitmap_size (dirty_sectors), true);
+	lock_release (&free_map_lock);
+	return cnt;
+#endif
+}
+
+/* Stores the number of free sectors into *FREE_CNT, the number of
+ * runs they form into *EXTENT_CNT and the length of the longest run
+ * into *LARGEST. */
+void
+free_map_stats (size_t *free_cnt, size_t *extent_cnt, size_t *largest) {
+#ifdef EFILESYS
+	fat_stats (free_cnt, extent_cnt, largest);
+#else
+	size_t i, run = 0;
+
+	*free_cnt = *extent_cnt = *largest = 0;
+	lock_acquire (&free_map_lock);
+	for (i = 0; i < bitmap_size (free_map); i++) {
+		if (bitmap_test (free_map, i) || bitmap_test (reserved, i)) {
+			run = 0;
+			continue;
+		}
+		if (run++ == 0)
+			++*extent_cnt;
+		++*free_cnt;
+		if (run > *largest)
+			*largest = run;
+	}
+	lock_release (&free_map_lock);
+#endif
 }
 
 /* Opens the free map file and reads it from disk. */
@@ -50,14 +300,48 @@ free_map_open (void) {
 	free_map_file = file_open (inode_open (FREE_MAP_SECTOR));
 	if (free_map_file == NULL)
 		PANIC ("can't open free map");
+	inode_set_metadata (file_get_inode (free_map_file));
 	if (!bitmap_read (free_map, free_map_file))
 		PANIC ("can't read free map");
+	bitmap_set_all (dirty_sectors, false);
+}
+
+/* Frees the sectors released since the last call and writes the
+ * changed sectors of the free map to its file, or those of the FAT,
+ * into the buffer cache.  Called by journal commits only, while no
+ * operation runs. */
+void
+free_map_flush (void) {
+#ifdef EFILESYS
+	fat_flush ();
+#else
+	size_t i = 0;
+
+	lock_acquire (&free_map_lock);
+	free_released ();
+
+	/* Nothing to write before the free map is open. */
+	if (free_map_file == NULL) {
+		lock_release (&free_map_lock);
+		return;
+	}
+
+	while ((i = bitmap_scan (dirty_sectors, i, 1, true)) != BITMAP_ERROR) {
+		if (!bitmap_write_part (free_map, free_map_file,
+					i * DISK_SECTOR_SIZE, DISK_SECTOR_SIZE))
+			PANIC ("can't write free map");
+		bitmap_reset (dirty_sectors, i);
+	}
+	lock_release (&free_map_lock);
+#endif
 }
 
-/* Writes the free map to disk and closes the free map file. */
+/* Closes the free map file.  The free map reaches the disk through
+ * the journal, so the last commit must come first. */
 void
 free_map_close (void) {
 	file_close (free_map_file);
+	free_map_file = NULL;
 }
 
 /* Creates a new free map file on disk and writes the free map to
@@ -72,6 +356,8 @@ free_map_create (void) {
 	free_map_file = file_open (inode_open (FREE_MAP_SECTOR));
 	if (free_map_file == NULL)
 		PANIC ("can't open free map");
+	inode_set_metadata (file_get_inode (free_map_file));
 	if (!bitmap_write (free_map, free_map_file))
 		PANIC ("can't write free map");
+	bitmap_set_all (dirty_sectors, false);
 }
@@ -6,6 +6,8 @@
 #include "filesys/directory.h"
 #include "filesys/file.h"
 #include "filesys/filesys.h"
+#include "filesys/free-map.h"
+#include "filesys/inode.h"
 #include "devices/disk.h"
 #include "threads/malloc.h"
 #include "threads/palloc.h"
@@ -26,6 +28,34 @@ fsutil_ls (char **argv UNUSED) {
 	printf ("End of listing.\n");
 }
 
+/* Reports how many runs of consecutive sectors each file in the root
+ * directory and the free space are split into. */
+void
+fsutil_frag (char **argv UNUSED) {
+	struct dir *dir;
+	char name[NAME_MAX + 1];
+	size_t free_cnt, extent_cnt, largest;
+
+	printf ("Fragmentation of the root directory:\n");
+	dir = dir_open_root ();
+	if (dir == NULL)
+		PANIC ("root dir open failed");
+	while (dir_readdir (dir, name)) {
+		struct inode *inode;
+
+		if (!dir_lookup (dir, name, &inode))
+			continue;
+		printf ("%s: %d bytes in %zu extents\n", name,
+				inode_length (inode), inode_extent_cnt (inode));
+		inode_close (inode);
+	}
+	dir_close (dir);
+
+	free_map_stats (&free_cnt, &extent_cnt, &largest);
+	printf ("Free space: %zu sectors in %zu extents, largest %zu.\n",
+			free_cnt, extent_cnt, largest);
+}
+
 /* Prints the contents of file ARGV[1] to the system console as
  * hex and ASCII. */
 void
@@ -1,23 +1,62 @@
 #include "filesys/inode.h"
-#include <list.h>
 #include <debug.h>
+#include <hash.h>
 #include <round.h>
 #include <string.h>
 #include "filesys/filesys.h"
 #include "filesys/free-map.h"
+#include "filesys/journal.h"
+#include "filesys/page_cache.h"
 #include "threads/malloc.h"
+#include "threads/synch.h"
+#ifdef EFILESYS
+#include "filesys/fat.h"
+#endif
+#ifdef USERPROG
+#include "userprog/process.h"
+#endif
 
 /* Identifies an inode. */
 #define INODE_MAGIC 0x494e4f44
 
+#ifdef EFILESYS
 /* On-disk inode.
- * Must be exactly DISK_SECTOR_SIZE bytes long. */
+ * Must be exactly DISK_SECTOR_SIZE bytes long.
+ *
+ * The data is held in the FAT cluster chain that starts at START,
+ * which is 0 while the file has no data.  A write past end of file
+ * extends the chain with zeroed clusters up to the written one. */
 struct inode_disk {
-	disk_sector_t start;                /* First data sector. */
+	cluster_t start;                    /* First data cluster. */
 	off_t length;                       /* File size in bytes. */
 	unsigned magic;                     /* Magic number. */
-	uint32_t unused[125];               /* Not used. */
+	disk_sector_t dir_index;            /* Index of a directory, or 0. */
+	uint32_t unused[124];               /* Not used. */
 };
+#else
+/* Number of sector numbers in the inode itself and in one index
+ * sector. */
+#define INODE_DIRECT_CNT 123
+#define INODE_INDIRECT_CNT (DISK_SECTOR_SIZE / sizeof (disk_sector_t))
+
+/* On-disk inode.
+ * Must be exactly DISK_SECTOR_SIZE bytes long.
+ *
+ * Data sectors are found through a multi-level index: the first
+ * INODE_DIRECT_CNT sectors of the file are listed in DIRECT, the
+ * next INODE_INDIRECT_CNT in the index sector INDIRECT, and the rest
+ * in the index sectors listed by DOUBLY_INDIRECT.  Sector 0 always
+ * holds the free map inode, so a 0 entry marks a sector that was
+ * never written, a hole that reads as zeros. */
+struct inode_disk {
+	disk_sector_t direct[INODE_DIRECT_CNT]; /* Direct data sectors. */
+	disk_sector_t indirect;             /* Singly indirect index sector. */
+	disk_sector_t doubly_indirect;      /* Doubly indirect index sector. */
+	off_t length;                       /* File size in bytes. */
+	unsigned magic;                     /* Magic number. */
+	disk_sector_t dir_index;            /* Index of a directory, or 0. */
+};
+#endif
 
 /* Returns the number of sectors to allocate for an inode SIZE
  * bytes long. */
@@ -26,42 +65,283 @@ bytes_to_sectors (off_t size) {
 	return DIV_ROUND_UP (size, DISK_SECTOR_SIZE);
 }
 
-/* In-memory inode. */
+/* A write that is not part of a larger operation is split into
+ * transactions of at most WRITE_PIECE_SECTORS sectors, and releasing
+ * a removed inode's sectors into transactions of at most
+ * RELEASE_PIECE_SECTORS, so that each stays within its credits (see
+ * journal.c).  Releasing dirties a free map or FAT sector for every
+ * sector released, including the inode's own. */
+#define WRITE_PIECE_SECTORS 8
+#define RELEASE_PIECE_SECTORS 16
+#define RELEASE_CREDITS (RELEASE_PIECE_SECTORS + 1)
+
+#ifndef EFILESYS
+/* Number of sectors reserved at a time for a growing inode. */
+#define PREALLOC_SECTORS 8
+
+/* Free sectors reserved for an inode that grows, so that its data
+ * stays contiguous even while other files grow at the same time.
+ * The reservation is refilled near GOAL, right after the sector
+ * allocated last, and given back when the inode is closed. */
+struct prealloc {
+	disk_sector_t next;                 /* First reserved sector. */
+	size_t cnt;                         /* Number of reserved sectors. */
+	disk_sector_t goal;                 /* Where to reserve more. */
+};
+#endif
+
+/* In-memory inode.
+ *
+ * ELEM belongs to the open-inode table and is protected by
+ * open_inodes_lock.  OPEN_CNT is updated atomically; it only drops
+ * to 0, and inode_open() only finds and raises it, while
+ * open_inodes_lock is held.  LOCK protects the metadata
+ * (REMOVED, DENY_WRITE_CNT and DATA).  DATA_LOCK serializes writers
+ * of the inode's sectors so that a write lands as a whole, and
+ * writers that grow the inode and so change DATA's index; a write
+ * that is not part of an operation takes it before beginning its
+ * transactions (see inode_writev_at()).  Readers do not take it, since every sector is copied in or out of the
+ * buffer cache atomically.  DIR_LOCK is only used when the inode is
+ * a directory and serializes its entries.  METADATA is set once
+ * for directories and other files whose contents are metadata, and
+ * makes their writes go through the journal. */
 struct inode {
-	struct list_elem elem;              /* Element in inode list. */
+	struct hash_elem elem;              /* Element in open_inodes. */
 	disk_sector_t sector;               /* Sector number of disk location. */
 	int open_cnt;                       /* Number of openers. */
 	bool removed;                       /* True if deleted, false otherwise. */
 	int deny_write_cnt;                 /* 0: writes ok, >0: deny writes. */
+	unsigned write_cnt;                 /* Number of writes so far. */
+	bool metadata;                      /* Contents are metadata? */
 	struct inode_disk data;             /* Inode content. */
+	struct lock lock;                   /* Protects the metadata. */
+	struct lock data_lock;              /* Serializes data writers. */
+	struct lock dir_lock;               /* Serializes directory entries. */
+#ifdef EFILESYS
+	struct fat_chain chain;             /* Positions in the data chain. */
+#else
+	struct prealloc prealloc;           /* Sectors reserved for growth. */
+#endif
 };
 
+#ifndef EFILESYS
+static char zeros[DISK_SECTOR_SIZE];
+
+/* Initializes PA with nothing reserved and GOAL as the preferred
+ * place for the first reservation. */
+static void
+prealloc_init (struct prealloc *pa, disk_sector_t goal) {
+	pa->next = 0;
+	pa->cnt = 0;
+	pa->goal = goal;
+}
+
+/* Gives the sectors still reserved in PA back to the free map. */
+static void
+prealloc_release (struct prealloc *pa) {
+	if (pa->cnt > 0)
+		free_map_unreserve (pa->next, pa->cnt);
+	pa->cnt = 0;
+}
+
+/* Takes a sector from PA, reserving up to PREALLOC_SECTORS more
+ * first if PA is empty, and fills it with zeros.  Returns the
+ * sector, or 0 if the disk is full. */
+static disk_sector_t
+allocate_zeroed (struct prealloc *pa) {
+	disk_sector_t sector;
+
+	if (pa->cnt == 0) {
+		pa->cnt = free_map_reserve_near (pa->goal, PREALLOC_SECTORS,
+				&pa->next);
+		if (pa->cnt == 0)
+			return 0;
+	}
+	sector = pa->next++;
+	pa->cnt--;
+	free_map_claim (sector);
+	pa->goal = sector + 1;
+	page_cache_write (sector, zeros, 0, DISK_SECTOR_SIZE);
+	return sector;
+}
+
+/* Returns the sector stored in *SLOT.  If it is 0 and PA is
+ * non-null, first stores a sector allocated from PA there. */
+static disk_sector_t
+slot_get (disk_sector_t *slot, struct prealloc *pa) {
+	if (*slot == 0 && pa != NULL)
+		*slot = allocate_zeroed (pa);
+	return *slot;
+}
+
+/* Returns entry IDX of index sector BLOCK, allocating a sector from
+ * PA for it first if it is 0 and PA is non-null. */
+static disk_sector_t
+index_get (disk_sector_t block, size_t idx, struct prealloc *pa) {
+	disk_sector_t sector;
+	off_t ofs = idx * sizeof sector;
+
+	page_cache_read (block, &sector, ofs, sizeof sector);
+	if (sector == 0 && pa != NULL) {
+		sector = allocate_zeroed (pa);
+		if (sector != 0)
+			page_cache_write_meta (block, &sector, ofs, sizeof sector);
+	}
+	return sector;
+}
+
+/* Returns the sector that holds sector IDX of the file described
+ * by DISK_INODE, or 0 if there is none.  If PA is non-null, missing
+ * data and index sectors are allocated from it on the way, and 0
+ * means that the disk is full or IDX is beyond the largest possible
+ * file.  Takes at most two index sector reads, all through the
+ * buffer cache. */
+static disk_sector_t
+index_to_sector (struct inode_disk *disk_inode, size_t idx,
+		struct prealloc *pa) {
+	disk_sector_t block;
+
+	if (idx < INODE_DIRECT_CNT)
+		return slot_get (&disk_inode->direct[idx], pa);
+	idx -= INODE_DIRECT_CNT;
+
+	if (idx < INODE_INDIRECT_CNT) {
+		block = slot_get (&disk_inode->indirect, pa);
+		return block != 0 ? index_get (block, idx, pa) : 0;
+	}
+	idx -= INODE_INDIRECT_CNT;
+
+	if (idx < INODE_INDIRECT_CNT * INODE_INDIRECT_CNT) {
+		block = slot_get (&disk_inode->doubly_indirect, pa);
+		if (block != 0)
+			block = index_get (block, idx / INODE_INDIRECT_CNT, pa);
+		return block != 0 ? index_get (block, idx % INODE_INDIRECT_CNT, pa)
+			: 0;
+	}
+	return 0;
+}
+
+/* Releases SECTOR.  If CNT is non-null, counts the sector in *CNT
+ * and, every RELEASE_PIECE_SECTORS sectors, ends the running
+ * operation and begins another.  A commit in between may let the
+ * released sectors be reused, which is safe since index sectors are
+ * released only after the sectors they refer to. */
+static void
+release_sector (disk_sector_t sector, size_t *cnt) {
+	free_map_release (sector, 1);
+	if (cnt != NULL && ++*cnt % RELEASE_PIECE_SECTORS == 0) {
+		journal_end ();
+		journal_begin (RELEASE_CREDITS);
+	}
+}
+
+/* Releases index sector BLOCK, LEVELS levels above the data, and
+ * every sector it refers to, as release_sector() does.  Does nothing
+ * if BLOCK is 0. */
+static void
+release_index (disk_sector_t block, int levels, size_t *cnt) {
+	size_t i;
+
+	if (block == 0)
+		return;
+	if (levels > 0)
+		for (i = 0; i < INODE_INDIRECT_CNT; i++)
+			release_index (index_get (block, i, NULL), levels - 1, cnt);
+	release_sector (block, cnt);
+}
+
+/* Releases every data and index sector of DISK_INODE, as
+ * release_sector() does. */
+static void
+release_sectors (struct inode_disk *disk_inode, size_t *cnt) {
+	size_t i;
+
+	for (i = 0; i < INODE_DIRECT_CNT; i++)
+		release_index (disk_inode->direct[i], 0, cnt);
+	release_index (disk_inode->indirect, 1, cnt);
+	release_index (disk_inode->doubly_indirect, 2, cnt);
+}
+#endif
+
+#ifdef EFILESYS
+/* Releases the chain of clusters that starts at CLST,
+ * RELEASE_PIECE_SECTORS clusters per transaction. */
+static void
+release_chain (cluster_t clst) {
+	while (clst != 0 && clst != EOChain) {
+		clst = fat_remove_chain_part (clst, RELEASE_PIECE_SECTORS);
+		if (clst != 0 && clst != EOChain) {
+			journal_end ();
+			journal_begin (RELEASE_CREDITS);
+		}
+	}
+}
+#endif
+
+/* Returns the sector that holds sector IDX of INODE's data, or 0 if
+ * there is none.  If CREATE, the sector and whatever leads to it are
+ * allocated first, and 0 means that the disk is full. */
+static disk_sector_t
+data_sector (struct inode *inode, size_t idx, bool create) {
+#ifdef EFILESYS
+	cluster_t clst = fat_chain_get (&inode->chain, idx / SECTORS_PER_CLUSTER,
+			create);
+	if (create)
+		inode->data.start = inode->chain.start;
+	return clst != 0
+		? cluster_to_sector (clst) + idx % SECTORS_PER_CLUSTER : 0;
+#else
+	struct prealloc *pa = &inode->prealloc;
+
+	if (!create)
+		return index_to_sector (&inode->data, idx, NULL);
+
+	/* Extend the run that holds the previous sector, if any. */
+	if (pa->cnt == 0 && idx > 0) {
+		disk_sector_t prev = index_to_sector (&inode->data, idx - 1, NULL);
+		if (prev != 0)
+			pa->goal = prev + 1;
+	}
+	return index_to_sector (&inode->data, idx, pa);
+#endif
+}
+
 /* Returns the disk sector that contains byte offset POS within
  * INODE.
  * Returns -1 if INODE does not contain data for a byte at offset
- * POS. */
+ * POS, and 0 if POS lies in a hole. */
 static disk_sector_t
-byte_to_sector (const struct inode *inode, off_t pos) {
+byte_to_sector (struct inode *inode, off_t pos) {
 	ASSERT (inode != NULL);
 	if (pos < inode->data.length)
-		return inode->data.start + pos / DISK_SECTOR_SIZE;
+		return data_sector (inode, pos / DISK_SECTOR_SIZE, false);
 	else
 		return -1;
 }
 
-/* List of open inodes, so that opening a single inode twice
+/* Open inodes by sector, so that opening a single inode twice
  * returns the same `struct inode'. */
-static struct list open_inodes;
+static struct hash open_inodes;
+
+/* Protects open_inodes. */
+static struct lock open_inodes_lock;
+
+static uint64_t inode_hash (const struct hash_elem *, void *aux);
+static bool inode_less (const struct hash_elem *, const struct hash_elem *,
+		void *aux);
 
 /* Initializes the inode module. */
 void
 inode_init (void) {
-	list_init (&open_inodes);
+	if (!hash_init (&open_inodes, inode_hash, inode_less, NULL))
+		PANIC ("cannot allocate the open inode table");
+	lock_init (&open_inodes_lock);
 }
 
 /* Initializes an inode with LENGTH bytes of data and
  * writes the new inode to sector SECTOR on the file system
- * disk.
+ * disk.  The data sectors are allocated one by one, so they need
+ * not be contiguous, and are filled with zeros.
  * Returns true if successful.
  * Returns false if memory or disk allocation fails. */
 bool
@@ -78,19 +358,38 @@ inode_create (disk_sector_t sector, off_t length) {
 	disk_inode = calloc (1, sizeof *disk_inode);
 	if (disk_inode != NULL) {
 		size_t sectors = bytes_to_sectors (length);
+
 		disk_inode->length = length;
 		disk_inode->magic = INODE_MAGIC;
-		if (free_map_allocate (sectors, &disk_inode->start)) {
-			disk_write (filesys_disk, sector, disk_inode);
-			if (sectors > 0) {
-				static char zeros[DISK_SECTOR_SIZE];
-				size_t i;
-
-				for (i = 0; i < sectors; i++) 
-					disk_write (filesys_disk, disk_inode->start + i, zeros); 
-			}
-			success = true; 
-		} 
+#ifdef EFILESYS
+		struct fat_chain chain;
+
+		fat_chain_init (&chain, 0);
+		if (sectors == 0
+				|| fat_chain_get (&chain, (sectors - 1) / SECTORS_PER_CLUSTER,
+					true) != 0) {
+			disk_inode->start = chain.start;
+			page_cache_write_meta (sector, disk_inode, 0, DISK_SECTOR_SIZE);
+			success = true;
+		} else if (chain.start != 0)
+			fat_remove_chain (chain.start, 0);
+		fat_chain_destroy (&chain);
+#else
+		struct prealloc pa;
+		size_t i;
+
+		/* The data goes right after the inode if there is room. */
+		prealloc_init (&pa, sector + 1);
+		for (i = 0; i < sectors; i++)
+			if (index_to_sector (disk_inode, i, &pa) == 0)
+				break;
+		prealloc_release (&pa);
+		if (i == sectors) {
+			page_cache_write_meta (sector, disk_inode, 0, DISK_SECTOR_SIZE);
+			success = true;
+		} else
+			release_sectors (disk_inode, NULL);
+#endif
 		free (disk_inode);
 	}
 	return success;
@@ -101,39 +400,57 @@ inode_create (disk_sector_t sector, off_t length) {
  * Returns a null pointer if memory allocation fails. */
 struct inode *
 inode_open (disk_sector_t sector) {
-	struct list_elem *e;
+	struct inode key;
+	struct hash_elem *e;
 	struct inode *inode;
 
-	/* Check whether this inode is already open. */
-	for (e = list_begin (&open_inodes); e != list_end (&open_inodes);
-			e = list_next (e)) {
-		inode = list_entry (e, struct inode, elem);
-		if (inode->sector == sector) {
-			inode_reopen (inode);
-			return inode; 
-		}
+	/* Check whether this inode is already open.  The table lock is
+	 * held until the new inode is in the table, so two openers of the
+	 * same sector always end up sharing one `struct inode'. */
+	key.sector = sector;
+	lock_acquire (&open_inodes_lock);
+	e = hash_find (&open_inodes, &key.elem);
+	if (e != NULL) {
+		inode = hash_entry (e, struct inode, elem);
+		__atomic_add_fetch (&inode->open_cnt, 1, __ATOMIC_RELAXED);
+		lock_release (&open_inodes_lock);
+		return inode;
 	}
 
 	/* Allocate memory. */
 	inode = malloc (sizeof *inode);
-	if (inode == NULL)
+	if (inode == NULL) {
+		lock_release (&open_inodes_lock);
 		return NULL;
+	}
 
 	/* Initialize. */
-	list_push_front (&open_inodes, &inode->elem);
 	inode->sector = sector;
+	hash_insert (&open_inodes, &inode->elem);
 	inode->open_cnt = 1;
 	inode->deny_write_cnt = 0;
+	inode->write_cnt = 0;
+	inode->metadata = false;
 	inode->removed = false;
-	disk_read (filesys_disk, inode->sector, &inode->data);
+	lock_init (&inode->lock);
+	lock_init (&inode->data_lock);
+	lock_init (&inode->dir_lock);
+	page_cache_read (inode->sector, &inode->data, 0, DISK_SECTOR_SIZE);
+#ifdef EFILESYS
+	fat_chain_init (&inode->chain, inode->data.start);
+#else
+	prealloc_init (&inode->prealloc, sector + 1);
+#endif
+	lock_release (&open_inodes_lock);
 	return inode;
 }
 
-/* Reopens and returns INODE. */
+/* Reopens and returns INODE.  The caller holds a reference, so
+ * OPEN_CNT cannot reach 0 meanwhile and no lock is needed. */
 struct inode *
 inode_reopen (struct inode *inode) {
 	if (inode != NULL)
-		inode->open_cnt++;
+		__atomic_add_fetch (&inode->open_cnt, 1, __ATOMIC_RELAXED);
 	return inode;
 }
 
@@ -152,17 +469,53 @@ inode_close (struct inode *inode) {
 	if (inode == NULL)
 		return;
 
-	/* Release resources if this was the last opener. */
-	if (--inode->open_cnt == 0) {
-		/* Remove from inode list and release lock. */
-		list_remove (&inode->elem);
+	/* Dropping a reference that is not the last one needs no lock.
+	 * The last one is dropped under the table lock, so that
+	 * inode_open() cannot find INODE as it is being freed. */
+	int cnt = __atomic_load_n (&inode->open_cnt, __ATOMIC_RELAXED);
+	while (cnt > 1)
+		if (__atomic_compare_exchange_n (&inode->open_cnt, &cnt, cnt - 1,
+					false, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED))
+			return;
 
-		/* Deallocate blocks if removed. */
+	/* Release resources if this was the last opener. */
+	lock_acquire (&open_inodes_lock);
+	bool last = __atomic_sub_fetch (&inode->open_cnt, 1, __ATOMIC_ACQ_REL) == 0;
+	if (last)
+		hash_delete (&open_inodes, &inode->elem);
+	lock_release (&open_inodes_lock);
+
+	/* Nobody else can reach INODE any more, so it is torn down
+	 * without holding any lock. */
+	if (last) {
+#ifndef EFILESYS
+		prealloc_release (&inode->prealloc);
+#endif
+		/* Deallocate blocks if removed, a directory's index first.
+		 * Outside an operation, a large inode takes several
+		 * transactions; since it is in no directory any more, only a
+		 * crash in between could tell, by leaking the rest. */
 		if (inode->removed) {
+			if (inode->data.dir_index != 0) {
+				struct inode *index = inode_open (inode->data.dir_index);
+				if (index != NULL) {
+					inode_remove (index);
+					inode_close (index);
+				}
+			}
+			journal_begin (RELEASE_CREDITS);
+#ifdef EFILESYS
+			release_chain (inode->data.start);
+#else
+			size_t cnt = 0;
+			release_sectors (&inode->data, &cnt);
+#endif
 			free_map_release (inode->sector, 1);
-			free_map_release (inode->data.start,
-					bytes_to_sectors (inode->data.length)); 
+			journal_end ();
 		}
+#ifdef EFILESYS
+		fat_chain_destroy (&inode->chain);
+#endif
 
 		free (inode); 
 	}
@@ -173,17 +526,34 @@ inode_close (struct inode *inode) {
 void
 inode_remove (struct inode *inode) {
 	ASSERT (inode != NULL);
+	lock_acquire (&inode->lock);
 	inode->removed = true;
+	lock_release (&inode->lock);
+#ifdef USERPROG
+	/* A cached executable image keeps its inode open. */
+	exec_cache_forget (inode);
+#endif
 }
 
-/* Reads SIZE bytes from INODE into BUFFER, starting at position OFFSET.
- * Returns the number of bytes actually read, which may be less
- * than SIZE if an error occurs or end of file is reached. */
-off_t
-inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset) {
-	uint8_t *buffer = buffer_;
+/* Marks the contents of INODE as metadata, such as directory
+ * entries, so that writes to it are journaled. */
+void
+inode_set_metadata (struct inode *inode) {
+	inode->metadata = true;
+}
+
+/* Returns the number of writes to INODE since it was opened.  The
+ * contents of INODE cannot have changed while it stays the same. */
+unsigned
+inode_write_cnt (const struct inode *inode) {
+	return inode->write_cnt;
+}
+
+/* Reads SIZE bytes from INODE into BUFFER, starting at OFFSET,
+ * through the buffer cache.  Returns the number of bytes read. */
+static off_t
+read_chunks (struct inode *inode, uint8_t *buffer, off_t size, off_t offset) {
 	off_t bytes_read = 0;
-	uint8_t *bounce = NULL;
 
 	while (size > 0) {
 		/* Disk sector to read, starting byte offset within sector. */
@@ -200,100 +570,265 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset) {
 		if (chunk_size <= 0)
 			break;
 
-		if (sector_ofs == 0 && chunk_size == DISK_SECTOR_SIZE) {
-			/* Read full sector directly into caller's buffer. */
-			disk_read (filesys_disk, sector_idx, buffer + bytes_read); 
-		} else {
-			/* Read sector into bounce buffer, then partially copy
-			 * into caller's buffer. */
-			if (bounce == NULL) {
-				bounce = malloc (DISK_SECTOR_SIZE);
-				if (bounce == NULL)
-					break;
-			}
-			disk_read (filesys_disk, sector_idx, bounce);
-			memcpy (buffer + bytes_read, bounce + sector_ofs, chunk_size);
-		}
+		if (sector_idx != 0)
+			page_cache_read (sector_idx, buffer + bytes_read, sector_ofs,
+					chunk_size);
+		else
+			memset (buffer + bytes_read, 0, chunk_size);
 
 		/* Advance. */
 		size -= chunk_size;
 		offset += chunk_size;
 		bytes_read += chunk_size;
 	}
-	free (bounce);
-
 	return bytes_read;
 }
 
-/* Writes SIZE bytes from BUFFER into INODE, starting at OFFSET.
- * Returns the number of bytes actually written, which may be
- * less than SIZE if end of file is reached or an error occurs.
- * (Normally a write at end of file would extend the inode, but
- * growth is not yet implemented.) */
-off_t
-inode_write_at (struct inode *inode, const void *buffer_, off_t size,
+/* Writes SIZE bytes from BUFFER into INODE, starting at OFFSET,
+ * through the buffer cache, allocating sectors that do not exist
+ * yet and extending INODE if the write ends past end of file.
+ * Sectors between the old end of file and OFFSET are left as holes.
+ * The caller must hold INODE's data lock.  Returns the number of
+ * bytes written, which is short only if the disk is full. */
+static off_t
+write_chunks (struct inode *inode, const uint8_t *buffer, off_t size,
 		off_t offset) {
-	const uint8_t *buffer = buffer_;
 	off_t bytes_written = 0;
-	uint8_t *bounce = NULL;
+	bool changed = false;
 
-	if (inode->deny_write_cnt)
-		return 0;
+	inode->write_cnt++;
 
 	while (size > 0) {
 		/* Sector to write, starting byte offset within sector. */
-		disk_sector_t sector_idx = byte_to_sector (inode, offset);
+		size_t idx = offset / DISK_SECTOR_SIZE;
+		disk_sector_t sector_idx = data_sector (inode, idx, false);
 		int sector_ofs = offset % DISK_SECTOR_SIZE;
 
-		/* Bytes left in inode, bytes left in sector, lesser of the two. */
-		off_t inode_left = inode_length (inode) - offset;
-		int sector_left = DISK_SECTOR_SIZE - sector_ofs;
-		int min_left = inode_left < sector_left ? inode_left : sector_left;
-
 		/* Number of bytes to actually write into this sector. */
-		int chunk_size = size < min_left ? size : min_left;
-		if (chunk_size <= 0)
-			break;
-
-		if (sector_ofs == 0 && chunk_size == DISK_SECTOR_SIZE) {
-			/* Write full sector directly to disk. */
-			disk_write (filesys_disk, sector_idx, buffer + bytes_written); 
-		} else {
-			/* We need a bounce buffer. */
-			if (bounce == NULL) {
-				bounce = malloc (DISK_SECTOR_SIZE);
-				if (bounce == NULL)
-					break;
-			}
+		int sector_left = DISK_SECTOR_SIZE - sector_ofs;
+		int chunk_size = size < sector_left ? size : sector_left;
 
-			/* If the sector contains data before or after the chunk
-			   we're writing, then we need to read in the sector
-			   first.  Otherwise we start with a sector of all zeros. */
-			if (sector_ofs > 0 || chunk_size < sector_left) 
-				disk_read (filesys_disk, sector_idx, bounce);
-			else
-				memset (bounce, 0, DISK_SECTOR_SIZE);
-			memcpy (bounce + sector_ofs, buffer + bytes_written, chunk_size);
-			disk_write (filesys_disk, sector_idx, bounce); 
+		if (sector_idx == 0) {
+			sector_idx = data_sector (inode, idx, true);
+			if (sector_idx == 0)
+				break;
+			changed = true;
 		}
+		if (inode->metadata)
+			page_cache_write_meta (sector_idx, buffer + bytes_written,
+					sector_ofs, chunk_size);
+		else
+			page_cache_write (sector_idx, buffer + bytes_written, sector_ofs,
+					chunk_size);
 
 		/* Advance. */
 		size -= chunk_size;
 		offset += chunk_size;
 		bytes_written += chunk_size;
 	}
-	free (bounce);
+
+	/* The new length is published only after the data is in place,
+	 * so that readers, who do not take the data lock, never see
+	 * bytes that have not been written. */
+	if (bytes_written > 0 && offset > inode->data.length) {
+		inode->data.length = offset;
+		changed = true;
+	}
+	if (changed)
+		page_cache_write_meta (inode->sector, &inode->data, 0,
+				DISK_SECTOR_SIZE);
+	return bytes_written;
+}
+
+/* Returns true if writes to INODE are currently denied. */
+static bool
+write_denied (struct inode *inode) {
+	lock_acquire (&inode->lock);
+	bool denied = inode->deny_write_cnt > 0;
+	lock_release (&inode->lock);
+	return denied;
+}
+
+/* Reads SIZE bytes from INODE into BUFFER, starting at position OFFSET.
+ * Returns the number of bytes actually read, which may be less
+ * than SIZE if an error occurs or end of file is reached. */
+off_t
+inode_read_at (struct inode *inode, void *buffer, off_t size, off_t offset) {
+	return read_chunks (inode, buffer, size, offset);
+}
+
+#ifdef EFILESYS
+/* Extends the chain of clusters of INODE to hold at least its first
+ * IDX sectors, WRITE_PIECE_SECTORS per transaction, so that a write
+ * far past end of file does not allocate every cluster up to it in
+ * one.  The caller must hold INODE's data lock.  Returns false if
+ * the disk is full. */
+static bool
+grow_chain (struct inode *inode, size_t idx) {
+	size_t cnt = bytes_to_sectors (inode->data.length);
+
+	while (cnt < idx) {
+		size_t end = idx - cnt > WRITE_PIECE_SECTORS
+			? cnt + WRITE_PIECE_SECTORS : idx;
+		cluster_t start = inode->data.start;
+		bool success;
+
+		journal_begin (INODE_WRITE_CREDITS (WRITE_PIECE_SECTORS));
+		success = data_sector (inode, end - 1, true) != 0;
+		if (inode->data.start != start)
+			page_cache_write_meta (inode->sector, &inode->data, 0,
+					DISK_SECTOR_SIZE);
+		journal_end ();
+		if (!success)
+			return false;
+		cnt = end;
+	}
+	return true;
+}
+#endif
+
+/* Writes SIZE bytes from BUFFER into INODE at OFFSET, like
+ * write_chunks(), for a write that is not part of a larger
+ * operation: each WRITE_PIECE_SECTORS sectors are written in a
+ * transaction of their own.  The caller must hold INODE's data
+ * lock. */
+static off_t
+write_pieces (struct inode *inode, const uint8_t *buffer, off_t size,
+		off_t offset) {
+	off_t bytes_written = 0;
+
+#ifdef EFILESYS
+	if (size > 0 && !grow_chain (inode, offset / DISK_SECTOR_SIZE))
+		return 0;
+#endif
+	while (size > 0) {
+		off_t piece_end = (offset / DISK_SECTOR_SIZE + WRITE_PIECE_SECTORS)
+			* DISK_SECTOR_SIZE;
+		off_t piece_size = piece_end - offset < size ? piece_end - offset : size;
+		off_t n;
+
+		journal_begin (INODE_WRITE_CREDITS (WRITE_PIECE_SECTORS));
+		n = write_chunks (inode, buffer + bytes_written, piece_size, offset);
+		journal_end ();
+
+		size -= n;
+		offset += n;
+		bytes_written += n;
+		if (n < piece_size)
+			break;
+	}
+	return bytes_written;
+}
+
+/* Writes SIZE bytes from BUFFER into INODE, starting at OFFSET,
+ * extending INODE if needed.
+ * Returns the number of bytes actually written, which may be
+ * less than SIZE if the disk is full or an error occurs. */
+off_t
+inode_write_at (struct inode *inode, const void *buffer, off_t size,
+		off_t offset) {
+	struct iovec iov = { .iov_base = (void *) buffer, .iov_len = size };
+
+	return inode_writev_at (inode, &iov, 1, offset);
+}
+
+/* Reads into the IOVCNT segments of IOV, in order, from INODE
+ * starting at OFFSET.  Stops at the first short segment.  Returns
+ * the total number of bytes read. */
+off_t
+inode_readv_at (struct inode *inode, const struct iovec *iov, int iovcnt,
+		off_t offset) {
+	off_t bytes_read = 0;
+	int i;
+
+	for (i = 0; i < iovcnt; i++) {
+		off_t n = read_chunks (inode, iov[i].iov_base, iov[i].iov_len,
+				offset + bytes_read);
+		bytes_read += n;
+		if (n < (off_t) iov[i].iov_len)
+			break;
+	}
+
+	return bytes_read;
+}
+
+/* Writes the IOVCNT segments of IOV, in order, into INODE starting
+ * at OFFSET.  The data lock is taken once for the whole vector, so
+ * the segments land as one write.  Returns the total number of
+ * bytes written.
+ *
+ * A write inside an operation, which is to a directory or other
+ * metadata, is covered by that operation's credits.  Any other write
+ * is split into transactions by write_pieces(); its data lock is
+ * taken before them, which is safe since nothing that runs inside an
+ * operation waits for the data lock of such a file. */
+off_t
+inode_writev_at (struct inode *inode, const struct iovec *iov, int iovcnt,
+		off_t offset) {
+	bool nested = journal_nested ();
+	off_t bytes_written = 0;
+	int i;
+
+	if (write_denied (inode))
+		return 0;
+
+	lock_acquire (&inode->data_lock);
+	for (i = 0; i < iovcnt; i++) {
+		off_t n = nested
+			? write_chunks (inode, iov[i].iov_base, iov[i].iov_len,
+				offset + bytes_written)
+			: write_pieces (inode, iov[i].iov_base, iov[i].iov_len,
+				offset + bytes_written);
+		bytes_written += n;
+		if (n < (off_t) iov[i].iov_len)
+			break;
+	}
+	lock_release (&inode->data_lock);
 
 	return bytes_written;
 }
 
+/* Extends INODE to LENGTH bytes if it is shorter, as if zeros were
+ * written past its end, in transactions of its own.  Must not be
+ * called inside an operation.  Returns false if the disk is full. */
+bool
+inode_extend (struct inode *inode, off_t length) {
+	static const uint8_t zero;
+	bool success = true;
+
+	ASSERT (!journal_nested ());
+	lock_acquire (&inode->data_lock);
+	if (length > inode->data.length)
+		success = write_pieces (inode, &zero, 1, length - 1) == 1;
+	lock_release (&inode->data_lock);
+	return success;
+}
+
+/* Starts reading the sectors of INODE that hold the SIZE bytes at
+ * OFFSET into the buffer cache, without waiting for them.  Holes
+ * and bytes past the end of INODE are skipped. */
+void
+inode_read_ahead (struct inode *inode, off_t offset, off_t size) {
+	off_t length = inode_length (inode);
+	off_t end = offset + size < length ? offset + size : length;
+
+	offset = offset / DISK_SECTOR_SIZE * DISK_SECTOR_SIZE;
+	for (; offset < end; offset += DISK_SECTOR_SIZE) {
+		disk_sector_t sector = byte_to_sector (inode, offset);
+		if (sector != 0)
+			page_cache_prefetch (sector);
+	}
+}
+
 /* Disables writes to INODE.
    May be called at most once per inode opener. */
 	void
 inode_deny_write (struct inode *inode) 
 {
+	lock_acquire (&inode->lock);
 	inode->deny_write_cnt++;
 	ASSERT (inode->deny_write_cnt <= inode->open_cnt);
+	lock_release (&inode->lock);
 }
 
 /* Re-enables writes to INODE.
@@ -301,9 +836,46 @@ inode_deny_write (struct inode *inode)
  * inode_deny_write() on the inode, before closing the inode. */
 void
 inode_allow_write (struct inode *inode) {
+	lock_acquire (&inode->lock);
 	ASSERT (inode->deny_write_cnt > 0);
 	ASSERT (inode->deny_write_cnt <= inode->open_cnt);
 	inode->deny_write_cnt--;
+	lock_release (&inode->lock);
+}
+
+/* Returns the number of runs of consecutive sectors that INODE's
+ * data occupies.  Holes do not count. */
+size_t
+inode_extent_cnt (struct inode *inode) {
+	size_t idx, sectors = bytes_to_sectors (inode_length (inode));
+	size_t cnt = 0;
+	disk_sector_t prev = 0;
+
+	for (idx = 0; idx < sectors; idx++) {
+		disk_sector_t sector = data_sector (inode, idx, false);
+		if (sector != 0 && (prev == 0 || sector != prev + 1))
+			cnt++;
+		prev = sector;
+	}
+	return cnt;
+}
+
+/* Returns the inode sector of the index of directory INODE, or 0 if
+ * it has none. */
+disk_sector_t
+inode_get_dir_index (const struct inode *inode) {
+	return inode->data.dir_index;
+}
+
+/* Records SECTOR as the inode sector of the index of directory
+ * INODE.  The index is removed along with INODE.  The caller must
+ * hold INODE's directory lock. */
+void
+inode_set_dir_index (struct inode *inode, disk_sector_t sector) {
+	lock_acquire (&inode->data_lock);
+	inode->data.dir_index = sector;
+	page_cache_write_meta (inode->sector, &inode->data, 0, DISK_SECTOR_SIZE);
+	lock_release (&inode->data_lock);
 }
 
 /* Returns the length, in bytes, of INODE's data. */
@@ -311,3 +883,29 @@ off_t
 inode_length (const struct inode *inode) {
 	return inode->data.length;
 }
+
+/* Acquires the directory lock of INODE, which must be a directory.
+ * Held across a lookup and the update that depends on it so that
+ * entries are added and removed atomically. */
+void
+inode_lock_dir (struct inode *inode) {
+	lock_acquire (&inode->dir_lock);
+}
+
+/* Releases the directory lock of INODE. */
+void
+inode_unlock_dir (struct inode *inode) {
+	lock_release (&inode->dir_lock);
+}
+
+static uint64_t
+inode_hash (const struct hash_elem *e, void *aux UNUSED) {
+	return hash_int (hash_entry (e, struct inode, elem)->sector);
+}
+
+static bool
+inode_less (const struct hash_elem *a, const struct hash_elem *b,
+		void *aux UNUSED) {
+	return hash_entry (a, struct inode, elem)->sector
+		< hash_entry (b, struct inode, elem)->sector;
+}
@@ -0,0 +1,325 @@
+/* journal.c: Write-ahead journal of file system metadata.
+ *
+ * Creating, growing or removing a file changes several metadata
+ * sectors: the free map or the FAT, inode and index sectors and
+ * directory entries.  Written back one at a time, a crash in between
+ * would leave leaked sectors or entries that refer to free inodes.
+ * Instead, the buffer cache holds on to dirty metadata sectors until
+ * journal_commit() writes all of them, as one transaction, to the
+ * journal region, and only then to their home sectors.
+ *
+ * The journal region starts at JOURNAL_SECTOR with a descriptor that
+ * is followed by the sector images.  The descriptor, written after
+ * the images, is the commit record: once it is on disk the
+ * transaction is complete, and if the system stops before every home
+ * sector is written, journal_recover() copies the images again at
+ * the next boot.  After the home sectors are written the descriptor
+ * is cleared.
+ *
+ * Operations that change metadata run between journal_begin() and
+ * journal_end(), which nest.  A commit waits for a moment when no
+ * operation runs and holds new ones back until it is done, so a
+ * transaction only ever contains whole operations.  A commit groups
+ * every operation since the previous one.  Commits are made by the
+ * page cache daemon periodically, by journald when the buffer cache
+ * fills up with metadata, and when the file system is shut down.
+ *
+ * Since the buffer cache may not evict metadata before it is
+ * committed, an operation that found the cache full of it could not
+ * finish, and so the commit could not start.  Each operation
+ * therefore passes journal_begin() its credits, an upper bound on
+ * the metadata sectors it may dirty, counting the sectors of the free
+ * map or the FAT that the commit will write for it.  A new operation
+ * is only admitted while the dirty metadata in the cache, the dirty
+ * sectors of the free map or the FAT and the credits of every running
+ * operation stay within META_LIMIT; otherwise journal_begin() waits
+ * for running operations to end, or asks for a commit.  The rest of
+ * the cache is left for data.  Work that has no small bound, such as
+ * a large write or releasing a large file, is split into operations
+ * of their own.
+ * File data is written before the metadata that refers to it, and
+ * sectors that an operation frees only become free in the commit that
+ * includes it, so they are not overwritten while metadata on disk may
+ * still refer to them. */
+
+#include "filesys/journal.h"
+#include <debug.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "devices/disk.h"
+#include "filesys/filesys.h"
+#include "filesys/free-map.h"
+#include "threads/interrupt.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+#define JOURNAL_MAGIC 0x4a524e4c    /* "JRNL". */
+
+/* How many metadata sectors may be dirty in the buffer cache, or
+ * promised to running operations, in all. */
+#define META_LIMIT (PAGE_CACHE_SIZE * 3 / 4)
+
+/* Number of sector numbers that fit in a descriptor. */
+#define JOURNAL_MAX ((DISK_SECTOR_SIZE - 3 * sizeof (uint32_t)) \
+		/ sizeof (disk_sector_t))
+
+/* On-disk journal descriptor.
+ * Must be exactly DISK_SECTOR_SIZE bytes long. */
+struct journal_desc {
+	uint32_t magic;                     /* Journal magic number. */
+	uint32_t seq;                       /* Number of the transaction. */
+	uint32_t cnt;                       /* Sector images, 0 if none. */
+	disk_sector_t sectors[JOURNAL_MAX]; /* Home sector of each image. */
+};
+
+static struct journal_desc *desc;   /* Used by the committing thread. */
+
+/* ACTIVE_CNT operations are running, with CREDITS credits in all.
+ * COMMITTER, if non-null, is the thread making a commit, while which
+ * no operation runs.  All are protected by journal_lock, and
+ * journal_changed is signaled when any changes. */
+static struct lock journal_lock;
+static struct condition journal_changed;
+static int active_cnt;
+static size_t credits;
+static struct thread *committer;
+
+/* Wakes journald, if COMMIT_REQUESTED was false. */
+static struct semaphore commit_wanted;
+static bool commit_requested;
+
+/* Simulates a crash right after the next commit record is written.
+ * Set by tests via int 0x4b. */
+static bool crash_after_commit;
+
+static void request_commit (void);
+static void journald (void *aux UNUSED);
+static void register_journal_inspect_intr (void);
+
+/* Initializes the journal and starts journald. */
+void
+journal_init (void) {
+	ASSERT (sizeof *desc == DISK_SECTOR_SIZE);
+	ASSERT (JOURNAL_SECTORS - 1 <= JOURNAL_MAX);
+
+	desc = calloc (1, sizeof *desc);
+	if (desc == NULL)
+		PANIC ("cannot allocate journal descriptor");
+	lock_init (&journal_lock);
+	cond_init (&journal_changed);
+	sema_init (&commit_wanted, 0);
+	register_journal_inspect_intr ();
+
+	if (thread_create ("journald", PRI_DEFAULT, journald, NULL) == TID_ERROR)
+		PANIC ("cannot start journal daemon");
+}
+
+/* Writes an empty journal, while formatting the file system. */
+void
+journal_create (void) {
+	memset (desc, 0, sizeof *desc);
+	desc->magic = JOURNAL_MAGIC;
+	disk_write (filesys_disk, JOURNAL_SECTOR, desc);
+}
+
+/* Writes the sectors of a transaction that was committed but maybe
+ * not written in place back to their home sectors.  Must be called
+ * before anything else reads the file system. */
+void
+journal_recover (void) {
+	uint8_t *buffer;
+	size_t i;
+
+	disk_read (filesys_disk, JOURNAL_SECTOR, desc);
+	if (desc->magic != JOURNAL_MAGIC || desc->cnt == 0
+			|| desc->cnt > JOURNAL_SECTORS - 1)
+		return;
+
+	buffer = malloc (DISK_SECTOR_SIZE);
+	if (buffer == NULL)
+		PANIC ("cannot allocate journal buffer");
+	printf ("Recovering %"PRIu32" sectors from the journal...", desc->cnt);
+	for (i = 0; i < desc->cnt; i++) {
+		disk_read (filesys_disk, JOURNAL_SECTOR + 1 + i, buffer);
+		disk_write (filesys_disk, desc->sectors[i], buffer);
+	}
+	desc->cnt = 0;
+	disk_write (filesys_disk, JOURNAL_SECTOR, desc);
+	free (buffer);
+	printf ("done.\n");
+}
+
+/* Starts an operation that changes metadata and dirties at most
+ * OP_CREDITS metadata sectors.  Waits for a commit that is under way
+ * to end, and for room in the buffer cache if needed.  Nested calls
+ * only count the nesting: the outermost operation's credits must
+ * cover them. */
+void
+journal_begin (size_t op_credits) {
+	struct thread *curr = thread_current ();
+
+	ASSERT (op_credits <= META_LIMIT);
+
+	/* The committing thread writes the free map itself. */
+	if (committer == curr || curr->journal_depth++ > 0)
+		return;
+
+	lock_acquire (&journal_lock);
+	for (;;) {
+		size_t dirty = page_cache_meta_cnt () + free_map_dirty_cnt ();
+		if (committer == NULL
+				&& dirty + credits + op_credits <= META_LIMIT)
+			break;
+
+		/* Only a commit makes room if the operations that run now
+		 * would not, once they end. */
+		if (committer == NULL && dirty + op_credits > META_LIMIT)
+			request_commit ();
+		cond_wait (&journal_changed, &journal_lock);
+	}
+	active_cnt++;
+	credits += op_credits;
+	curr->journal_credits = op_credits;
+	lock_release (&journal_lock);
+}
+
+/* Ends an operation started with journal_begin(). */
+void
+journal_end (void) {
+	struct thread *curr = thread_current ();
+
+	if (committer == curr)
+		return;
+	ASSERT (curr->journal_depth > 0);
+	if (--curr->journal_depth > 0)
+		return;
+
+	lock_acquire (&journal_lock);
+	ASSERT (active_cnt > 0);
+	active_cnt--;
+	credits -= curr->journal_credits;
+	curr->journal_credits = 0;
+	cond_broadcast (&journal_changed, &journal_lock);
+	lock_release (&journal_lock);
+}
+
+/* Writes every change to metadata since the last commit to the
+ * journal as one transaction, and then in place. */
+void
+journal_commit (void) {
+	size_t cnt;
+
+	lock_acquire (&journal_lock);
+	while (committer != NULL || active_cnt > 0)
+		cond_wait (&journal_changed, &journal_lock);
+	committer = thread_current ();
+	commit_requested = false;
+	lock_release (&journal_lock);
+
+	/* Bring the allocation state into the buffer cache, and put the
+	 * data on disk before any metadata that refers to it. */
+	free_map_flush ();
+	page_cache_flush_data ();
+
+	cnt = page_cache_log_meta (JOURNAL_SECTOR + 1, desc->sectors,
+			JOURNAL_SECTORS - 1);
+	if (cnt > 0) {
+		desc->magic = JOURNAL_MAGIC;
+		desc->seq++;
+		desc->cnt = cnt;
+		disk_write (filesys_disk, JOURNAL_SECTOR, desc);
+		if (crash_after_commit)
+			disk_freeze (filesys_disk);
+
+		page_cache_checkpoint ();
+		desc->cnt = 0;
+		disk_write (filesys_disk, JOURNAL_SECTOR, desc);
+	}
+
+	lock_acquire (&journal_lock);
+	committer = NULL;
+	cond_broadcast (&journal_changed, &journal_lock);
+	lock_release (&journal_lock);
+}
+
+/* Asks journald to commit soon, because metadata is piling up in
+ * the buffer cache. */
+void
+journal_request_commit (void) {
+	lock_acquire (&journal_lock);
+	request_commit ();
+	lock_release (&journal_lock);
+}
+
+/* Does the work of journal_request_commit().  journal_lock must be
+ * held. */
+static void
+request_commit (void) {
+	if (!commit_requested) {
+		commit_requested = true;
+		sema_up (&commit_wanted);
+	}
+}
+
+/* Returns true if the running thread is making a commit. */
+bool
+journal_committing (void) {
+	return committer == thread_current ();
+}
+
+/* Returns true if the running thread is inside an operation or
+ * making a commit, so that journal_begin() would not start an
+ * operation of its own. */
+bool
+journal_nested (void) {
+	return committer == thread_current ()
+		|| thread_current ()->journal_depth > 0;
+}
+
+/* Journal thread.  Commits whenever journal_request_commit() asks
+ * for it. */
+static void
+journald (void *aux UNUSED) {
+	for (;;) {
+		sema_down (&commit_wanted);
+		journal_commit ();
+	}
+}
+
+static void
+inspect_journal (struct intr_frame *f) {
+	switch (f->R.rdx) {
+		case 0:
+			journal_commit ();
+			f->R.rax = desc->seq;
+			break;
+		case 1:
+			crash_after_commit = true;
+			journal_commit ();
+			disk_freeze (filesys_disk);
+			f->R.rax = desc->seq;
+			break;
+		case 2:
+			disk_freeze (filesys_disk);
+			f->R.rax = 0;
+			break;
+		default:
+			f->R.rax = -1;
+			break;
+	}
+}
+
+/* Tool for testing the journal. Calling this function via int 0x4b.
+ * Input:
+ *   @RDX - 0 to commit, 1 to commit and then crash before anything is
+ *          written in place, 2 to crash at once.  A crash drops every
+ *          later write to the file system disk.
+ * Output:
+ *   @RAX - The number of the last transaction, for 0 and 1. */
+static void
+register_journal_inspect_intr (void) {
+	intr_register_int (0x4b, 3, INTR_ON, inspect_journal,
+			"Inspect Journal");
+}
@@ -1,5 +1,29 @@
-/* page_cache.c: Implementation of Page Cache (Buffer Cache). */
+/* page_cache.c: Implementation of Page Cache (Buffer Cache).
+ *
+ * Every sector of the file system disk that inodes read or write,
+ * whether for read(), write() or a file-backed mmap page, goes
+ * through a cache of PAGE_CACHE_SIZE sectors.  Reads that hit and
+ * all writes only touch memory.  Dirty data sectors reach the disk
+ * when they are evicted or a journal commit writes them.  Dirty
+ * metadata sectors, written with page_cache_write_meta(), stay in the
+ * cache until a commit logs them and writes them in place, which
+ * page_cache_kworkerd does periodically (see journal.c).  They are
+ * never evicted before that; a thread that finds no other entry to
+ * evict asks for a commit and waits for it.  Sectors
+ * that a sequential reader is about to need are queued by
+ * page_cache_prefetch() and read in the background by
+ * page_cache_prefetchd. */
 
+#include "filesys/page_cache.h"
+#include <debug.h>
+#include <string.h>
+#include "devices/timer.h"
+#include "filesys/filesys.h"
+#include "filesys/journal.h"
+#include "threads/interrupt.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
 #include "vm/vm.h"
 static bool page_cache_readahead (struct page *page, void *kva);
 static bool page_cache_writeback (struct page *page);
@@ -14,11 +38,425 @@ static const struct page_operations page_cache_op = {
 };
 
 tid_t page_cache_workerd;
+static tid_t page_cache_prefetcher;
+
+/* Ticks between two commits by the write-back daemon, which bounds
+ * how much work a crash can lose to about five seconds. */
+#define FLUSH_INTERVAL (5 * TIMER_FREQ)
+
+/* A cached sector.
+ *
+ * SECTOR, VALID, USERS and ACCESSED belong to the cache map and are
+ * protected by cache_lock.  An entry with USERS > 0 is never
+ * evicted, so its SECTOR stays put while it is used.  LOCK protects
+ * DATA, LOADED, DIRTY, META and LOGGED.  A dirty entry with META set
+ * is not evicted either, since it may only be written in place after
+ * a journal commit. */
+struct cache_entry {
+	disk_sector_t sector;       /* Sector held, if VALID. */
+	bool valid;                 /* Holds a sector? */
+	int users;                  /* Threads using the entry. */
+	bool accessed;              /* Used since the clock hand passed? */
+	struct lock lock;           /* Protects the members below. */
+	bool loaded;                /* DATA holds the sector's contents? */
+	bool dirty;                 /* DATA differs from the disk? */
+	bool meta;                  /* Dirty with metadata? */
+	bool logged;                /* In the journal, not yet in place? */
+	uint8_t *data;              /* DISK_SECTOR_SIZE bytes. */
+};
+
+static struct cache_entry cache[PAGE_CACHE_SIZE];
+static struct lock cache_lock;
+static struct condition cache_idle;   /* Signaled when USERS drops to 0. */
+static size_t clock_hand;
+
+/* Number of entries with META set, protected by cache_lock.  Past
+ * META_HIGH_WATER, a journal commit is requested so that enough
+ * entries stay evictable; journal_begin() also holds new operations
+ * back while it is high. */
+static size_t meta_cnt;
+#define META_HIGH_WATER (PAGE_CACHE_SIZE * 3 / 4)
+
+/* Statistics, read by tests via int 0x49. */
+static long long hit_cnt;
+static long long miss_cnt;
+static long long writeback_cnt;
+static long long flush_cnt;         /* Calls to page_cache_flush_data(). */
+static long long prefetch_cnt;      /* Misses taken by read-ahead. */
+
+/* Sectors waiting to be read ahead, a ring indexed by free-running
+ * counters.  Protected by cache_lock. */
+#define PREFETCH_QUEUE_SIZE 32
+static disk_sector_t prefetch_queue[PREFETCH_QUEUE_SIZE];
+static unsigned prefetch_head, prefetch_tail;
+static struct condition prefetch_pending;   /* Signaled on enqueue. */
+
+static struct cache_entry *cache_get (disk_sector_t, bool load);
+static void cache_put (struct cache_entry *);
+static struct cache_entry *cache_lookup (disk_sector_t);
+static struct cache_entry *cache_evict (void);
+static void cache_write (disk_sector_t, const void *buffer, int sector_ofs,
+		int size, bool meta);
+static void page_cache_kworkerd (void *aux);
+static void page_cache_prefetchd (void *aux);
+static void register_page_cache_inspect_intr (void);
+
+/* Initializes the buffer cache and starts its write-back and
+ * read-ahead daemons. */
+void
+page_cache_init (void) {
+	uint8_t *pages;
+	size_t i;
+
+	pages = palloc_get_multiple (PAL_ASSERT,
+			PAGE_CACHE_SIZE * DISK_SECTOR_SIZE / PGSIZE);
+	lock_init (&cache_lock);
+	cond_init (&cache_idle);
+	cond_init (&prefetch_pending);
+	for (i = 0; i < PAGE_CACHE_SIZE; i++) {
+		struct cache_entry *e = &cache[i];
+		e->valid = false;
+		e->users = 0;
+		e->accessed = false;
+		lock_init (&e->lock);
+		e->loaded = false;
+		e->dirty = false;
+		e->meta = false;
+		e->logged = false;
+		e->data = pages + i * DISK_SECTOR_SIZE;
+	}
+	register_page_cache_inspect_intr ();
+
+	page_cache_workerd = thread_create ("page_cache_kworkerd", PRI_DEFAULT,
+			page_cache_kworkerd, NULL);
+	if (page_cache_workerd == TID_ERROR)
+		PANIC ("cannot start page cache daemon");
+	page_cache_prefetcher = thread_create ("page_cache_prefetchd",
+			PRI_DEFAULT, page_cache_prefetchd, NULL);
+	if (page_cache_prefetcher == TID_ERROR)
+		PANIC ("cannot start page cache read-ahead daemon");
+}
+
+/* Reads SIZE bytes at byte SECTOR_OFS of SECTOR into BUFFER. */
+void
+page_cache_read (disk_sector_t sector, void *buffer, int sector_ofs,
+		int size) {
+	ASSERT (sector_ofs >= 0 && size >= 0);
+	ASSERT (sector_ofs + size <= DISK_SECTOR_SIZE);
+
+	struct cache_entry *e = cache_get (sector, true);
+	memcpy (buffer, e->data + sector_ofs, size);
+	cache_put (e);
+}
+
+/* Writes SIZE bytes from BUFFER at byte SECTOR_OFS of SECTOR.  The
+ * sector is only read from disk first if the write covers part of
+ * it and it is not cached. */
+void
+page_cache_write (disk_sector_t sector, const void *buffer, int sector_ofs,
+		int size) {
+	cache_write (sector, buffer, sector_ofs, size, false);
+}
+
+/* Like page_cache_write(), for a sector that holds metadata.  The
+ * sector then reaches the disk through the journal. */
+void
+page_cache_write_meta (disk_sector_t sector, const void *buffer,
+		int sector_ofs, int size) {
+	cache_write (sector, buffer, sector_ofs, size, true);
+}
+
+static void
+cache_write (disk_sector_t sector, const void *buffer, int sector_ofs,
+		int size, bool meta) {
+	bool became_meta = false;
+
+	ASSERT (sector_ofs >= 0 && size >= 0);
+	ASSERT (sector_ofs + size <= DISK_SECTOR_SIZE);
+
+	struct cache_entry *e = cache_get (sector, size < DISK_SECTOR_SIZE);
+	memcpy (e->data + sector_ofs, buffer, size);
+	e->loaded = true;
+	e->dirty = true;
+	if (meta && !e->meta) {
+		e->meta = true;
+		became_meta = true;
+	}
+	cache_put (e);
+
+	if (became_meta) {
+		lock_acquire (&cache_lock);
+		bool full = ++meta_cnt >= META_HIGH_WATER;
+		lock_release (&cache_lock);
+		if (full)
+			journal_request_commit ();
+	}
+}
+
+/* Asks for SECTOR to be read into the cache in the background.
+ * Does nothing if SECTOR is already cached or too many sectors are
+ * already waiting; read-ahead is only a hint. */
+void
+page_cache_prefetch (disk_sector_t sector) {
+	lock_acquire (&cache_lock);
+	if (cache_lookup (sector) == NULL
+			&& prefetch_tail - prefetch_head < PREFETCH_QUEUE_SIZE) {
+		prefetch_queue[prefetch_tail++ % PREFETCH_QUEUE_SIZE] = sector;
+		cond_signal (&prefetch_pending, &cache_lock);
+	}
+	lock_release (&cache_lock);
+}
+
+/* Returns entry I with its lock held, or a null pointer if it holds
+ * no sector.  Release the entry with cache_put(). */
+static struct cache_entry *
+cache_get_slot (size_t i) {
+	struct cache_entry *e = &cache[i];
+
+	lock_acquire (&cache_lock);
+	if (!e->valid) {
+		lock_release (&cache_lock);
+		return NULL;
+	}
+	e->users++;
+	lock_release (&cache_lock);
+
+	lock_acquire (&e->lock);
+	return e;
+}
+
+/* Writes entry E, which must be dirty and locked, in place. */
+static void
+cache_write_back (struct cache_entry *e) {
+	disk_write (filesys_disk, e->sector, e->data);
+	e->dirty = false;
+	writeback_cnt++;
+	if (e->meta) {
+		e->meta = false;
+		lock_acquire (&cache_lock);
+		meta_cnt--;
+		lock_release (&cache_lock);
+	}
+}
+
+/* Writes every dirty sector back to disk, bypassing the journal.
+ * Only for shutdown, after the last commit. */
+void
+page_cache_flush (void) {
+	size_t i;
+
+	for (i = 0; i < PAGE_CACHE_SIZE; i++) {
+		struct cache_entry *e = cache_get_slot (i);
+		if (e != NULL) {
+			if (e->dirty)
+				cache_write_back (e);
+			cache_put (e);
+		}
+	}
+}
+
+/* Writes every dirty sector that does not hold metadata back to
+ * disk. */
+void
+page_cache_flush_data (void) {
+	size_t i;
+
+	flush_cnt++;
+	for (i = 0; i < PAGE_CACHE_SIZE; i++) {
+		struct cache_entry *e = cache_get_slot (i);
+		if (e != NULL) {
+			if (e->dirty && !e->meta)
+				cache_write_back (e);
+			cache_put (e);
+		}
+	}
+}
+
+/* Writes the contents of up to MAX dirty metadata sectors to
+ * consecutive sectors of the disk from START, and their sector
+ * numbers to SECTORS.  Returns the number of sectors written.  The
+ * entries stay in the cache until page_cache_checkpoint().  The
+ * caller must make sure that no metadata changes meanwhile. */
+size_t
+page_cache_log_meta (disk_sector_t start, disk_sector_t sectors[],
+		size_t max) {
+	size_t cnt = 0;
+	size_t i;
+
+	for (i = 0; i < PAGE_CACHE_SIZE && cnt < max; i++) {
+		struct cache_entry *e = cache_get_slot (i);
+		if (e == NULL)
+			continue;
+		if (e->dirty && e->meta) {
+			disk_write (filesys_disk, start + cnt, e->data);
+			sectors[cnt++] = e->sector;
+			e->logged = true;
+
+			/* Keep USERS raised, so that E is not evicted. */
+			lock_release (&e->lock);
+		} else
+			cache_put (e);
+	}
+	return cnt;
+}
+
+/* Writes the sectors logged by page_cache_log_meta() in place. */
+void
+page_cache_checkpoint (void) {
+	size_t i;
+
+	for (i = 0; i < PAGE_CACHE_SIZE; i++) {
+		struct cache_entry *e = &cache[i];
+
+		/* Only the committing thread sets or clears LOGGED, so it
+		 * can be read without the lock. */
+		if (!e->logged)
+			continue;
+		lock_acquire (&e->lock);
+		e->logged = false;
+		if (e->dirty)
+			cache_write_back (e);
+		cache_put (e);
+	}
+}
+
+/* Returns the number of cached sectors that hold metadata not yet
+ * written in place. */
+size_t
+page_cache_meta_cnt (void) {
+	size_t cnt;
+
+	lock_acquire (&cache_lock);
+	cnt = meta_cnt;
+	lock_release (&cache_lock);
+	return cnt;
+}
+
+/* Returns the entry for SECTOR with its lock held, evicting another
+ * sector if SECTOR is not cached.  If LOAD, the entry's data is read
+ * from disk unless it already is; otherwise the caller must fill the
+ * whole sector.  Release the entry with cache_put(). */
+static struct cache_entry *
+cache_get (disk_sector_t sector, bool load) {
+	struct cache_entry *e;
+	bool commit_requested = false;
+
+	lock_acquire (&cache_lock);
+	for (;;) {
+		e = cache_lookup (sector);
+		if (e != NULL) {
+			hit_cnt++;
+			break;
+		}
+		e = cache_evict ();
+		if (e != NULL && e->valid) {
+			/* E is dirty.  Write it back without holding cache_lock,
+			 * so that other sectors stay usable meanwhile; E stays
+			 * valid, so nobody reads its sector from disk before it is
+			 * there.  Then look again, since SECTOR may have been
+			 * brought in and E may have been used meanwhile. */
+			e->users++;
+			lock_release (&cache_lock);
+			lock_acquire (&e->lock);
+			if (e->dirty)
+				cache_write_back (e);
+			cache_put (e);
+			lock_acquire (&cache_lock);
+			continue;
+		}
+		if (e != NULL) {
+			miss_cnt++;
+			if (thread_tid () == page_cache_prefetcher)
+				prefetch_cnt++;
+			e->sector = sector;
+			e->valid = true;
+			e->loaded = false;
+			break;
+		}
+		/* Every entry is in use or holds metadata that a commit has
+		 * to write first.  The commit cannot wait for an entry
+		 * itself: journal_begin() keeps enough of them free for it. */
+		if (meta_cnt > 0 && !commit_requested) {
+			if (journal_committing ())
+				PANIC ("buffer cache full of uncommitted metadata");
+			lock_release (&cache_lock);
+			journal_request_commit ();
+			lock_acquire (&cache_lock);
+			commit_requested = true;
+			continue;
+		}
+		/* Wait and look again, since the sector may have been
+		 * brought in meanwhile. */
+		cond_wait (&cache_idle, &cache_lock);
+		commit_requested = false;
+	}
+	e->users++;
+	e->accessed = true;
+	lock_release (&cache_lock);
+
+	lock_acquire (&e->lock);
+	if (!e->loaded && load) {
+		disk_read (filesys_disk, sector, e->data);
+		e->loaded = true;
+	}
+	return e;
+}
+
+/* Releases entry E, obtained from cache_get(). */
+static void
+cache_put (struct cache_entry *e) {
+	lock_release (&e->lock);
+
+	lock_acquire (&cache_lock);
+	if (--e->users == 0)
+		cond_signal (&cache_idle, &cache_lock);
+	lock_release (&cache_lock);
+}
+
+/* Returns the entry holding SECTOR, or NULL.  cache_lock must be
+ * held. */
+static struct cache_entry *
+cache_lookup (disk_sector_t sector) {
+	size_t i;
+
+	for (i = 0; i < PAGE_CACHE_SIZE; i++)
+		if (cache[i].valid && cache[i].sector == sector)
+			return &cache[i];
+	return NULL;
+}
+
+/* Chooses an entry with the clock algorithm.  Returns it, no longer
+ * valid, if it is clean; if it is dirty, returns it still valid, for
+ * the caller to write back before looking again.  Returns NULL if
+ * every entry is in use or holds metadata that has not been
+ * committed.  cache_lock must be held. */
+static struct cache_entry *
+cache_evict (void) {
+	size_t i;
+
+	for (i = 0; i < 2 * PAGE_CACHE_SIZE; i++) {
+		struct cache_entry *e = &cache[clock_hand];
+		clock_hand = (clock_hand + 1) % PAGE_CACHE_SIZE;
+
+		if (e->users > 0 || (e->valid && e->meta))
+			continue;
+		if (e->valid && e->accessed) {
+			e->accessed = false;
+			continue;
+		}
+		/* Nobody uses E, so nobody holds its lock either. */
+		if (!(e->valid && e->dirty))
+			e->valid = false;
+		return e;
+	}
+	return NULL;
+}
 
 /* The initializer of file vm */
 void
 pagecache_init (void) {
-	/* TODO: Create a worker daemon for page cache with page_cache_kworkerd */
+	/* The buffer cache and its daemon are started by page_cache_init()
+	 * from filesys_init(), since they are needed without VM too. */
 }
 
 /* Initialize the page cache */
@@ -44,7 +482,68 @@ static void
 page_cache_destroy (struct page *page) {
 }
 
-/* Worker thread for page cache */
+/* Worker thread for page cache.  Commits the journal, which also
+ * writes dirty data back, every FLUSH_INTERVAL ticks, bounding what a
+ * crash can lose. */
+static void
+page_cache_kworkerd (void *aux UNUSED) {
+	for (;;) {
+		timer_sleep (FLUSH_INTERVAL);
+		journal_commit ();
+	}
+}
+
+/* Read-ahead thread.  Brings queued sectors into the cache, so that
+ * a reader that reaches them finds them cached, or at worst waits on
+ * the entry lock for a read that is already under way. */
+static void
+page_cache_prefetchd (void *aux UNUSED) {
+	for (;;) {
+		disk_sector_t sector;
+
+		lock_acquire (&cache_lock);
+		while (prefetch_head == prefetch_tail)
+			cond_wait (&prefetch_pending, &cache_lock);
+		sector = prefetch_queue[prefetch_head++ % PREFETCH_QUEUE_SIZE];
+		lock_release (&cache_lock);
+
+		cache_put (cache_get (sector, true));
+	}
+}
+
+static void
+inspect_page_cache (struct intr_frame *f) {
+	switch (f->R.rdx) {
+		case 0:
+			f->R.rax = hit_cnt;
+			break;
+		case 1:
+			f->R.rax = miss_cnt;
+			break;
+		case 2:
+			f->R.rax = writeback_cnt;
+			break;
+		case 3:
+			f->R.rax = flush_cnt;
+			break;
+		case 4:
+			f->R.rax = prefetch_cnt;
+			break;
+		default:
+			f->R.rax = -1;
+			break;
+	}
+}
+
+/* Tool for testing the buffer cache. Calling this function via int 0x49.
+ * Input:
+ *   @RDX - 0 for hits, 1 for misses, 2 for sectors written back,
+ *          3 for passes that wrote all dirty data back, 4 for the
+ *          misses among 1 taken by read-ahead
+ * Output:
+ *   @RAX - The requested count since boot. */
 static void
-page_cache_kworkerd (void *aux) {
+register_page_cache_inspect_intr (void) {
+	intr_register_int (0x49, 3, INTR_OFF, inspect_page_cache,
+			"Inspect Page Cache");
 }
@@ -0,0 +1,307 @@
+/* pipe.c: Pipes between processes.
+ *
+ * A pipe is a one-page ring buffer with a read end and a write end,
+ * each an ordinary `struct file' so that it lives in descriptor
+ * tables, survives fork() and is shared by dup2().  Like an intq,
+ * readers sleep while the buffer is empty and writers while it is
+ * full, but any number of threads may wait on either side. */
+
+#include "filesys/pipe.h"
+#include <debug.h>
+#include <string.h>
+#include "filesys/file.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+
+struct pipe {
+	struct lock lock;           /* Protects all members. */
+	struct condition not_empty; /* Signaled when data is added. */
+	struct condition not_full;  /* Signaled when data is removed. */
+	uint8_t *buf;               /* PIPE_SIZE bytes. */
+	size_t head;                /* Bytes ever written. */
+	size_t tail;                /* Bytes ever read. */
+	int readers;                /* Open read ends. */
+	int writers;                /* Open write ends. */
+};
+
+static size_t readable_run (const struct pipe *, size_t size);
+static size_t writable_run (const struct pipe *, size_t size);
+static bool wait_readable (struct pipe *);
+static bool wait_writable (struct pipe *);
+static void copy_out (struct pipe *, void *dst, size_t size);
+static void copy_in (struct pipe *, const void *src, size_t size);
+
+/* Creates a pipe and stores its two ends in *READ_END and
+ * *WRITE_END.  Returns false if memory allocation fails. */
+bool
+pipe_create (struct file **read_end, struct file **write_end) {
+	struct pipe *pipe = malloc (sizeof *pipe);
+	if (pipe == NULL)
+		return false;
+	pipe->buf = palloc_get_page (0);
+	if (pipe->buf == NULL) {
+		free (pipe);
+		return false;
+	}
+	lock_init (&pipe->lock);
+	cond_init (&pipe->not_empty);
+	cond_init (&pipe->not_full);
+	pipe->head = pipe->tail = 0;
+	pipe->readers = pipe->writers = 0;
+
+	*read_end = file_open_pipe (pipe, false);
+	*write_end = file_open_pipe (pipe, true);
+	if (*read_end == NULL || *write_end == NULL) {
+		/* Closing the ends that did open frees PIPE once both
+		 * counts drop to zero; free it here if neither opened. */
+		bool opened = *read_end != NULL || *write_end != NULL;
+		file_close (*read_end);
+		file_close (*write_end);
+		if (!opened) {
+			palloc_free_page (pipe->buf);
+			free (pipe);
+		}
+		return false;
+	}
+	return true;
+}
+
+/* Records that a new read end, or write end if WRITER, of PIPE was
+ * opened. */
+void
+pipe_attach (struct pipe *pipe, bool writer) {
+	lock_acquire (&pipe->lock);
+	if (writer)
+		pipe->writers++;
+	else
+		pipe->readers++;
+	lock_release (&pipe->lock);
+}
+
+/* Records that a read end, or write end if WRITER, of PIPE was
+ * closed, waking whoever waits for the other side, and frees PIPE
+ * once no end is left. */
+void
+pipe_detach (struct pipe *pipe, bool writer) {
+	lock_acquire (&pipe->lock);
+	if (writer) {
+		ASSERT (pipe->writers > 0);
+		pipe->writers--;
+		cond_broadcast (&pipe->not_empty, &pipe->lock);
+	} else {
+		ASSERT (pipe->readers > 0);
+		pipe->readers--;
+		cond_broadcast (&pipe->not_full, &pipe->lock);
+	}
+	bool dead = pipe->readers == 0 && pipe->writers == 0;
+	lock_release (&pipe->lock);
+
+	if (dead) {
+		palloc_free_page (pipe->buf);
+		free (pipe);
+	}
+}
+
+/* Reads up to SIZE bytes from PIPE into BUFFER.  Sleeps until some
+ * data is buffered, then returns what is there without waiting for
+ * more.  Returns 0 at end of file, when the buffer is empty and no
+ * write end is open. */
+off_t
+pipe_read (struct pipe *pipe, void *buffer, off_t size) {
+	struct iovec iov = { .iov_base = buffer, .iov_len = size };
+	return pipe_readv (pipe, &iov, 1);
+}
+
+/* Like pipe_read(), but scatters the data over the IOVCNT segments
+ * of IOV in order. */
+off_t
+pipe_readv (struct pipe *pipe, const struct iovec *iov, int iovcnt) {
+	size_t total = 0;
+	off_t bytes_read = 0;
+
+	for (int i = 0; i < iovcnt; i++)
+		total += iov[i].iov_len;
+	if (total == 0)
+		return 0;
+
+	lock_acquire (&pipe->lock);
+	if (wait_readable (pipe)) {
+		for (int i = 0; i < iovcnt && pipe->head != pipe->tail; i++) {
+			size_t n = pipe->head - pipe->tail;
+			if (n > iov[i].iov_len)
+				n = iov[i].iov_len;
+			copy_out (pipe, iov[i].iov_base, n);
+			bytes_read += n;
+		}
+		cond_broadcast (&pipe->not_full, &pipe->lock);
+	}
+	lock_release (&pipe->lock);
+	return bytes_read;
+}
+
+/* Writes SIZE bytes from BUFFER into PIPE, sleeping whenever the
+ * buffer is full.  Returns the number of bytes written, which is
+ * less than SIZE only if every read end was closed meanwhile, or -1
+ * if none was open to begin with. */
+off_t
+pipe_write (struct pipe *pipe, const void *buffer, off_t size) {
+	struct iovec iov = { .iov_base = (void *) buffer, .iov_len = size };
+	return pipe_writev (pipe, &iov, 1);
+}
+
+/* Like pipe_write(), but gathers the data from the IOVCNT segments
+ * of IOV in order. */
+off_t
+pipe_writev (struct pipe *pipe, const struct iovec *iov, int iovcnt) {
+	off_t bytes_written = 0;
+
+	lock_acquire (&pipe->lock);
+	if (pipe->readers == 0) {
+		lock_release (&pipe->lock);
+		return -1;
+	}
+	for (int i = 0; i < iovcnt; i++) {
+		const uint8_t *src = iov[i].iov_base;
+		size_t ofs = 0;
+		while (ofs < iov[i].iov_len && wait_writable (pipe)) {
+			size_t n = PIPE_SIZE - (pipe->head - pipe->tail);
+			if (n > iov[i].iov_len - ofs)
+				n = iov[i].iov_len - ofs;
+			copy_in (pipe, src + ofs, n);
+			ofs += n;
+			cond_broadcast (&pipe->not_empty, &pipe->lock);
+		}
+		bytes_written += ofs;
+		if (ofs < iov[i].iov_len)
+			break;
+	}
+	lock_release (&pipe->lock);
+	return bytes_written;
+}
+
+/* Moves up to SIZE bytes from PIPE to FILE at its current position,
+ * writing straight out of the pipe's buffer.  Waits for data like
+ * pipe_read().  Returns the number of bytes moved. */
+off_t
+pipe_splice_to_file (struct pipe *pipe, struct file *file, off_t size) {
+	off_t moved = 0;
+
+	lock_acquire (&pipe->lock);
+	if (size > 0 && wait_readable (pipe)) {
+		size_t run;
+		while ((run = readable_run (pipe, size - moved)) > 0) {
+			off_t n = file_write (file, pipe->buf + pipe->tail % PIPE_SIZE, run);
+			pipe->tail += n;
+			moved += n;
+			if ((size_t) n < run)
+				break;
+		}
+		cond_broadcast (&pipe->not_full, &pipe->lock);
+	}
+	lock_release (&pipe->lock);
+	return moved;
+}
+
+/* Moves up to SIZE bytes from FILE at its current position to PIPE,
+ * reading straight into the pipe's buffer.  Waits for room like
+ * pipe_write() and stops early at the end of FILE.  Returns the
+ * number of bytes moved, or -1 if no read end is open. */
+off_t
+pipe_splice_from_file (struct pipe *pipe, struct file *file, off_t size) {
+	off_t moved = 0;
+	bool eof = false;
+
+	lock_acquire (&pipe->lock);
+	if (pipe->readers == 0) {
+		lock_release (&pipe->lock);
+		return -1;
+	}
+	while (!eof && moved < size && wait_writable (pipe)) {
+		size_t run;
+		while ((run = writable_run (pipe, size - moved)) > 0) {
+			off_t n = file_read (file, pipe->buf + pipe->head % PIPE_SIZE, run);
+			pipe->head += n;
+			moved += n;
+			if ((size_t) n < run) {
+				eof = true;
+				break;
+			}
+		}
+		cond_broadcast (&pipe->not_empty, &pipe->lock);
+	}
+	lock_release (&pipe->lock);
+	return moved;
+}
+
+/* Returns how many of at most SIZE buffered bytes of PIPE can be
+ * taken from one contiguous run of its buffer. */
+static size_t
+readable_run (const struct pipe *pipe, size_t size) {
+	size_t run = PIPE_SIZE - pipe->tail % PIPE_SIZE;
+	if (run > pipe->head - pipe->tail)
+		run = pipe->head - pipe->tail;
+	return run < size ? run : size;
+}
+
+/* Returns how many of at most SIZE bytes fit into one contiguous
+ * run of PIPE's free space. */
+static size_t
+writable_run (const struct pipe *pipe, size_t size) {
+	size_t run = PIPE_SIZE - pipe->head % PIPE_SIZE;
+	if (run > PIPE_SIZE - (pipe->head - pipe->tail))
+		run = PIPE_SIZE - (pipe->head - pipe->tail);
+	return run < size ? run : size;
+}
+
+/* Removes SIZE buffered bytes from PIPE into DST. */
+static void
+copy_out (struct pipe *pipe, void *dst, size_t size) {
+	uint8_t *p = dst;
+	size_t run;
+
+	while ((run = readable_run (pipe, size)) > 0) {
+		memcpy (p, pipe->buf + pipe->tail % PIPE_SIZE, run);
+		pipe->tail += run;
+		p += run;
+		size -= run;
+	}
+}
+
+/* Appends SIZE bytes from SRC to PIPE, which must have room. */
+static void
+copy_in (struct pipe *pipe, const void *src, size_t size) {
+	const uint8_t *p = src;
+	size_t run;
+
+	while ((run = writable_run (pipe, size)) > 0) {
+		memcpy (pipe->buf + pipe->head % PIPE_SIZE, p, run);
+		pipe->head += run;
+		p += run;
+		size -= run;
+	}
+}
+
+/* Waits until PIPE holds data.  Returns false instead if it is empty
+ * and has no write end.  PIPE's lock must be held. */
+static bool
+wait_readable (struct pipe *pipe) {
+	while (pipe->head == pipe->tail) {
+		if (pipe->writers == 0)
+			return false;
+		cond_wait (&pipe->not_empty, &pipe->lock);
+	}
+	return true;
+}
+
+/* Waits until PIPE has free space.  Returns false instead if it has
+ * no read end.  PIPE's lock must be held. */
+static bool
+wait_writable (struct pipe *pipe) {
+	while (pipe->head - pipe->tail == PIPE_SIZE) {
+		if (pipe->readers == 0)
+			return false;
+		cond_wait (&pipe->not_full, &pipe->lock);
+	}
+	return pipe->readers > 0;
+}
@@ -0,0 +1,20 @@
+#ifndef FILESYS_DCACHE_H
+#define FILESYS_DCACHE_H
+#include <stdbool.h>
+#include <stdint.h>
+#include "devices/disk.h"
+
+/* Number of names the directory lookup cache holds. */
+#define DCACHE_SIZE 128
+
+/* Sector recorded for a name that is known not to exist. */
+#define DCACHE_ABSENT UINT32_MAX
+
+void dcache_init (void);
+bool dcache_lookup (disk_sector_t parent, const char *name,
+		disk_sector_t *sectorp);
+void dcache_insert (disk_sector_t parent, const char *name,
+		disk_sector_t sector);
+void dcache_invalidate (disk_sector_t parent, const char *name);
+void dcache_purge (disk_sector_t parent);
+#endif
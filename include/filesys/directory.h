@@ -24,7 +24,8 @@ struct inode *dir_get_inode (struct dir *);
 /* Reading and writing. */
 bool dir_lookup (const struct dir *, const char *name, struct inode **);
 bool dir_add (struct dir *, const char *name, disk_sector_t);
-bool dir_remove (struct dir *, const char *name);
+bool dir_remove (struct dir *, const char *name, struct inode **);
+void dir_update_index (struct dir *);
 bool dir_readdir (struct dir *, char name[NAME_MAX + 1]);
 
 #endif /* filesys/directory.h */
@@ -3,6 +3,7 @@
 
 #include "devices/disk.h"
 #include "filesys/file.h"
+#include "threads/synch.h"
 #include <inttypes.h>
 #include <stdbool.h>
 #include <stddef.h>
@@ -22,7 +23,7 @@ void fat_init (void);
 void fat_open (void);
 void fat_close (void);
 void fat_create (void);
-void fat_close (void);
+void fat_flush (void);
 
 cluster_t fat_create_chain (
     cluster_t clst /* Cluster # to stretch, 0: Create a new chain */
@@ -31,8 +32,34 @@ void fat_remove_chain (
     cluster_t clst, /* Cluster # to be removed */
     cluster_t pclst /* Previous cluster of clst, 0: clst is the start of chain */
 );
+cluster_t fat_remove_chain_part (cluster_t clst, size_t cnt);
+size_t fat_dirty_cnt (void);
 cluster_t fat_get (cluster_t clst);
 void fat_put (cluster_t clst, cluster_t val);
 disk_sector_t cluster_to_sector (cluster_t clst);
+cluster_t sector_to_cluster (disk_sector_t sector);
+void fat_stats (size_t *free_cnt, size_t *extent_cnt, size_t *largest);
+
+/* Clusters between two remembered positions of a chain. */
+#define FAT_CHAIN_STRIDE 64
+
+/* Positions found so far in one cluster chain, so that finding the
+ * Nth cluster walks at most FAT_CHAIN_STRIDE links instead of the
+ * whole chain.  MARKS[i] is the cluster at position
+ * (i + 1) * FAT_CHAIN_STRIDE.  Only valid while the chain is not
+ * shortened. */
+struct fat_chain {
+	cluster_t start;            /* First cluster, 0 for an empty chain. */
+	cluster_t *marks;           /* Remembered clusters, see above. */
+	size_t mark_cnt;            /* Number of valid MARKS. */
+	size_t mark_cap;            /* Number of allocated MARKS. */
+	size_t last_pos;            /* Position of the last lookup... */
+	cluster_t last_clst;        /* ...and the cluster found there. */
+	struct lock lock;           /* Protects the members above. */
+};
+
+void fat_chain_init (struct fat_chain *, cluster_t start);
+void fat_chain_destroy (struct fat_chain *);
+cluster_t fat_chain_get (struct fat_chain *, size_t pos, bool create);
 
 #endif /* filesys/fat.h */
@@ -10,8 +10,17 @@ void free_map_read (void);
 void free_map_create (void);
 void free_map_open (void);
 void free_map_close (void);
+void free_map_flush (void);
 
 bool free_map_allocate (size_t, disk_sector_t *);
+size_t free_map_allocate_near (disk_sector_t goal, size_t cnt,
+		disk_sector_t *);
+size_t free_map_reserve_near (disk_sector_t goal, size_t cnt,
+		disk_sector_t *);
+void free_map_claim (disk_sector_t);
+void free_map_unreserve (disk_sector_t, size_t);
 void free_map_release (disk_sector_t, size_t);
+size_t free_map_dirty_cnt (void);
+void free_map_stats (size_t *free_cnt, size_t *extent_cnt, size_t *largest);
 
 #endif /* filesys/free-map.h */
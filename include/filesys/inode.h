@@ -4,9 +4,16 @@
 #include <stdbool.h>
 #include "filesys/off_t.h"
 #include "devices/disk.h"
+#include <iovec.h>
 
 struct bitmap;
 
+/* Metadata sectors that a write to SECTORS sectors of an inode may
+ * dirty: the inode, up to 4 index sectors, the data itself if it is
+ * metadata, and a free map or FAT sector for each sector allocated
+ * and for the end of the chain of clusters it extends. */
+#define INODE_WRITE_CREDITS(SECTORS) (2 * (SECTORS) + 9)
+
 void inode_init (void);
 bool inode_create (disk_sector_t, off_t);
 struct inode *inode_open (disk_sector_t);
@@ -14,10 +21,23 @@ struct inode *inode_reopen (struct inode *);
 disk_sector_t inode_get_inumber (const struct inode *);
 void inode_close (struct inode *);
 void inode_remove (struct inode *);
+void inode_set_metadata (struct inode *);
+unsigned inode_write_cnt (const struct inode *);
 off_t inode_read_at (struct inode *, void *, off_t size, off_t offset);
 off_t inode_write_at (struct inode *, const void *, off_t size, off_t offset);
+off_t inode_readv_at (struct inode *, const struct iovec *, int iovcnt,
+		off_t offset);
+off_t inode_writev_at (struct inode *, const struct iovec *, int iovcnt,
+		off_t offset);
+bool inode_extend (struct inode *, off_t length);
+void inode_read_ahead (struct inode *, off_t offset, off_t size);
 void inode_deny_write (struct inode *);
 void inode_allow_write (struct inode *);
 off_t inode_length (const struct inode *);
+size_t inode_extent_cnt (struct inode *);
+disk_sector_t inode_get_dir_index (const struct inode *);
+void inode_set_dir_index (struct inode *, disk_sector_t);
+void inode_lock_dir (struct inode *);
+void inode_unlock_dir (struct inode *);
 
 #endif /* filesys/inode.h */
@@ -0,0 +1,19 @@
+#ifndef FILESYS_JOURNAL_H
+#define FILESYS_JOURNAL_H
+#include "filesys/page_cache.h"
+
+/* Sectors of the journal region: a descriptor followed by room for
+ * the image of every sector the buffer cache can hold. */
+#define JOURNAL_SECTORS (1 + PAGE_CACHE_SIZE)
+
+void journal_init (void);
+void journal_create (void);
+void journal_recover (void);
+
+void journal_begin (size_t credits);
+void journal_end (void);
+void journal_commit (void);
+void journal_request_commit (void);
+bool journal_committing (void);
+bool journal_nested (void);
+#endif
@@ -1,12 +1,30 @@
 #ifndef FILESYS_PAGE_CACHE_H
 #define FILESYS_PAGE_CACHE_H
-#include "vm/vm.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include "devices/disk.h"
 
 struct page;
 enum vm_type;
 
 struct page_cache {};
 
+/* Number of sectors the buffer cache holds. */
+#define PAGE_CACHE_SIZE 64
+
 void page_cache_init (void);
 bool page_cache_initializer (struct page *page, enum vm_type type, void *kva);
+
+void page_cache_read (disk_sector_t, void *buffer, int sector_ofs, int size);
+void page_cache_write (disk_sector_t, const void *buffer, int sector_ofs,
+		int size);
+void page_cache_write_meta (disk_sector_t, const void *buffer,
+		int sector_ofs, int size);
+void page_cache_prefetch (disk_sector_t);
+void page_cache_flush (void);
+void page_cache_flush_data (void);
+size_t page_cache_log_meta (disk_sector_t start, disk_sector_t sectors[],
+		size_t max);
+void page_cache_checkpoint (void);
+size_t page_cache_meta_cnt (void);
 #endif
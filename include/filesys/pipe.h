@@ -0,0 +1,25 @@
+#ifndef FILESYS_PIPE_H
+#define FILESYS_PIPE_H
+
+#include <iovec.h>
+#include <stdbool.h>
+#include "filesys/off_t.h"
+
+struct file;
+struct pipe;
+
+/* Bytes a pipe buffers before writers block: one page. */
+#define PIPE_SIZE 4096
+
+bool pipe_create (struct file **read_end, struct file **write_end);
+void pipe_attach (struct pipe *, bool writer);
+void pipe_detach (struct pipe *, bool writer);
+
+off_t pipe_read (struct pipe *, void *buffer, off_t size);
+off_t pipe_write (struct pipe *, const void *buffer, off_t size);
+off_t pipe_readv (struct pipe *, const struct iovec *, int iovcnt);
+off_t pipe_writev (struct pipe *, const struct iovec *, int iovcnt);
+off_t pipe_splice_to_file (struct pipe *, struct file *, off_t size);
+off_t pipe_splice_from_file (struct pipe *, struct file *, off_t size);
+
+#endif /* filesys/pipe.h */
@@ -0,0 +1,16 @@
+#ifndef __LIB_IOVEC_H
+#define __LIB_IOVEC_H
+
+#include <stddef.h>
+
+/* One segment of a scatter/gather transfer, as taken by the
+ * readv(), writev(), preadv() and pwritev() system calls. */
+struct iovec {
+	void *iov_base;             /* Start of the segment. */
+	size_t iov_len;             /* Length of the segment in bytes. */
+};
+
+/* Maximum number of segments in one vectored call. */
+#define IOV_MAX 32
+
+#endif /* lib/iovec.h */
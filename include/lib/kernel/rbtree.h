@@ -0,0 +1,74 @@
+#ifndef __LIB_KERNEL_RBTREE_H
+#define __LIB_KERNEL_RBTREE_H
+
+/* Red-black tree.
+ *
+ * A balanced binary search tree.  Like the list and hash table
+ * implementations, the tree does not allocate memory itself:
+ * each structure that can be in a tree embeds a struct rb_elem
+ * member, and rb_entry converts a struct rb_elem back into the
+ * structure that contains it.
+ *
+ * Elements are ordered by a caller-supplied "less" function.
+ * Insertion, removal and lookup, including the floor/ceiling
+ * queries used to find the neighbours of a key, take O(log n)
+ * time.  In-order iteration uses rb_first() and rb_next(). */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Tree element. */
+struct rb_elem {
+	struct rb_elem *parent;     /* Parent, or null for the root. */
+	struct rb_elem *left;       /* Left child (smaller elements). */
+	struct rb_elem *right;      /* Right child (larger elements). */
+	bool red;                   /* Node color. */
+};
+
+/* Converts pointer to tree element RB_ELEM into a pointer to
+ * the structure that RB_ELEM is embedded inside.  Supply the
+ * name of the outer structure STRUCT and the member name MEMBER
+ * of the tree element. */
+#define rb_entry(RB_ELEM, STRUCT, MEMBER)                       \
+	((STRUCT *) ((uint8_t *) &(RB_ELEM)->parent             \
+		- offsetof (STRUCT, MEMBER.parent)))
+
+/* Compares the value of two tree elements A and B, given
+ * auxiliary data AUX.  Returns true if A is less than B, or
+ * false if A is greater than or equal to B. */
+typedef bool rb_less_func (const struct rb_elem *a,
+		const struct rb_elem *b, void *aux);
+
+/* Performs some operation on tree element E, given auxiliary
+ * data AUX. */
+typedef void rb_action_func (struct rb_elem *e, void *aux);
+
+/* Red-black tree. */
+struct rb_tree {
+	struct rb_elem *root;       /* Root element, or null if empty. */
+	size_t elem_cnt;            /* Number of elements in tree. */
+	rb_less_func *less;         /* Comparison function. */
+	void *aux;                  /* Auxiliary data for `less'. */
+};
+
+/* Basic life cycle. */
+void rb_init (struct rb_tree *, rb_less_func *, void *aux);
+void rb_clear (struct rb_tree *, rb_action_func *);
+
+/* Search, insertion, deletion. */
+struct rb_elem *rb_insert (struct rb_tree *, struct rb_elem *);
+void rb_remove (struct rb_tree *, struct rb_elem *);
+struct rb_elem *rb_find (const struct rb_tree *, const struct rb_elem *);
+struct rb_elem *rb_floor (const struct rb_tree *, const struct rb_elem *);
+struct rb_elem *rb_ceil (const struct rb_tree *, const struct rb_elem *);
+
+/* Iteration. */
+struct rb_elem *rb_first (const struct rb_tree *);
+struct rb_elem *rb_next (struct rb_elem *);
+
+/* Information. */
+size_t rb_size (const struct rb_tree *);
+bool rb_empty (const struct rb_tree *);
+
+#endif /* lib/kernel/rbtree.h */
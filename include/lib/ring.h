@@ -0,0 +1,70 @@
+#ifndef __LIB_RING_H
+#define __LIB_RING_H
+
+#include <stdint.h>
+
+/* Submission/completion ring shared between a user process and the
+ * kernel.
+ *
+ * The process fills submission queue entries (SQEs) at SQ_TAIL and
+ * registers the ring once with ring_setup().  Each ring_enter()
+ * call then makes the kernel consume every SQE from SQ_HEAD to
+ * SQ_TAIL and post one completion queue entry (CQE) for each at
+ * CQ_TAIL.  The process reaps CQEs by advancing CQ_HEAD.  All four
+ * indices only increase and are reduced modulo RING_ENTRIES when
+ * used.  The kernel stops early when the completion queue could
+ * overflow.
+ *
+ * Reads and writes of regular files at an explicit offset complete
+ * asynchronously, in submission order, after ring_enter() has
+ * returned; their buffers must stay untouched until their CQE
+ * appears.  Every other entry, RING_OP_NOP and reads and writes at
+ * the file position included, is a fence: it runs only after all entries
+ * submitted before it have completed, and its CQE is posted before
+ * ring_enter() returns.  close(), dup2() and munmap() also wait for
+ * the entries in flight. */
+
+/* Number of entries in each queue.  Must be a power of two. */
+#define RING_ENTRIES 32
+
+/* Operations. */
+enum ring_op {
+	RING_OP_NOP,                /* Fence, completes with 0. */
+	RING_OP_READ,               /* read() or pread(): FD, ADDR, LEN, OFF. */
+	RING_OP_WRITE,              /* write() or pwrite(): FD, ADDR, LEN, OFF. */
+	RING_OP_OPEN,               /* open(): ADDR is the file name. */
+	RING_OP_CLOSE,              /* close(): FD. */
+	RING_OP_MMAP,               /* mmap(): ADDR, LEN, FLAGS, FD, OFF. */
+};
+
+/* RING_OP_MMAP flag: map the region writable. */
+#define RING_F_WRITABLE 0x1
+
+/* Submission queue entry. */
+struct ring_sqe {
+	uint32_t opcode;            /* One of enum ring_op. */
+	int32_t fd;                 /* File descriptor. */
+	uint64_t addr;              /* Buffer, file name or mapping address. */
+	uint32_t len;               /* Buffer or mapping length. */
+	uint32_t flags;             /* RING_F_* flags. */
+	int64_t off;                /* File offset, or -1 for the position. */
+	uint64_t user_data;         /* Copied to the CQE untouched. */
+};
+
+/* Completion queue entry. */
+struct ring_cqe {
+	uint64_t user_data;         /* USER_DATA of the SQE. */
+	int64_t res;                /* Result of the operation. */
+};
+
+/* The ring itself, in user memory. */
+struct ring {
+	volatile uint32_t sq_head;  /* Next SQE to consume.  Kernel-owned. */
+	volatile uint32_t sq_tail;  /* Next free SQE.  User-owned. */
+	volatile uint32_t cq_head;  /* Next CQE to reap.  User-owned. */
+	volatile uint32_t cq_tail;  /* Next free CQE.  Kernel-owned. */
+	struct ring_sqe sq[RING_ENTRIES];
+	struct ring_cqe cq[RING_ENTRIES];
+};
+
+#endif /* lib/ring.h */
@@ -0,0 +1,26 @@
+#ifndef __LIB_SPAWN_H
+#define __LIB_SPAWN_H
+
+/* File descriptor actions for spawn().
+ *
+ * The child of spawn() starts with a copy of every open
+ * descriptor of its parent, as after fork().  The actions are
+ * then applied to the child's table in order, before the child
+ * runs its first instruction. */
+
+/* Maximum number of actions per spawn() call. */
+#define SPAWN_ACTIONS_MAX 16
+
+/* Operations. */
+enum spawn_op {
+	SPAWN_CLOSE,                /* Close FD in the child. */
+	SPAWN_DUP2,                 /* Make NEWFD a copy of FD in the child. */
+};
+
+struct spawn_action {
+	int op;                     /* One of enum spawn_op. */
+	int fd;                     /* Descriptor acted upon. */
+	int newfd;                  /* Target descriptor of SPAWN_DUP2. */
+};
+
+#endif /* lib/spawn.h */
@@ -36,6 +36,23 @@ enum {
 
 	SYS_MOUNT,
 	SYS_UMOUNT,
+
+	/* Vectored I/O. */
+	SYS_READV,                  /* Scatter read at the file position. */
+	SYS_WRITEV,                 /* Gather write at the file position. */
+	SYS_PREADV,                 /* Scatter read at a given offset. */
+	SYS_PWRITEV,                /* Gather write at a given offset. */
+
+	/* Batched submission. */
+	SYS_RING_SETUP,             /* Register a submission ring. */
+	SYS_RING_ENTER,             /* Consume the submitted entries. */
+
+	/* Process creation without fork(). */
+	SYS_SPAWN,                  /* Start a new process from a file. */
+
+	/* Inter-process communication. */
+	SYS_PIPE,                   /* Create a pipe. */
+	SYS_SPLICE,                 /* Move data between a pipe and a file. */
 };
 
 #endif /* lib/syscall-nr.h */
@@ -4,6 +4,9 @@
 #include <stdbool.h>
 #include <debug.h>
 #include <stddef.h>
+#include <iovec.h>
+#include <ring.h>
+#include <spawn.h>
 
 /* Process identifier. */
 typedef int pid_t;
@@ -50,6 +53,24 @@ bool isdir (int fd);
 int inumber (int fd);
 int symlink (const char* target, const char* linkpath);
 
+/* Vectored I/O. */
+int readv (int fd, const struct iovec *iov, int iovcnt);
+int writev (int fd, const struct iovec *iov, int iovcnt);
+int preadv (int fd, const struct iovec *iov, int iovcnt, off_t offset);
+int pwritev (int fd, const struct iovec *iov, int iovcnt, off_t offset);
+
+/* Batched submission. */
+int ring_setup (struct ring *ring);
+int ring_enter (void);
+
+/* Process creation without fork(). */
+pid_t spawn (const char *cmd_line, const struct spawn_action *actions,
+		int action_cnt);
+
+/* Inter-process communication. */
+int pipe (int fds[2]);
+int splice (int fd_in, int fd_out, unsigned size);
+
 static inline void* get_phys_addr (void *user_addr) {
 	void* pa;
 	asm volatile ("movq %0, %%rax" ::"r"(user_addr));
@@ -78,4 +99,158 @@ get_fs_disk_write_cnt (void) {
 	return write_cnt;
 }
 
+static inline long long
+get_kernel_malloc_cnt (void) {
+	long long malloc_cnt;
+	asm volatile ("int $0x45");
+	asm volatile ("\t movq %%rax, %0": "=r" (malloc_cnt));
+	return malloc_cnt;
+}
+
+static inline long long
+inspect_tlb (long long which) {
+	long long value;
+	asm volatile ("int $0x46" : "=a" (value) : "d" (which) : "memory");
+	return value;
+}
+
+/* Number of address space switches since boot. */
+static inline long long
+get_cr3_load_cnt (void) {
+	return inspect_tlb (0);
+}
+
+/* Number of address space switches that flushed the TLB. */
+static inline long long
+get_tlb_flush_cnt (void) {
+	return inspect_tlb (1);
+}
+
+/* Whether switches can keep the TLB through PCIDs. */
+static inline bool
+get_pcid_enabled (void) {
+	return inspect_tlb (2) != 0;
+}
+
+/* Number of system calls since boot. */
+static inline long long
+get_syscall_cnt (void) {
+	long long syscall_cnt;
+	asm volatile ("int $0x47" : "=a" (syscall_cnt) : : "memory");
+	return syscall_cnt;
+}
+
+static inline long long
+inspect_page_cache (long long which) {
+	long long value;
+	asm volatile ("int $0x49" : "=a" (value) : "d" (which) : "memory");
+	return value;
+}
+
+/* Number of buffer cache lookups that found the sector. */
+static inline long long
+get_cache_hit_cnt (void) {
+	return inspect_page_cache (0);
+}
+
+/* Number of buffer cache lookups that had to bring the sector in. */
+static inline long long
+get_cache_miss_cnt (void) {
+	return inspect_page_cache (1);
+}
+
+/* Number of dirty sectors the buffer cache wrote back. */
+static inline long long
+get_cache_writeback_cnt (void) {
+	return inspect_page_cache (2);
+}
+
+/* Number of times the buffer cache wrote all dirty data back, as
+ * the write-back daemon does periodically. */
+static inline long long
+get_cache_flush_cnt (void) {
+	return inspect_page_cache (3);
+}
+
+/* Number of misses that read-ahead took, bringing sectors in before
+ * a reader asked for them. */
+static inline long long
+get_cache_prefetch_cnt (void) {
+	return inspect_page_cache (4);
+}
+
+static inline long long
+inspect_dcache (long long which) {
+	long long value;
+	asm volatile ("int $0x4a" : "=a" (value) : "d" (which) : "memory");
+	return value;
+}
+
+/* Number of name lookups answered by the directory lookup cache. */
+static inline long long
+get_dcache_hit_cnt (void) {
+	return inspect_dcache (0);
+}
+
+/* Number of name lookups that had to search the directory. */
+static inline long long
+get_dcache_miss_cnt (void) {
+	return inspect_dcache (1);
+}
+
+static inline long long
+inspect_journal (long long which) {
+	long long value;
+	asm volatile ("int $0x4b" : "=a" (value) : "d" (which) : "memory");
+	return value;
+}
+
+/* Commits the file system journal.  Returns the number of the last
+ * transaction. */
+static inline long long
+journal_commit_now (void) {
+	return inspect_journal (0);
+}
+
+/* Commits the file system journal and then simulates a crash before
+ * any metadata is written in place: later writes to the file system
+ * disk are dropped. */
+static inline long long
+crash_after_commit (void) {
+	return inspect_journal (1);
+}
+
+/* Simulates a crash at once: later writes to the file system disk
+ * are dropped. */
+static inline void
+crash_now (void) {
+	inspect_journal (2);
+}
+
+/* Number of kernel and user pool pages in use. */
+static inline long long
+get_used_page_cnt (void) {
+	long long page_cnt;
+	asm volatile ("int $0x48" : "=a" (page_cnt) : : "memory");
+	return page_cnt;
+}
+
+/* Number of times the kernel parsed executable headers. */
+static inline long long
+get_exec_parse_cnt (void) {
+	long long parse_cnt;
+	asm volatile ("int $0x4c" : "=a" (parse_cnt) : : "memory");
+	return parse_cnt;
+}
+
+/* Number of runs of consecutive disk sectors that the data of the
+ * file open as FD occupies. */
+static inline long long
+get_extent_cnt (int fd) {
+	long long extent_cnt;
+	asm volatile ("int $0x4d" : "=a" (extent_cnt) : "d" ((long long) fd)
+			: "memory");
+	return extent_cnt;
+}
+
 #endif /* lib/user/syscall.h */
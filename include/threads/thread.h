@@ -9,6 +9,9 @@
 #ifdef VM
 #include "vm/vm.h"
 #endif
+#ifdef USERPROG
+#include "userprog/fdtable.h"
+#endif
 
 
 /* States in a thread's life cycle. */
@@ -30,10 +33,21 @@ typedef int tid_t;
 #define PRI_DEFAULT 31                  /* Default priority. */
 #define PRI_MAX 63                      /* Highest priority. */
 #define F (1<<14)                       /* 17.14 소수점 표현의 1*/
-#define FDT_PAGES 1
-#define FDT_CNT_LIMIT (1<<8)
 
 
+/* Exit status of a process, shared between the process and its
+ * parent so that either may go away first.  The process frees its
+ * thread and address space as soon as it exits; this record stays
+ * until the parent has waited for it or exited too. */
+struct exit_info {
+	tid_t tid;                  /* Thread identifier of the process. */
+	int status;                 /* Exit status, valid once EXITED is up. */
+	int ref_cnt;                /* Parent and process each hold one. */
+	struct semaphore loaded;    /* Upped when fork or spawn has set up. */
+	struct semaphore exited;    /* Upped when the process has exited. */
+	struct list_elem elem;      /* Element in parent's child_list. */
+};
+
 /* A kernel thread or user process.
  *
  * Each thread structure is stored in its own 4 kB page.  The
@@ -110,29 +124,22 @@ struct thread {
 	int recent_cpu;
 	int nice;
 
-	/* file descripter 멤버 */
-	struct file **fdt;
-	
-	int next_fd;
-
 	struct intr_frame parent_if;
 	int exit_status;
-	struct list child_list;
-	struct list_elem child_elem;
-
-	struct semaphore dupl_sema;
-	struct semaphore child_wait_sema;
-	struct semaphore exit_sema;
+	struct list child_list;             /* Exit info of children. */
+	struct exit_info *exit_info;        /* Shared with the parent. */
 
 	struct file *loading_file;
+#ifdef FILESYS
+	int journal_depth;                  /* Nesting of journal_begin(). */
+	size_t journal_credits;             /* Credits of the running operation. */
+#endif
 
 #ifdef USERPROG
 	/* Owned by userprog/process.c. */
 	uint64_t *pml4;                     /* Page map level 4 */
-#endif
-#ifndef VM
-	struct file **fdt_dup;
-	int next_dup;
+	struct ring_worker *ring;           /* Registered ring, see syscall.c. */
+	struct fd_table fdt;                /* Open file descriptors. */
 #endif
 #ifdef VM
 	/* Table for whole virtual memory owned by thread. */
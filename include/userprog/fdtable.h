@@ -0,0 +1,34 @@
+#ifndef USERPROG_FDTABLE_H
+#define USERPROG_FDTABLE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+struct file;
+
+/* Maximum number of file descriptors per process. */
+#define FDT_CNT_LIMIT (1<<8)
+
+/* A process's file descriptor table.
+ *
+ * Descriptors 0 and 1 are the console and never hold a file.  The
+ * slot array grows by doubling, and a bitmap of taken slots finds
+ * the lowest free descriptor one 64-bit word at a time and lets
+ * fork and exit visit only the open descriptors.  Descriptors made
+ * by dup2() share one open file, which counts its references. */
+struct fd_table {
+	struct file **files;        /* CAP slots, NULL until first use. */
+	uint64_t *used;             /* Bitmap of taken slots. */
+	int cap;                    /* Number of slots, a multiple of 64. */
+};
+
+void fd_table_init (struct fd_table *);
+bool fd_table_copy (struct fd_table *dst, const struct fd_table *src);
+void fd_table_destroy (struct fd_table *);
+
+int fd_install (struct fd_table *, struct file *);
+struct file *fd_lookup (const struct fd_table *, int fd);
+bool fd_close (struct fd_table *, int fd);
+int fd_dup2 (struct fd_table *, int oldfd, int newfd);
+
+#endif /* userprog/fdtable.h */
@@ -2,14 +2,22 @@
 #define USERPROG_PROCESS_H
 
 #include "threads/thread.h"
+#include <spawn.h>
+
+struct inode;
 
 tid_t process_create_initd (const char *file_name);
 tid_t process_fork (const char *name, struct intr_frame *if_);
 int process_exec (void *f_name);
+tid_t process_spawn (char *cmd_line, const struct spawn_action *actions,
+		int action_cnt);
 int process_wait (tid_t);
 void process_exit (void);
 void process_activate (struct thread *next);
 int process_add_fd(struct file *f);
+void exec_cache_init (void);
+void exec_cache_forget (struct inode *);
+void exec_cache_flush (void);
 
 #ifdef VM
 struct load_info {
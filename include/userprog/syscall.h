@@ -4,6 +4,7 @@
 
 void syscall_init (void);
 void check_addr(void *addr);
-struct lock filesys_lock; //파일 접근 동기화 lock
+void register_syscall_inspect_intr (void);
+void ring_release (void);
 #endif /* userprog/syscall.h */
 
@@ -0,0 +1,12 @@
+#ifndef USERPROG_UACCESS_H
+#define USERPROG_UACCESS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+bool pin_user_pages (const void *uaddr, size_t size, bool write);
+void unpin_user_pages (const void *uaddr, size_t size);
+bool copy_from_user (void *dst, const void *usrc, size_t size);
+bool copy_to_user (void *udst, const void *src, size_t size);
+
+#endif /* userprog/uaccess.h */
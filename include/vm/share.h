@@ -0,0 +1,37 @@
+#ifndef VM_SHARE_H
+#define VM_SHARE_H
+#include <stdbool.h>
+#include <stddef.h>
+#include "filesys/off_t.h"
+#include "lib/kernel/hash.h"
+
+struct page;
+struct inode;
+
+/* A frame of the text cache: READ_BYTES bytes of INODE at OFS
+ * followed by zeros, mapped read-only into every process that
+ * runs the file. */
+struct share_entry {
+	struct inode *inode;        /* Backing inode, reopened. */
+	off_t ofs;
+	size_t read_bytes;
+	void *kva;                  /* The shared frame. */
+	int map_cnt;                /* Pages mapping KVA. */
+	struct hash_elem elem;      /* Element in the text cache. */
+};
+
+/* A page mapped from the text cache. */
+struct share_page {
+	struct share_entry *entry;
+};
+
+void vm_share_init (void);
+struct share_entry *share_get (struct inode *inode, off_t ofs,
+		size_t read_bytes);
+struct share_entry *share_add (struct inode *inode, off_t ofs,
+		size_t read_bytes, void *kva);
+void share_ref (struct share_entry *entry);
+void share_put (struct share_entry *entry);
+void share_initializer (struct page *page, struct share_entry *entry);
+bool page_is_shared (const struct page *page);
+#endif
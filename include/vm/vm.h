@@ -33,6 +33,8 @@ enum vm_type {
 	VM_SWAP = (1 << 5),
 	/* this marker indicates the page which is located in file disk */
 	VM_DISK = (1 << 6),
+	/* this marker indicates executable pages shared through the text cache */
+	VM_SHARED = (1 << 7),
 
 
 	/* DO NOT EXCEED THIS VALUE. */
@@ -42,6 +44,8 @@ enum vm_type {
 #include "vm/uninit.h"
 #include "vm/anon.h"
 #include "vm/file.h"
+#include "vm/vma.h"
+#include "vm/share.h"
 #include "lib/kernel/hash.h"
 #ifdef EFILESYS
 #include "filesys/page_cache.h"
@@ -63,8 +67,8 @@ struct page {
 	
 	/* Your implementation */
 	struct thread *thread; /* Onwer of this page */
-	struct hash_elem spt_elem;
 	bool writable;
+	int pin_cnt;           /* >0: frame may not be evicted, see vm_pin_page(). */
 	struct list_elem frame_elem;
 	/* Per-type data are binded into the union.
 	 * Each function automatically detects the current union */
@@ -72,6 +76,7 @@ struct page {
 		struct uninit_page uninit;
 		struct anon_page anon;
 		struct file_page file;
+		struct share_page share;
 #ifdef EFILESYS
 		struct page_cache page_cache;
 #endif
@@ -104,7 +109,8 @@ struct page_operations {
  * We don't want to force you to obey any specific design for this struct.
  * All designs up to you for this. */
 struct supplemental_page_table {
-	struct hash pages;
+	void **root;           /* Root of the page radix tree, see vm.c. */
+	struct rb_tree vmas;   /* Mappings whose pages are created on demand. */
 };
 
 #include "threads/thread.h"
@@ -119,7 +125,6 @@ void supplemental_page_table_init (struct supplemental_page_table *spt);
 bool supplemental_page_table_copy (struct supplemental_page_table *dst,
 		struct supplemental_page_table *src);
 void supplemental_page_table_kill (struct supplemental_page_table *spt);
-void hash_action_free (struct hash_elem *e,void *aux);
 struct page *spt_find_page (struct supplemental_page_table *spt,
 		void *va);
 bool spt_insert_page (struct supplemental_page_table *spt, struct page *page);
@@ -135,6 +140,11 @@ bool vm_alloc_page_with_initializer (enum vm_type type, void *upage,
 		bool writable, vm_initializer *init, void *aux);
 void vm_dealloc_page (struct page *page);
 bool vm_claim_page (void *va);
+bool vm_claim_huge_page (void *upage, bool writable);
+bool vm_claim_shared_page (void *upage, struct file *file, off_t ofs,
+		size_t read_bytes, bool writable);
+bool vm_pin_page (void *va, bool write);
+void vm_unpin_page (void *va);
 enum vm_type page_get_type (struct page *page);
 
 #endif  /* VM_VM_H */
@@ -0,0 +1,44 @@
+#ifndef VM_VMA_H
+#define VM_VMA_H
+#include <stdbool.h>
+#include <stddef.h>
+#include "filesys/off_t.h"
+#include "lib/kernel/rbtree.h"
+#include "vm/vm.h"
+
+struct file;
+struct supplemental_page_table;
+
+/* A virtual memory area: a page-aligned range [START, END) of
+ * user memory with one backing object and one set of permissions.
+ * VMAs of a process never overlap and are kept in a red-black tree
+ * ordered by START, so finding the VMA for an address or checking a
+ * new range for overlap takes O(log n).
+ *
+ * No `struct page' exists for a VMA page until it is first touched;
+ * vm_try_handle_fault() creates it from the VMA on demand. */
+struct vma {
+	void *start;                /* First page of the area. */
+	void *end;                  /* One past the last page of the area. */
+	enum vm_type type;          /* VM_ANON or VM_FILE, maybe VM_SHARED. */
+	struct file *file;          /* Backing file, owned by the VMA. */
+	off_t offset;               /* File offset of START. */
+	size_t read_bytes;          /* Bytes from START read from FILE, rest
+	                               of the area is zero-filled. */
+	bool writable;
+	struct rb_elem elem;        /* Element in supplemental_page_table. */
+};
+
+void vma_init (struct supplemental_page_table *spt);
+struct vma *vma_create (struct supplemental_page_table *spt, void *start,
+		size_t length, enum vm_type type, struct file *file, off_t offset,
+		size_t read_bytes, bool writable);
+struct vma *vma_find (struct supplemental_page_table *spt, const void *va);
+bool vma_overlaps (struct supplemental_page_table *spt, const void *start,
+		const void *end);
+void vma_destroy (struct supplemental_page_table *spt, struct vma *vma);
+bool vma_copy (struct supplemental_page_table *dst,
+		struct supplemental_page_table *src);
+void vma_kill (struct supplemental_page_table *spt);
+bool vma_claim_page (struct vma *vma, void *upage, bool write);
+#endif
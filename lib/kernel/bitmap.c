@@ -263,6 +263,27 @@ bitmap_all (const struct bitmap *b, size_t start, size_t cnt) {
 
 /* Finding set or unset bits. */
 
+/* Returns the index of the first bit in B at or after START that
+   is set to VALUE, or the number of bits in B if there is none.
+   Examines a whole element at a time. */
+static size_t
+next_bit (const struct bitmap *b, size_t start, bool value) {
+	size_t i = start;
+
+	while (i < b->bit_cnt) {
+		elem_type word = b->bits[elem_idx (i)];
+		if (!value)
+			word = ~word;
+		word &= ~(elem_type) 0 << (i % ELEM_BITS);
+		if (word != 0) {
+			i = elem_idx (i) * ELEM_BITS + __builtin_ctzl (word);
+			return i < b->bit_cnt ? i : b->bit_cnt;
+		}
+		i = (elem_idx (i) + 1) * ELEM_BITS;
+	}
+	return b->bit_cnt;
+}
+
 /* Finds and returns the starting index of the first group of CNT
    consecutive bits in B at or after START that are all set to
    VALUE.
@@ -272,12 +293,23 @@ bitmap_scan (const struct bitmap *b, size_t start, size_t cnt, bool value) {
 	ASSERT (b != NULL);
 	ASSERT (start <= b->bit_cnt);
 
+	if (cnt == 0)
+		return start;
 	if (cnt <= b->bit_cnt) {
 		size_t last = b->bit_cnt - cnt;
-		size_t i;
-		for (i = start; i <= last; i++)
-			if (!bitmap_contains (b, i, cnt, !value))
-				return i;
+		size_t i = start;
+
+		/* Jump from run to run of VALUE bits instead of testing
+		   every starting position. */
+		while (i <= last) {
+			size_t run_start = next_bit (b, i, value);
+			if (run_start > last)
+				break;
+			size_t run_end = next_bit (b, run_start, !value);
+			if (run_end - run_start >= cnt)
+				return run_start;
+			i = run_end;
+		}
 	}
 	return BITMAP_ERROR;
 }
@@ -326,6 +358,23 @@ bitmap_write (const struct bitmap *b, struct file *file) {
 	off_t size = byte_cnt (b->bit_cnt);
 	return file_write_at (file, b->bits, size, 0) == size;
 }
+
+/* Writes bytes OFS through OFS + SIZE (exclusive) of B's file
+   image to the same place in FILE, so that a few changed bits do
+   not require writing all of B.  Return true if successful, false
+   otherwise. */
+bool
+bitmap_write_part (const struct bitmap *b, struct file *file, size_t ofs,
+		size_t size) {
+	size_t file_size = byte_cnt (b->bit_cnt);
+
+	if (ofs >= file_size)
+		return true;
+	if (size > file_size - ofs)
+		size = file_size - ofs;
+	return file_write_at (file, (const uint8_t *) b->bits + ofs, size, ofs)
+		== (off_t) size;
+}
 #endif /* FILESYS */
 
 /* Debugging. */
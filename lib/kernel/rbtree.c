@@ -0,0 +1,388 @@
+/* Red-black tree.
+
+   See rbtree.h for basic information.  The balancing rules
+   follow the usual textbook formulation:
+
+     1. Every node is red or black.
+     2. The root is black.
+     3. A red node never has a red child.
+     4. Every path from a node down to a null leaf passes through
+        the same number of black nodes.
+
+   Null children count as black leaves. */
+
+#include "rbtree.h"
+#include "../debug.h"
+
+static void rotate_left (struct rb_tree *, struct rb_elem *);
+static void rotate_right (struct rb_tree *, struct rb_elem *);
+static void insert_fixup (struct rb_tree *, struct rb_elem *);
+static void remove_fixup (struct rb_tree *, struct rb_elem *,
+		struct rb_elem *parent);
+static void transplant (struct rb_tree *, struct rb_elem *,
+		struct rb_elem *);
+static struct rb_elem *leftmost (struct rb_elem *);
+
+static inline bool
+is_red (const struct rb_elem *e) {
+	return e != NULL && e->red;
+}
+
+/* Initializes tree T to compare elements using LESS, given
+   auxiliary data AUX. */
+void
+rb_init (struct rb_tree *t, rb_less_func *less, void *aux) {
+	ASSERT (t != NULL);
+	ASSERT (less != NULL);
+
+	t->root = NULL;
+	t->elem_cnt = 0;
+	t->less = less;
+	t->aux = aux;
+}
+
+/* Removes all the elements from T.
+
+   If DESTRUCTOR is non-null, then it is called for each element
+   in the tree, in no particular order.  DESTRUCTOR may
+   deallocate the memory used by the element, but must not
+   modify T itself. */
+void
+rb_clear (struct rb_tree *t, rb_action_func *destructor) {
+	struct rb_elem *e = t->root;
+
+	/* Walk the tree bottom-up without recursion: descend to a
+	   leaf, detach it from its parent, destroy it, and resume
+	   from the parent. */
+	while (e != NULL) {
+		if (e->left != NULL)
+			e = e->left;
+		else if (e->right != NULL)
+			e = e->right;
+		else {
+			struct rb_elem *parent = e->parent;
+			if (parent != NULL) {
+				if (parent->left == e)
+					parent->left = NULL;
+				else
+					parent->right = NULL;
+			}
+			if (destructor != NULL)
+				destructor (e, t->aux);
+			e = parent;
+		}
+	}
+
+	t->root = NULL;
+	t->elem_cnt = 0;
+}
+
+/* Inserts NEW into tree T and returns a null pointer, if no
+   equal element is already in the tree.
+   If an equal element is already in the tree, returns it
+   without inserting NEW. */
+struct rb_elem *
+rb_insert (struct rb_tree *t, struct rb_elem *new) {
+	struct rb_elem *parent = NULL;
+	struct rb_elem **link = &t->root;
+
+	while (*link != NULL) {
+		parent = *link;
+		if (t->less (new, parent, t->aux))
+			link = &parent->left;
+		else if (t->less (parent, new, t->aux))
+			link = &parent->right;
+		else
+			return parent;
+	}
+
+	new->parent = parent;
+	new->left = new->right = NULL;
+	new->red = true;
+	*link = new;
+	t->elem_cnt++;
+
+	insert_fixup (t, new);
+	return NULL;
+}
+
+/* Removes E, which must be an element of T, from the tree. */
+void
+rb_remove (struct rb_tree *t, struct rb_elem *e) {
+	struct rb_elem *child, *parent;
+	bool removed_red;
+
+	ASSERT (t->elem_cnt > 0);
+
+	if (e->left == NULL || e->right == NULL) {
+		/* E has at most one child, which takes its place. */
+		child = e->left != NULL ? e->left : e->right;
+		parent = e->parent;
+		removed_red = e->red;
+		transplant (t, e, child);
+	} else {
+		/* E has two children.  Its in-order successor S has no
+		   left child; S moves into E's position and takes E's
+		   color, so the black height only changes where S used
+		   to be. */
+		struct rb_elem *s = leftmost (e->right);
+		removed_red = s->red;
+		child = s->right;
+		if (s->parent == e)
+			parent = s;
+		else {
+			parent = s->parent;
+			transplant (t, s, s->right);
+			s->right = e->right;
+			s->right->parent = s;
+		}
+		transplant (t, e, s);
+		s->left = e->left;
+		s->left->parent = s;
+		s->red = e->red;
+	}
+
+	t->elem_cnt--;
+	if (!removed_red)
+		remove_fixup (t, child, parent);
+}
+
+/* Finds and returns an element equal to KEY in tree T, or a
+   null pointer if no equal element exists in the tree. */
+struct rb_elem *
+rb_find (const struct rb_tree *t, const struct rb_elem *key) {
+	struct rb_elem *e = t->root;
+
+	while (e != NULL) {
+		if (t->less (key, e, t->aux))
+			e = e->left;
+		else if (t->less (e, key, t->aux))
+			e = e->right;
+		else
+			return e;
+	}
+	return NULL;
+}
+
+/* Returns the greatest element in T that is less than or equal
+   to KEY, or a null pointer if every element is greater. */
+struct rb_elem *
+rb_floor (const struct rb_tree *t, const struct rb_elem *key) {
+	struct rb_elem *e = t->root;
+	struct rb_elem *best = NULL;
+
+	while (e != NULL) {
+		if (t->less (key, e, t->aux))
+			e = e->left;
+		else {
+			best = e;
+			e = e->right;
+		}
+	}
+	return best;
+}
+
+/* Returns the least element in T that is greater than or equal
+   to KEY, or a null pointer if every element is less. */
+struct rb_elem *
+rb_ceil (const struct rb_tree *t, const struct rb_elem *key) {
+	struct rb_elem *e = t->root;
+	struct rb_elem *best = NULL;
+
+	while (e != NULL) {
+		if (t->less (e, key, t->aux))
+			e = e->right;
+		else {
+			best = e;
+			e = e->left;
+		}
+	}
+	return best;
+}
+
+/* Returns the least element in T, or a null pointer if T is
+   empty. */
+struct rb_elem *
+rb_first (const struct rb_tree *t) {
+	return t->root != NULL ? leftmost (t->root) : NULL;
+}
+
+/* Returns the element that follows E in order, or a null
+   pointer if E is the greatest element of its tree. */
+struct rb_elem *
+rb_next (struct rb_elem *e) {
+	if (e->right != NULL)
+		return leftmost (e->right);
+
+	while (e->parent != NULL && e->parent->right == e)
+		e = e->parent;
+	return e->parent;
+}
+
+/* Returns the number of elements in T. */
+size_t
+rb_size (const struct rb_tree *t) {
+	return t->elem_cnt;
+}
+
+/* Returns true if T contains no elements, false otherwise. */
+bool
+rb_empty (const struct rb_tree *t) {
+	return t->elem_cnt == 0;
+}
+
+/* Returns the least element of the subtree rooted at E. */
+static struct rb_elem *
+leftmost (struct rb_elem *e) {
+	while (e->left != NULL)
+		e = e->left;
+	return e;
+}
+
+/* Replaces the subtree rooted at OLD by the one rooted at NEW,
+   which may be null. */
+static void
+transplant (struct rb_tree *t, struct rb_elem *old, struct rb_elem *new) {
+	if (old->parent == NULL)
+		t->root = new;
+	else if (old->parent->left == old)
+		old->parent->left = new;
+	else
+		old->parent->right = new;
+	if (new != NULL)
+		new->parent = old->parent;
+}
+
+/* Rotates the subtree rooted at E to the left. */
+static void
+rotate_left (struct rb_tree *t, struct rb_elem *e) {
+	struct rb_elem *r = e->right;
+
+	e->right = r->left;
+	if (r->left != NULL)
+		r->left->parent = e;
+	transplant (t, e, r);
+	r->left = e;
+	e->parent = r;
+}
+
+/* Rotates the subtree rooted at E to the right. */
+static void
+rotate_right (struct rb_tree *t, struct rb_elem *e) {
+	struct rb_elem *l = e->left;
+
+	e->left = l->right;
+	if (l->right != NULL)
+		l->right->parent = e;
+	transplant (t, e, l);
+	l->right = e;
+	e->parent = l;
+}
+
+/* Restores the red-black properties after E, a red node, was
+   linked into T. */
+static void
+insert_fixup (struct rb_tree *t, struct rb_elem *e) {
+	while (is_red (e->parent)) {
+		struct rb_elem *parent = e->parent;
+		struct rb_elem *grand = parent->parent;
+
+		if (parent == grand->left) {
+			struct rb_elem *uncle = grand->right;
+			if (is_red (uncle)) {
+				parent->red = uncle->red = false;
+				grand->red = true;
+				e = grand;
+			} else {
+				if (e == parent->right) {
+					rotate_left (t, parent);
+					e = parent;
+					parent = e->parent;
+				}
+				parent->red = false;
+				grand->red = true;
+				rotate_right (t, grand);
+			}
+		} else {
+			struct rb_elem *uncle = grand->left;
+			if (is_red (uncle)) {
+				parent->red = uncle->red = false;
+				grand->red = true;
+				e = grand;
+			} else {
+				if (e == parent->left) {
+					rotate_right (t, parent);
+					e = parent;
+					parent = e->parent;
+				}
+				parent->red = false;
+				grand->red = true;
+				rotate_left (t, grand);
+			}
+		}
+	}
+	t->root->red = false;
+}
+
+/* Restores the red-black properties after a black node was
+   unlinked from T.  E, which may be null, is the node that took
+   its place and PARENT is E's parent; E carries an extra
+   "black" that must be pushed up or absorbed. */
+static void
+remove_fixup (struct rb_tree *t, struct rb_elem *e, struct rb_elem *parent) {
+	while (e != t->root && !is_red (e)) {
+		if (e == parent->left) {
+			struct rb_elem *sib = parent->right;
+			if (is_red (sib)) {
+				sib->red = false;
+				parent->red = true;
+				rotate_left (t, parent);
+				sib = parent->right;
+			}
+			if (!is_red (sib->left) && !is_red (sib->right)) {
+				sib->red = true;
+				e = parent;
+				parent = e->parent;
+			} else {
+				if (!is_red (sib->right)) {
+					sib->left->red = false;
+					sib->red = true;
+					rotate_right (t, sib);
+					sib = parent->right;
+				}
+				sib->red = parent->red;
+				parent->red = false;
+				sib->right->red = false;
+				rotate_left (t, parent);
+				e = t->root;
+			}
+		} else {
+			struct rb_elem *sib = parent->left;
+			if (is_red (sib)) {
+				sib->red = false;
+				parent->red = true;
+				rotate_right (t, parent);
+				sib = parent->left;
+			}
+			if (!is_red (sib->left) && !is_red (sib->right)) {
+				sib->red = true;
+				e = parent;
+				parent = e->parent;
+			} else {
+				if (!is_red (sib->left)) {
+					sib->right->red = false;
+					sib->red = true;
+					rotate_left (t, sib);
+					sib = parent->left;
+				}
+				sib->red = parent->red;
+				parent->red = false;
+				sib->left->red = false;
+				rotate_right (t, parent);
+				e = t->root;
+			}
+		}
+	}
+	if (e != NULL)
+		e->red = false;
+}
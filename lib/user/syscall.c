@@ -54,7 +54,7 @@ static __inline int64_t syscall (uint64_t num_, uint64_t a1_, uint64_t a2_,
 			((uint64_t) ARG2), 0, 0, 0))
 
 #define syscall4(NUMBER, ARG0, ARG1, ARG2, ARG3) ( \
-		syscall(((uint64_t *) NUMBER), \
+		syscall(((uint64_t) NUMBER), \
 			((uint64_t) ARG0), \
 			((uint64_t) ARG1), \
 			((uint64_t) ARG2), \
@@ -194,3 +194,49 @@ int
 umount (const char *path) {
 	return syscall1 (SYS_UMOUNT, path);
 }
+
+int
+readv (int fd, const struct iovec *iov, int iovcnt) {
+	return syscall3 (SYS_READV, fd, iov, iovcnt);
+}
+
+int
+writev (int fd, const struct iovec *iov, int iovcnt) {
+	return syscall3 (SYS_WRITEV, fd, iov, iovcnt);
+}
+
+int
+preadv (int fd, const struct iovec *iov, int iovcnt, off_t offset) {
+	return syscall4 (SYS_PREADV, fd, iov, iovcnt, offset);
+}
+
+int
+pwritev (int fd, const struct iovec *iov, int iovcnt, off_t offset) {
+	return syscall4 (SYS_PWRITEV, fd, iov, iovcnt, offset);
+}
+
+int
+ring_setup (struct ring *ring) {
+	return syscall1 (SYS_RING_SETUP, ring);
+}
+
+int
+ring_enter (void) {
+	return syscall0 (SYS_RING_ENTER);
+}
+
+pid_t
+spawn (const char *cmd_line, const struct spawn_action *actions,
+		int action_cnt) {
+	return (pid_t) syscall3 (SYS_SPAWN, cmd_line, actions, action_cnt);
+}
+
+int
+pipe (int fds[2]) {
+	return syscall1 (SYS_PIPE, fds);
+}
+
+int
+splice (int fd_in, int fd_out, unsigned size) {
+	return syscall3 (SYS_SPLICE, fd_in, fd_out, size);
+}
@@ -0,0 +1,59 @@
+/* Child process for syn-par-rw test.
+   Writes its own file a chunk at a time, then reads it back
+   interleaved with reads of the shared file.  Chunks are not
+   sector-aligned, so every write goes through the partial-sector
+   path while the other children do the same in their files. */
+
+#include <random.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/filesys/base/syn-par-rw.h"
+
+const char *test_name = "child-par-rw";
+
+static char data[FILE_SIZE];
+static char shared[FILE_SIZE];
+static char chunk[CHUNK_SIZE];
+
+int
+main (int argc, const char *argv[]) 
+{
+  char name[16];
+  int child_idx;
+  int fd, shared_fd;
+  size_t ofs;
+
+  quiet = true;
+
+  CHECK (argc == 2, "argc must be 2, actually %d", argc);
+  child_idx = atoi (argv[1]);
+  snprintf (name, sizeof name, "rw-%d", child_idx);
+
+  random_init (child_idx);
+  random_bytes (data, sizeof data);
+  random_init (CHILD_CNT);
+  random_bytes (shared, sizeof shared);
+
+  CHECK ((fd = open (name)) > 1, "open \"%s\"", name);
+  for (ofs = 0; ofs < sizeof data; ofs += CHUNK_SIZE)
+    CHECK (write (fd, data + ofs, CHUNK_SIZE) == CHUNK_SIZE,
+           "write \"%s\"", name);
+
+  CHECK ((shared_fd = open (shared_name)) > 1, "open \"%s\"", shared_name);
+  seek (fd, 0);
+  for (ofs = 0; ofs < sizeof data; ofs += CHUNK_SIZE)
+    {
+      CHECK (read (fd, chunk, CHUNK_SIZE) == CHUNK_SIZE,
+             "read \"%s\"", name);
+      compare_bytes (chunk, data + ofs, CHUNK_SIZE, ofs, name);
+      CHECK (read (shared_fd, chunk, CHUNK_SIZE) == CHUNK_SIZE,
+             "read \"%s\"", shared_name);
+      compare_bytes (chunk, shared + ofs, CHUNK_SIZE, ofs, shared_name);
+    }
+  close (shared_fd);
+  close (fd);
+
+  return child_idx;
+}
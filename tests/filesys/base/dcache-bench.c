@@ -0,0 +1,63 @@
+/* Opens the same set of names many times, some of which do not
+   exist, and checks that after the first round every lookup is
+   answered by the directory lookup cache.  Then checks that
+   removing and creating names is seen by later opens. */
+
+#include <stdio.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define FILE_CNT 16
+#define ROUND_CNT 50
+
+static void
+name_of (int i, char name[16])
+{
+  snprintf (name, 16, "file%d", i);
+}
+
+void
+test_main (void) 
+{
+  long long hits, misses;
+  char name[16];
+  int round, fd, i;
+
+  for (i = 0; i < FILE_CNT; i++)
+    {
+      name_of (i, name);
+      if (!create (name, 0))
+        fail ("create \"%s\" failed", name);
+    }
+  msg ("created %d files", FILE_CNT);
+
+  hits = get_dcache_hit_cnt ();
+  misses = get_dcache_miss_cnt ();
+  for (round = 0; round < ROUND_CNT; round++)
+    {
+      for (i = 0; i < FILE_CNT; i++)
+        {
+          name_of (i, name);
+          if ((fd = open (name)) < 2)
+            fail ("open \"%s\" failed", name);
+          close (fd);
+        }
+      if (open ("missing") != -1)
+        fail ("open \"missing\" succeeded");
+    }
+  hits = get_dcache_hit_cnt () - hits;
+  misses = get_dcache_miss_cnt () - misses;
+  msg ("opened %d names %d times", FILE_CNT + 1, ROUND_CNT);
+  if (misses > FILE_CNT + 1)
+    fail ("%lld lookups missed the cache", misses);
+  if (hits < (long long) (ROUND_CNT - 1) * (FILE_CNT + 1))
+    fail ("only %lld lookups hit the cache", hits);
+  msg ("lookups after the first round hit the cache");
+
+  CHECK (remove ("file0"), "remove \"file0\"");
+  CHECK (open ("file0") == -1, "open \"file0\" fails");
+  CHECK (create ("missing", 0), "create \"missing\"");
+  CHECK ((fd = open ("missing")) > 1, "open \"missing\"");
+  close (fd);
+}
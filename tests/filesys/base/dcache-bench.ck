@@ -0,0 +1,16 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(dcache-bench) begin
+(dcache-bench) created 16 files
+(dcache-bench) opened 17 names 50 times
+(dcache-bench) lookups after the first round hit the cache
+(dcache-bench) remove "file0"
+(dcache-bench) open "file0" fails
+(dcache-bench) create "missing"
+(dcache-bench) open "missing"
+(dcache-bench) end
+EOF
+pass;
@@ -0,0 +1,82 @@
+/* Creates enough files in the root directory for it to get a hash
+   index, removes and re-creates some of them, and checks that
+   every name still resolves correctly.  Also checks that creating a
+   name that already exists, which looks it up in the directory
+   itself rather than in the lookup cache, does not read every
+   directory entry, by counting buffer cache accesses. */
+
+#include <stdio.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define FILE_CNT 200
+
+/* Buffer cache accesses allowed for one failed create. */
+#define CREATE_ACCESSES 50
+
+static void
+name_of (int i, char name[16])
+{
+  snprintf (name, 16, "f%d", i);
+}
+
+void
+test_main (void) 
+{
+  char name[16];
+  long long accesses;
+  int fd, i;
+  bool created;
+
+  for (i = 0; i < FILE_CNT; i++)
+    {
+      name_of (i, name);
+      if (!create (name, 0))
+        fail ("create \"%s\" failed", name);
+    }
+  msg ("created %d files", FILE_CNT);
+
+  for (i = 0; i < FILE_CNT; i += 2)
+    {
+      name_of (i, name);
+      if (!remove (name))
+        fail ("remove \"%s\" failed", name);
+    }
+  msg ("removed every other file");
+
+  for (i = 0; i < FILE_CNT; i++)
+    {
+      name_of (i, name);
+      fd = open (name);
+      if ((fd > 1) != (i % 2 == 1))
+        fail ("open \"%s\" returned %d", name, fd);
+      if (fd > 1)
+        close (fd);
+    }
+  msg ("remaining files resolve");
+
+  for (i = 0; i < FILE_CNT; i += 2)
+    {
+      name_of (i, name);
+      if (!create (name, 0))
+        fail ("re-create \"%s\" failed", name);
+    }
+  for (i = 0; i < FILE_CNT; i++)
+    {
+      name_of (i, name);
+      if (create (name, 0))
+        fail ("create of existing \"%s\" succeeded", name);
+    }
+  msg ("re-created removed files");
+
+  name_of (FILE_CNT - 1, name);
+  accesses = get_cache_hit_cnt () + get_cache_miss_cnt ();
+  created = create (name, 0);
+  accesses = get_cache_hit_cnt () + get_cache_miss_cnt () - accesses;
+  CHECK (!created, "create existing \"%s\"", name);
+  if (accesses > CREATE_ACCESSES)
+    fail ("create took %lld cache accesses, expected at most %d",
+          accesses, CREATE_ACCESSES);
+  msg ("create did not scan the directory");
+}
@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(dir-index) begin
+(dir-index) created 200 files
+(dir-index) removed every other file
+(dir-index) remaining files resolve
+(dir-index) re-created removed files
+(dir-index) create existing "f199"
+(dir-index) create did not scan the directory
+(dir-index) end
+EOF
+pass;
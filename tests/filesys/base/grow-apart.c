@@ -0,0 +1,58 @@
+/* Grows two empty files at the same time, one sector at a time and
+   taking turns, and checks that the data of each still lies in a
+   few runs of consecutive sectors instead of alternating with the
+   other's.  Reads both files back at the end. */
+
+#include <random.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define SECTOR_CNT 64
+#define FILE_SIZE (SECTOR_CNT * 512)
+
+/* At most this many runs per file.  Sectors handed out in turn
+   would make one run per sector. */
+#define MAX_EXTENTS (SECTOR_CNT / 4)
+
+static char buf[2][FILE_SIZE];
+
+void
+test_main (void) 
+{
+  const char *file_names[2] = {"one", "two"};
+  int fds[2];
+  size_t ofs;
+  int i;
+
+  random_init (0);
+  random_bytes (buf, sizeof buf);
+
+  for (i = 0; i < 2; i++)
+    {
+      CHECK (create (file_names[i], 0), "create \"%s\"", file_names[i]);
+      CHECK ((fds[i] = open (file_names[i])) > 1,
+             "open \"%s\"", file_names[i]);
+    }
+  for (ofs = 0; ofs < FILE_SIZE; ofs += 512)
+    for (i = 0; i < 2; i++)
+      if (write (fds[i], buf[i] + ofs, 512) != 512)
+        fail ("write 512 bytes at offset %zu in \"%s\" failed",
+              ofs, file_names[i]);
+  msg ("write \"%s\" and \"%s\" in turns", file_names[0], file_names[1]);
+
+  for (i = 0; i < 2; i++)
+    {
+      long long extent_cnt = get_extent_cnt (fds[i]);
+      if (extent_cnt < 1 || extent_cnt > MAX_EXTENTS)
+        fail ("\"%s\" lies in %lld runs of sectors",
+              file_names[i], extent_cnt);
+      msg ("\"%s\" lies in at most %d runs of sectors",
+           file_names[i], MAX_EXTENTS);
+      msg ("close \"%s\"", file_names[i]);
+      close (fds[i]);
+    }
+
+  for (i = 0; i < 2; i++)
+    check_file (file_names[i], buf[i], FILE_SIZE);
+}
@@ -0,0 +1,24 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(grow-apart) begin
+(grow-apart) create "one"
+(grow-apart) open "one"
+(grow-apart) create "two"
+(grow-apart) open "two"
+(grow-apart) write "one" and "two" in turns
+(grow-apart) "one" lies in at most 16 runs of sectors
+(grow-apart) close "one"
+(grow-apart) "two" lies in at most 16 runs of sectors
+(grow-apart) close "two"
+(grow-apart) open "one" for verification
+(grow-apart) verified contents of "one"
+(grow-apart) close "one"
+(grow-apart) open "two" for verification
+(grow-apart) verified contents of "two"
+(grow-apart) close "two"
+(grow-apart) end
+EOF
+pass;
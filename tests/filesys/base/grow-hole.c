@@ -0,0 +1,50 @@
+/* Writes past the end of an empty file, leaving a hole that spans
+   the direct and indirect sectors and reaches into the doubly
+   indirect ones, and checks that the hole reads back as zeros.
+   Then writes into the middle of the hole, which allocates sectors
+   there only, and checks the whole file again. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define FILE_SIZE 150000
+#define TAIL_SIZE 100
+#define MIDDLE_OFS 70000
+#define MIDDLE_SIZE 3000
+
+static char buf[FILE_SIZE];
+
+void
+test_main (void) 
+{
+  const char *file_name = "sparse";
+  int fd;
+
+  memset (buf + FILE_SIZE - TAIL_SIZE, 't', TAIL_SIZE);
+
+  CHECK (create (file_name, 0), "create \"%s\"", file_name);
+  CHECK ((fd = open (file_name)) > 1, "open \"%s\"", file_name);
+  msg ("seek \"%s\" past end of file", file_name);
+  seek (fd, FILE_SIZE - TAIL_SIZE);
+  CHECK (write (fd, buf + FILE_SIZE - TAIL_SIZE, TAIL_SIZE) == TAIL_SIZE,
+         "write \"%s\" past end of file", file_name);
+  CHECK (filesize (fd) == FILE_SIZE, "size of \"%s\" is %d", file_name,
+         FILE_SIZE);
+  msg ("close \"%s\"", file_name);
+  close (fd);
+  check_file (file_name, buf, sizeof buf);
+
+  memset (buf + MIDDLE_OFS, 'm', MIDDLE_SIZE);
+  CHECK ((fd = open (file_name)) > 1, "open \"%s\"", file_name);
+  msg ("seek \"%s\" into the hole", file_name);
+  seek (fd, MIDDLE_OFS);
+  CHECK (write (fd, buf + MIDDLE_OFS, MIDDLE_SIZE) == MIDDLE_SIZE,
+         "write \"%s\" into the hole", file_name);
+  CHECK (filesize (fd) == FILE_SIZE, "size of \"%s\" is %d", file_name,
+         FILE_SIZE);
+  msg ("close \"%s\"", file_name);
+  close (fd);
+  check_file (file_name, buf, sizeof buf);
+}
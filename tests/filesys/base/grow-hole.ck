@@ -0,0 +1,26 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(grow-hole) begin
+(grow-hole) create "sparse"
+(grow-hole) open "sparse"
+(grow-hole) seek "sparse" past end of file
+(grow-hole) write "sparse" past end of file
+(grow-hole) size of "sparse" is 150000
+(grow-hole) close "sparse"
+(grow-hole) open "sparse" for verification
+(grow-hole) verified contents of "sparse"
+(grow-hole) close "sparse"
+(grow-hole) open "sparse"
+(grow-hole) seek "sparse" into the hole
+(grow-hole) write "sparse" into the hole
+(grow-hole) size of "sparse" is 150000
+(grow-hole) close "sparse"
+(grow-hole) open "sparse" for verification
+(grow-hole) verified contents of "sparse"
+(grow-hole) close "sparse"
+(grow-hole) end
+EOF
+pass;
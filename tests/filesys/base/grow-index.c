@@ -0,0 +1,45 @@
+/* Grows an empty file by writing past its end, in pieces that do
+   not line up with sectors, until it needs direct, indirect and
+   doubly indirect index sectors.  Checks the size after every
+   write and reads the whole file back at the end. */
+
+#include <random.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+/* 124 direct and 128 indirect sectors hold 129,024 bytes, so the
+   last sectors need the doubly indirect index. */
+#define FILE_SIZE 160000
+#define CHUNK_SIZE 1234
+
+static char buf[FILE_SIZE];
+
+void
+test_main (void) 
+{
+  const char *file_name = "grown";
+  size_t ofs;
+  int fd;
+
+  random_init (0);
+  random_bytes (buf, sizeof buf);
+
+  CHECK (create (file_name, 0), "create \"%s\"", file_name);
+  CHECK ((fd = open (file_name)) > 1, "open \"%s\"", file_name);
+  for (ofs = 0; ofs < sizeof buf; ofs += CHUNK_SIZE)
+    {
+      size_t size = sizeof buf - ofs < CHUNK_SIZE ? sizeof buf - ofs
+                                                  : CHUNK_SIZE;
+      if (write (fd, buf + ofs, size) != (int) size)
+        fail ("write %zu bytes at offset %zu failed", size, ofs);
+      if ((size_t) filesize (fd) != ofs + size)
+        fail ("size is %d after writing up to %zu",
+              filesize (fd), ofs + size);
+    }
+  msg ("write \"%s\"", file_name);
+  msg ("close \"%s\"", file_name);
+  close (fd);
+
+  check_file (file_name, buf, sizeof buf);
+}
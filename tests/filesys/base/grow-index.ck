@@ -0,0 +1,16 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(grow-index) begin
+(grow-index) create "grown"
+(grow-index) open "grown"
+(grow-index) write "grown"
+(grow-index) close "grown"
+(grow-index) open "grown" for verification
+(grow-index) verified contents of "grown"
+(grow-index) close "grown"
+(grow-index) end
+EOF
+pass;
@@ -0,0 +1,49 @@
+/* Spawns several child processes that stream through files at
+   the same time.  Every child rewrites a private file and reads
+   back both it and a file shared by all of them, so unrelated
+   reads and writes proceed in parallel.  Then the parent checks
+   every private file. */
+
+#include <random.h>
+#include <stdio.h>
+#include <syscall.h>
+#include "tests/filesys/base/syn-par-rw.h"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static char buf[FILE_SIZE];
+
+void
+test_main (void) 
+{
+  pid_t children[CHILD_CNT];
+  char name[16];
+  int fd;
+  int i;
+
+  random_init (CHILD_CNT);
+  random_bytes (buf, sizeof buf);
+  CHECK (create (shared_name, sizeof buf), "create \"%s\"", shared_name);
+  CHECK ((fd = open (shared_name)) > 1, "open \"%s\"", shared_name);
+  CHECK (write (fd, buf, sizeof buf) == sizeof buf,
+         "write \"%s\"", shared_name);
+  msg ("close \"%s\"", shared_name);
+  close (fd);
+
+  for (i = 0; i < CHILD_CNT; i++)
+    {
+      snprintf (name, sizeof name, "rw-%d", i);
+      CHECK (create (name, FILE_SIZE), "create \"%s\"", name);
+    }
+
+  exec_children ("child-par-rw", children, CHILD_CNT);
+  wait_children (children, CHILD_CNT);
+
+  for (i = 0; i < CHILD_CNT; i++)
+    {
+      snprintf (name, sizeof name, "rw-%d", i);
+      random_init (i);
+      random_bytes (buf, sizeof buf);
+      check_file (name, buf, sizeof buf);
+    }
+}
@@ -0,0 +1,37 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(syn-par-rw) begin
+(syn-par-rw) create "shared"
+(syn-par-rw) open "shared"
+(syn-par-rw) write "shared"
+(syn-par-rw) close "shared"
+(syn-par-rw) create "rw-0"
+(syn-par-rw) create "rw-1"
+(syn-par-rw) create "rw-2"
+(syn-par-rw) create "rw-3"
+(syn-par-rw) exec child 1 of 4: "child-par-rw 0"
+(syn-par-rw) exec child 2 of 4: "child-par-rw 1"
+(syn-par-rw) exec child 3 of 4: "child-par-rw 2"
+(syn-par-rw) exec child 4 of 4: "child-par-rw 3"
+(syn-par-rw) wait for child 1 of 4 returned 0 (expected 0)
+(syn-par-rw) wait for child 2 of 4 returned 1 (expected 1)
+(syn-par-rw) wait for child 3 of 4 returned 2 (expected 2)
+(syn-par-rw) wait for child 4 of 4 returned 3 (expected 3)
+(syn-par-rw) open "rw-0" for verification
+(syn-par-rw) verified contents of "rw-0"
+(syn-par-rw) close "rw-0"
+(syn-par-rw) open "rw-1" for verification
+(syn-par-rw) verified contents of "rw-1"
+(syn-par-rw) close "rw-1"
+(syn-par-rw) open "rw-2" for verification
+(syn-par-rw) verified contents of "rw-2"
+(syn-par-rw) close "rw-2"
+(syn-par-rw) open "rw-3" for verification
+(syn-par-rw) verified contents of "rw-3"
+(syn-par-rw) close "rw-3"
+(syn-par-rw) end
+EOF
+pass;
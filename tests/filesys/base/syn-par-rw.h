@@ -0,0 +1,9 @@
+#ifndef TESTS_FILESYS_BASE_SYN_PAR_RW_H
+#define TESTS_FILESYS_BASE_SYN_PAR_RW_H
+
+#define CHILD_CNT 4
+#define CHUNK_SIZE 700
+#define FILE_SIZE (24 * CHUNK_SIZE)
+static const char shared_name[] = "shared";
+
+#endif /* tests/filesys/base/syn-par-rw.h */
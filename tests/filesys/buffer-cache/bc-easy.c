@@ -13,13 +13,22 @@ test_main (void) {
   int fd;
   char c;
   long long read_cnt, write_cnt;
+  long long hit_cnt, miss_cnt, writeback_cnt, flush_cnt, flushes;
 
   CHECK (create (file_name, sizeof buf), "create \"%s\"", file_name);
   CHECK ((fd = open (file_name)) > 1, "open \"%s\"", file_name);
   random_bytes (buf, sizeof buf);
 
+  /* Put the creation on disk, so that background write-back during
+     the test can only write the file's data sectors, once per pass. */
+  journal_commit_now ();
+
   read_cnt = get_fs_disk_read_cnt();
   write_cnt = get_fs_disk_write_cnt();
+  hit_cnt = get_cache_hit_cnt ();
+  miss_cnt = get_cache_miss_cnt ();
+  writeback_cnt = get_cache_writeback_cnt ();
+  flush_cnt = get_cache_flush_cnt ();
 
   CHECK (write (fd, buf, sizeof buf) > 0, "write \"%s\"", file_name);
 
@@ -38,10 +47,18 @@ test_main (void) {
     if (c != 'a') fail("file content mismatch in %d : %x %x", i, buf[i], c);
   }
 
+  flushes = get_cache_flush_cnt () - flush_cnt;
   CHECK (get_fs_disk_read_cnt() <= read_cnt, 
         "check read_cnt");
-  CHECK (get_fs_disk_write_cnt() <= write_cnt + TEST_SIZE / 512, 
+  CHECK (get_fs_disk_write_cnt() <= write_cnt + (flushes + 1) * TEST_SIZE / 512,
         "check write_cnt");
+  CHECK (get_cache_hit_cnt () >= hit_cnt + 3 * TEST_SIZE,
+        "check hit_cnt");
+  CHECK (get_cache_miss_cnt () == miss_cnt,
+        "check miss_cnt");
+  CHECK (get_cache_writeback_cnt ()
+         <= writeback_cnt + (flushes + 1) * TEST_SIZE / 512,
+        "check writeback_cnt");
 
   msg ("close \"%s\"", file_name);
   close (fd);
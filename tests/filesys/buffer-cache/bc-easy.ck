@@ -9,6 +9,9 @@ check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
 (bc-easy) write "data"
 (bc-easy) check read_cnt
 (bc-easy) check write_cnt
+(bc-easy) check hit_cnt
+(bc-easy) check miss_cnt
+(bc-easy) check writeback_cnt
 (bc-easy) close "data"
 (bc-easy) end
 EOF
@@ -0,0 +1,61 @@
+/* Reads a file too large for the buffer cache front to back and
+   checks that read-ahead brings every sector in exactly once: no
+   sector is read from disk twice because it was evicted before the
+   reader got to it, and nothing past the end of file is read.  Also
+   checks that read-ahead, not the reader, takes most of the misses. */
+
+#include <random.h>
+#include <string.h>
+#include <stdio.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+#define TEST_SIZE (128 * 512)
+#define BLOCK_SIZE 512
+
+static const char file_name[] = "data";
+static char buf[TEST_SIZE];
+static char block[BLOCK_SIZE];
+
+void
+test_main (void) {
+  int fd;
+  size_t ofs;
+  long long read_cnt, miss_cnt, prefetch_cnt, reader_misses;
+
+  CHECK (create (file_name, sizeof buf), "create \"%s\"", file_name);
+  CHECK ((fd = open (file_name)) > 1, "open \"%s\"", file_name);
+  random_bytes (buf, sizeof buf);
+  CHECK (write (fd, buf, sizeof buf) == sizeof buf, "write \"%s\"", file_name);
+
+  /* The cache holds half of the file, so the first half has been
+     evicted and must come back from disk. */
+  seek (fd, 0);
+  read_cnt = get_fs_disk_read_cnt ();
+  miss_cnt = get_cache_miss_cnt ();
+  prefetch_cnt = get_cache_prefetch_cnt ();
+
+  msg ("read \"%s\"", file_name);
+  for (ofs = 0; ofs < sizeof buf; ofs += BLOCK_SIZE)
+    {
+      if (read (fd, block, BLOCK_SIZE) != BLOCK_SIZE)
+        fail ("read %d bytes at offset %zu failed", BLOCK_SIZE, ofs);
+      if (memcmp (block, buf + ofs, BLOCK_SIZE))
+        fail ("file content mismatch at offset %zu", ofs);
+    }
+
+  CHECK (get_fs_disk_read_cnt () <= read_cnt + TEST_SIZE / 512,
+         "check read_cnt");
+  CHECK (get_cache_miss_cnt () <= miss_cnt + TEST_SIZE / 512,
+         "check miss_cnt");
+
+  /* Without read-ahead, the reader itself would miss on every one of
+     the TEST_SIZE / 512 sectors. */
+  reader_misses = (get_cache_miss_cnt () - miss_cnt)
+                  - (get_cache_prefetch_cnt () - prefetch_cnt);
+  CHECK (reader_misses < TEST_SIZE / 512 / 4,
+         "check reader misses");
+
+  msg ("close \"%s\"", file_name);
+  close (fd);
+}
@@ -0,0 +1,17 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(bc-readahead) begin
+(bc-readahead) create "data"
+(bc-readahead) open "data"
+(bc-readahead) write "data"
+(bc-readahead) read "data"
+(bc-readahead) check read_cnt
+(bc-readahead) check miss_cnt
+(bc-readahead) check reader misses
+(bc-readahead) close "data"
+(bc-readahead) end
+EOF
+pass;
@@ -0,0 +1,8 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+use tests::random;
+my ($data) = random_bytes (4321);
+check_archive ({"kept" => [$data], "removed" => [$data]});
+pass;
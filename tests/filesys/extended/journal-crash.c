@@ -0,0 +1,43 @@
+/* Commits one file to the file system journal, then creates,
+   writes and removes others without committing and simulates a
+   crash.  After the crash the file system must hold exactly the
+   committed file: nothing of the later operations may survive in
+   part. */
+
+#include <random.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define FILE_SIZE 4321
+static char buf[FILE_SIZE];
+
+/* Creates NAME and writes BUF to it. */
+static void
+write_file (const char *name)
+{
+  int fd;
+
+  CHECK (create (name, 0), "create \"%s\"", name);
+  CHECK ((fd = open (name)) > 1, "open \"%s\"", name);
+  CHECK (write (fd, buf, sizeof buf) == FILE_SIZE, "write \"%s\"", name);
+  msg ("close \"%s\"", name);
+  close (fd);
+}
+
+void
+test_main (void) 
+{
+  random_init (0);
+  random_bytes (buf, sizeof buf);
+
+  write_file ("kept");
+  write_file ("removed");
+  journal_commit_now ();
+  msg ("commit");
+
+  write_file ("lost");
+  CHECK (remove ("removed"), "remove \"removed\"");
+  msg ("crash");
+  crash_now ();
+}
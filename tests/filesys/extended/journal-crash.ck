@@ -0,0 +1,24 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(journal-crash) begin
+(journal-crash) create "kept"
+(journal-crash) open "kept"
+(journal-crash) write "kept"
+(journal-crash) close "kept"
+(journal-crash) create "removed"
+(journal-crash) open "removed"
+(journal-crash) write "removed"
+(journal-crash) close "removed"
+(journal-crash) commit
+(journal-crash) create "lost"
+(journal-crash) open "lost"
+(journal-crash) write "lost"
+(journal-crash) close "lost"
+(journal-crash) remove "removed"
+(journal-crash) crash
+(journal-crash) end
+EOF
+pass;
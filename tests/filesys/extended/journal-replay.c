@@ -0,0 +1,30 @@
+/* Writes a file and then simulates a crash right after the file
+   system journal commits it, before any metadata reaches its place
+   on disk.  The file survives only if the next boot replays the
+   journal. */
+
+#include <random.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define FILE_SIZE 6789
+static char buf[FILE_SIZE];
+
+void
+test_main (void) 
+{
+  int fd;
+
+  random_init (0);
+  random_bytes (buf, sizeof buf);
+
+  CHECK (create ("journaled", 0), "create \"journaled\"");
+  CHECK ((fd = open ("journaled")) > 1, "open \"journaled\"");
+  CHECK (write (fd, buf, sizeof buf) == FILE_SIZE, "write \"journaled\"");
+  msg ("close \"journaled\"");
+  close (fd);
+
+  msg ("crash after commit");
+  crash_after_commit ();
+}
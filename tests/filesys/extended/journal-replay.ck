@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(journal-replay) begin
+(journal-replay) create "journaled"
+(journal-replay) open "journaled"
+(journal-replay) write "journaled"
+(journal-replay) close "journaled"
+(journal-replay) crash after commit
+(journal-replay) end
+EOF
+pass;
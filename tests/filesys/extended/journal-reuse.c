@@ -0,0 +1,52 @@
+/* Commits one file to the file system journal, removes it and
+   writes another file, larger than the buffer cache, without
+   committing, and simulates a crash.  The removal was not committed,
+   so the removed file must survive intact: its sectors must not
+   have been reused for the new file's data meanwhile. */
+
+#include <random.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define FILE_SIZE 4321
+#define BLOCK_SIZE 512
+#define BLOCK_CNT 128
+static char buf[FILE_SIZE];
+static char block[BLOCK_SIZE];
+
+void
+test_main (void) 
+{
+  int fd;
+  int i;
+
+  random_init (0);
+  random_bytes (buf, sizeof buf);
+
+  CHECK (create ("removed", 0), "create \"removed\"");
+  CHECK ((fd = open ("removed")) > 1, "open \"removed\"");
+  CHECK (write (fd, buf, sizeof buf) == FILE_SIZE, "write \"removed\"");
+  msg ("close \"removed\"");
+  close (fd);
+  journal_commit_now ();
+  msg ("commit");
+
+  CHECK (remove ("removed"), "remove \"removed\"");
+
+  /* Enough data that the buffer cache has to write some of it in
+     place before the crash. */
+  memset (block, 'n', sizeof block);
+  CHECK (create ("new", 0), "create \"new\"");
+  CHECK ((fd = open ("new")) > 1, "open \"new\"");
+  for (i = 0; i < BLOCK_CNT; i++)
+    if (write (fd, block, sizeof block) != BLOCK_SIZE)
+      fail ("write block %d of \"new\" failed", i);
+  msg ("write \"new\"");
+  msg ("close \"new\"");
+  close (fd);
+
+  msg ("crash");
+  crash_now ();
+}
@@ -0,0 +1,20 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(journal-reuse) begin
+(journal-reuse) create "removed"
+(journal-reuse) open "removed"
+(journal-reuse) write "removed"
+(journal-reuse) close "removed"
+(journal-reuse) commit
+(journal-reuse) remove "removed"
+(journal-reuse) create "new"
+(journal-reuse) open "new"
+(journal-reuse) write "new"
+(journal-reuse) close "new"
+(journal-reuse) crash
+(journal-reuse) end
+EOF
+pass;
@@ -0,0 +1,51 @@
+/* Executes child-simple repeatedly and checks that executing it
+   again does not parse its headers, because they come from the
+   exec cache, and that writing to the executable makes the next
+   exec parse them again.  Headers parsed are counted by the kernel;
+   disk reads would not tell, since the buffer cache also keeps the
+   headers' sectors. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+/* Runs child-simple once and returns the number of times headers
+   were parsed meanwhile. */
+static long long
+run_child (void)
+{
+  long long before = get_exec_parse_cnt ();
+  pid_t pid;
+
+  if (!(pid = fork ("child-simple")))
+    exec ("child-simple");
+  if (wait (pid) != 81)
+    fail ("child-simple: wrong exit status");
+  return get_exec_parse_cnt () - before;
+}
+
+void
+test_main (void) 
+{
+  long long cold, warm, rewritten;
+  char byte;
+  int fd;
+
+  cold = run_child ();
+  warm = run_child ();
+  if (cold == 0 || warm != 0)
+    fail ("first exec parsed headers %lld times, second %lld", cold, warm);
+  msg ("second exec used the cached headers");
+
+  /* Write the first byte back unchanged. */
+  CHECK ((fd = open ("child-simple")) > 1, "open \"child-simple\"");
+  CHECK (read (fd, &byte, 1) == 1, "read first byte");
+  seek (fd, 0);
+  CHECK (write (fd, &byte, 1) == 1, "write first byte back");
+  close (fd);
+
+  rewritten = run_child ();
+  if (rewritten == 0)
+    fail ("exec after write used the stale cached headers");
+  msg ("exec after write parsed the headers again");
+}
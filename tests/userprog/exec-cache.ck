@@ -0,0 +1,21 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(exec-cache) begin
+(child-simple) run
+child-simple: exit(81)
+(child-simple) run
+child-simple: exit(81)
+(exec-cache) second exec used the cached headers
+(exec-cache) open "child-simple"
+(exec-cache) read first byte
+(exec-cache) write first byte back
+(child-simple) run
+child-simple: exit(81)
+(exec-cache) exec after write parsed the headers again
+(exec-cache) end
+exec-cache: exit(0)
+EOF
+pass;
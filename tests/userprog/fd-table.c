@@ -0,0 +1,55 @@
+/* Opens more files than fit in the initial descriptor table and
+   checks that descriptors are handed out lowest-first, that dup2
+   shares one file position between two descriptors and that a
+   forked child gets the shared file once, with its own position. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define FD_CNT 100
+
+void
+test_main (void) 
+{
+  int fds[FD_CNT];
+  char buf[10];
+  pid_t pid;
+  int i;
+
+  for (i = 0; i < FD_CNT; i++)
+    {
+      fds[i] = open ("sample.txt");
+      if (fds[i] < 2)
+        fail ("open #%d returned %d", i, fds[i]);
+      if (i > 0 && fds[i] != fds[i - 1] + 1)
+        fail ("open #%d returned %d after %d", i, fds[i], fds[i - 1]);
+    }
+  msg ("opened %d files", FD_CNT);
+
+  close (fds[50]);
+  close (fds[10]);
+  CHECK (open ("sample.txt") == fds[10], "reopen lowest closed descriptor");
+  CHECK (open ("sample.txt") == fds[50], "reopen next closed descriptor");
+
+  CHECK (dup2 (fds[0], fds[99]) == fds[99], "dup2 over open descriptor");
+  CHECK (read (fds[0], buf, sizeof buf) == sizeof buf, "read through original");
+  CHECK (tell (fds[99]) == sizeof buf, "duplicate shares position");
+  close (fds[0]);
+  CHECK (read (fds[99], buf, sizeof buf) == sizeof buf,
+         "read through duplicate after closing original");
+
+  if ((pid = fork ("child")) == 0)
+    {
+      if (tell (fds[99]) != 2 * sizeof buf)
+        fail ("child position %u", tell (fds[99]));
+      seek (fds[99], 0);
+      exit (0);
+    }
+  CHECK (wait (pid) == 0, "wait for child");
+  CHECK (tell (fds[99]) == 2 * sizeof buf, "child has its own position");
+
+  for (i = 1; i < FD_CNT; i++)
+    close (fds[i]);
+  CHECK (open ("sample.txt") == fds[0], "descriptors reused after close");
+}
@@ -0,0 +1,21 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(fd-table) begin
+(fd-table) opened 100 files
+(fd-table) reopen lowest closed descriptor
+(fd-table) reopen next closed descriptor
+(fd-table) dup2 over open descriptor
+(fd-table) read through original
+(fd-table) duplicate shares position
+(fd-table) read through duplicate after closing original
+child: exit(0)
+(fd-table) wait for child
+(fd-table) child has its own position
+(fd-table) descriptors reused after close
+(fd-table) end
+fd-table: exit(0)
+EOF
+pass;
@@ -0,0 +1,139 @@
+/* Hands 64 kB from a child to its parent through a pipe and then
+   through a temporary file, checking the data both ways and that
+   the pipe never touches the disk.  Finally moves the data from the
+   file through a pipe into another file with splice(), after
+   checking that splice() refuses the wrong end of a pipe. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define DATA_SIZE (64 * 1024)
+#define CHUNK_SIZE 4096
+
+static char chunk[CHUNK_SIZE];
+
+/* Byte at offset OFS of the data. */
+static char
+data_byte (int ofs)
+{
+  return ofs % 251;
+}
+
+/* Writes the data to FD in chunks and exits. */
+static void
+produce (int fd)
+{
+  int ofs, i;
+
+  for (ofs = 0; ofs < DATA_SIZE; ofs += CHUNK_SIZE)
+    {
+      for (i = 0; i < CHUNK_SIZE; i++)
+        chunk[i] = data_byte (ofs + i);
+      if (write (fd, chunk, CHUNK_SIZE) != CHUNK_SIZE)
+        exit (1);
+    }
+  exit (0);
+}
+
+/* Reads FD until end of file, checking that it holds the data.
+   Returns the number of bytes read. */
+static int
+consume (int fd)
+{
+  int ofs = 0;
+  int n, i;
+
+  while ((n = read (fd, chunk, CHUNK_SIZE)) > 0)
+    {
+      for (i = 0; i < n; i++)
+        if (chunk[i] != data_byte (ofs + i))
+          fail ("byte %d differs", ofs + i);
+      ofs += n;
+    }
+  return ofs;
+}
+
+void
+test_main (void) 
+{
+  long long writes, pipe_writes;
+  int fds[2];
+  pid_t pid;
+  int fd, n, moved;
+
+  /* Pipe handoff. */
+  CHECK (pipe (fds) == 0, "pipe");
+
+  /* Put what formatting and loading left dirty on disk first, so
+     that a periodic commit during the handoff has nothing to write. */
+  journal_commit_now ();
+  writes = get_fs_disk_write_cnt ();
+  if ((pid = fork ("producer")) == 0)
+    {
+      close (fds[0]);
+      produce (fds[1]);
+    }
+  close (fds[1]);
+  if ((n = consume (fds[0])) != DATA_SIZE)
+    fail ("read %d bytes from pipe", n);
+  msg ("read %d bytes from pipe", DATA_SIZE);
+  close (fds[0]);
+  CHECK (wait (pid) == 0, "wait for pipe producer");
+  pipe_writes = get_fs_disk_write_cnt () - writes;
+  if (pipe_writes != 0)
+    fail ("pipe handoff wrote %lld sectors", pipe_writes);
+  msg ("pipe handoff wrote nothing to disk");
+
+  /* Temporary file handoff. */
+  CHECK (create ("handoff", DATA_SIZE), "create \"handoff\"");
+  if ((pid = fork ("producer")) == 0)
+    produce (open ("handoff"));
+  CHECK (wait (pid) == 0, "wait for file producer");
+  CHECK ((fd = open ("handoff")) > 1, "open \"handoff\"");
+  if ((n = consume (fd)) != DATA_SIZE)
+    fail ("read %d bytes from file", n);
+  msg ("read %d bytes from file", DATA_SIZE);
+  close (fd);
+
+  /* Data only leaves a pipe through its read end and only enters it
+     through its write end. */
+  CHECK (pipe (fds) == 0, "pipe");
+  CHECK ((fd = open ("handoff")) > 1, "open \"handoff\"");
+  CHECK (splice (fds[1], fd, CHUNK_SIZE) == -1,
+         "splice from write end fails");
+  CHECK (splice (fd, fds[0], CHUNK_SIZE) == -1,
+         "splice into read end fails");
+  close (fd);
+  close (fds[0]);
+  close (fds[1]);
+
+  /* File to pipe to file. */
+  CHECK (create ("spliced", DATA_SIZE), "create \"spliced\"");
+  CHECK (pipe (fds) == 0, "pipe");
+  if ((pid = fork ("splicer")) == 0)
+    {
+      close (fds[0]);
+      fd = open ("handoff");
+      while (splice (fd, fds[1], DATA_SIZE) > 0)
+        continue;
+      exit (0);
+    }
+  close (fds[1]);
+  CHECK ((fd = open ("spliced")) > 1, "open \"spliced\"");
+  moved = 0;
+  while ((n = splice (fds[0], fd, CHUNK_SIZE)) > 0)
+    moved += n;
+  if (moved != DATA_SIZE)
+    fail ("spliced %d bytes", moved);
+  msg ("spliced %d bytes", DATA_SIZE);
+  close (fds[0]);
+  close (fd);
+  CHECK (wait (pid) == 0, "wait for splicer");
+
+  CHECK ((fd = open ("spliced")) > 1, "open \"spliced\"");
+  if ((n = consume (fd)) != DATA_SIZE)
+    fail ("read %d bytes from spliced file", n);
+  msg ("spliced file holds the data");
+  close (fd);
+}
@@ -0,0 +1,28 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(pipe-bench) begin
+(pipe-bench) pipe
+(pipe-bench) read 65536 bytes from pipe
+(pipe-bench) wait for pipe producer
+(pipe-bench) pipe handoff wrote nothing to disk
+(pipe-bench) create "handoff"
+(pipe-bench) wait for file producer
+(pipe-bench) open "handoff"
+(pipe-bench) read 65536 bytes from file
+(pipe-bench) pipe
+(pipe-bench) open "handoff"
+(pipe-bench) splice from write end fails
+(pipe-bench) splice into read end fails
+(pipe-bench) create "spliced"
+(pipe-bench) pipe
+(pipe-bench) open "spliced"
+(pipe-bench) spliced 65536 bytes
+(pipe-bench) wait for splicer
+(pipe-bench) open "spliced"
+(pipe-bench) spliced file holds the data
+(pipe-bench) end
+EOF
+pass;
@@ -0,0 +1,55 @@
+/* Forks thousands of children that exit without being waited for
+   and checks that they do not keep their memory: the number of
+   pages in use afterwards must be about what it was before. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define CHILD_CNT 2000
+
+/* Pages that children still exiting may hold at the end. */
+#define SLACK_PAGES 256
+
+/* Forks and waits for a few children, giving children forked
+   earlier time to finish exiting. */
+static void
+settle (void)
+{
+  int i;
+
+  for (i = 0; i < 4; i++)
+    {
+      pid_t pid = fork ("settle");
+      if (pid == 0)
+        exit (0);
+      if (wait (pid) != 0)
+        fail ("wait for settle child");
+    }
+}
+
+void
+test_main (void) 
+{
+  long long before, after;
+  int i;
+
+  settle ();
+  before = get_used_page_cnt ();
+
+  for (i = 0; i < CHILD_CNT; i++)
+    {
+      pid_t pid = fork ("child");
+      if (pid == 0)
+        exit (0);
+      if (pid < 0)
+        fail ("fork #%d failed", i);
+    }
+  msg ("forked %d children without waiting", CHILD_CNT);
+
+  settle ();
+  after = get_used_page_cnt ();
+  if (after - before >= SLACK_PAGES)
+    fail ("%lld pages in use before, %lld after", before, after);
+  msg ("page use stayed flat");
+}
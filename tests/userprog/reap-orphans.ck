@@ -0,0 +1,11 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(reap-orphans) begin
+(reap-orphans) forked 2000 children without waiting
+(reap-orphans) page use stayed flat
+(reap-orphans) end
+EOF
+pass;
@@ -0,0 +1,117 @@
+/* Writes the same records into two files, once with one write()
+   per record and once through the submission ring, and checks
+   that the ring produced the same contents with a single trap.
+   Then reads the records back through the ring, behind a fence. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define RECORD_CNT 16
+#define RECORD_SIZE 32
+
+static char buf[RECORD_CNT * RECORD_SIZE];
+static char rbuf[RECORD_CNT * RECORD_SIZE];
+static struct ring ring;
+
+/* Queues an SQE on RING. */
+static void
+submit (uint32_t opcode, int fd, void *addr, uint32_t len, int64_t off,
+        uint64_t user_data)
+{
+  struct ring_sqe *sqe = &ring.sq[ring.sq_tail % RING_ENTRIES];
+
+  sqe->opcode = opcode;
+  sqe->fd = fd;
+  sqe->addr = (uint64_t) addr;
+  sqe->len = len;
+  sqe->flags = 0;
+  sqe->off = off;
+  sqe->user_data = user_data;
+  ring.sq_tail++;
+}
+
+/* Reaps the next CQE from RING, checking its USER_DATA. */
+static int64_t
+reap (uint64_t user_data)
+{
+  struct ring_cqe *cqe = &ring.cq[ring.cq_head % RING_ENTRIES];
+
+  if (ring.cq_head == ring.cq_tail)
+    fail ("completion queue empty");
+  if (cqe->user_data != user_data)
+    fail ("completion for %lld, expected %lld",
+          (long long) cqe->user_data, (long long) user_data);
+  ring.cq_head++;
+  return cqe->res;
+}
+
+void
+test_main (void) 
+{
+  long long before, direct_cnt, ring_cnt;
+  int fd, i;
+
+  for (i = 0; i < (int) sizeof buf; i++)
+    buf[i] = 'a' + i % 26;
+
+  CHECK (create ("direct", sizeof buf), "create \"direct\"");
+  CHECK (create ("ringed", sizeof buf), "create \"ringed\"");
+
+  /* One trap per record. */
+  CHECK ((fd = open ("direct")) > 1, "open \"direct\"");
+  before = get_syscall_cnt ();
+  for (i = 0; i < RECORD_CNT; i++)
+    write (fd, buf + i * RECORD_SIZE, RECORD_SIZE);
+  direct_cnt = get_syscall_cnt () - before;
+  close (fd);
+
+  /* The same records through the ring.  The open completes first
+     since the writes need its descriptor. */
+  CHECK (ring_setup (&ring) == 0, "ring_setup");
+  submit (RING_OP_OPEN, 0, "ringed", 0, 0, 100);
+  CHECK (ring_enter () == 1, "submit open");
+  CHECK ((fd = reap (100)) > 1, "open \"ringed\" through ring");
+
+  for (i = 0; i < RECORD_CNT; i++)
+    submit (RING_OP_WRITE, fd, buf + i * RECORD_SIZE, RECORD_SIZE,
+            i * RECORD_SIZE, i);
+  submit (RING_OP_CLOSE, fd, NULL, 0, 0, RECORD_CNT);
+  before = get_syscall_cnt ();
+  i = ring_enter ();
+  ring_cnt = get_syscall_cnt () - before;
+  if (i != RECORD_CNT + 1)
+    fail ("ring_enter() consumed %d entries, expected %d", i, RECORD_CNT + 1);
+  for (i = 0; i < RECORD_CNT; i++)
+    if (reap (i) != RECORD_SIZE)
+      fail ("short write for record %d", i);
+  CHECK (reap (RECORD_CNT) == 0, "close through ring");
+
+  if (direct_cnt < RECORD_CNT || ring_cnt != 1)
+    fail ("%lld traps direct, %lld through the ring", direct_cnt, ring_cnt);
+  msg ("ring took 1 trap for %d writes", RECORD_CNT);
+
+  /* The reads complete in the background; the nop after them is a
+     fence, so all of them have completed when ring_enter()
+     returns. */
+  CHECK ((fd = open ("ringed")) > 1, "open \"ringed\" for reading");
+  for (i = 0; i < RECORD_CNT; i++)
+    submit (RING_OP_READ, fd, rbuf + i * RECORD_SIZE, RECORD_SIZE,
+            i * RECORD_SIZE, 100 + i);
+  submit (RING_OP_NOP, 0, NULL, 0, 0, 200);
+  i = ring_enter ();
+  if (i != RECORD_CNT + 1)
+    fail ("ring_enter() consumed %d entries, expected %d", i, RECORD_CNT + 1);
+  for (i = 0; i < RECORD_CNT; i++)
+    if (reap (100 + i) != RECORD_SIZE)
+      fail ("short read for record %d", i);
+  CHECK (reap (200) == 0, "fence after reads");
+  if (memcmp (rbuf, buf, sizeof buf))
+    fail ("records read through the ring differ");
+  msg ("read back %d records through the ring", RECORD_CNT);
+  close (fd);
+
+  check_file ("direct", buf, sizeof buf);
+  check_file ("ringed", buf, sizeof buf);
+}
@@ -0,0 +1,27 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(ring-batch) begin
+(ring-batch) create "direct"
+(ring-batch) create "ringed"
+(ring-batch) open "direct"
+(ring-batch) ring_setup
+(ring-batch) submit open
+(ring-batch) open "ringed" through ring
+(ring-batch) close through ring
+(ring-batch) ring took 1 trap for 16 writes
+(ring-batch) open "ringed" for reading
+(ring-batch) fence after reads
+(ring-batch) read back 16 records through the ring
+(ring-batch) open "direct" for verification
+(ring-batch) verified contents of "direct"
+(ring-batch) close "direct"
+(ring-batch) open "ringed" for verification
+(ring-batch) verified contents of "ringed"
+(ring-batch) close "ringed"
+(ring-batch) end
+ring-batch: exit(0)
+EOF
+pass;
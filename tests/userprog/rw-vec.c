@@ -0,0 +1,67 @@
+/* Writes a file with writev() and pwritev() from segments of
+   uneven size, then reads it back with readv() and preadv() using
+   a different split and checks the contents. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/userprog/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define SPLIT 37
+
+void
+test_main (void) 
+{
+  size_t size = sizeof sample - 1;
+  char buf[sizeof sample];
+  struct iovec iov[3];
+  int handle, byte_cnt;
+
+  CHECK (create ("test.txt", size), "create \"test.txt\"");
+  CHECK ((handle = open ("test.txt")) > 1, "open \"test.txt\"");
+
+  /* Gather the first part from three segments at the file position,
+     the rest from one segment at an explicit offset. */
+  iov[0].iov_base = sample;
+  iov[0].iov_len = 1;
+  iov[1].iov_base = sample + 1;
+  iov[1].iov_len = 0;
+  iov[2].iov_base = sample + 1;
+  iov[2].iov_len = SPLIT - 1;
+  byte_cnt = writev (handle, iov, 3);
+  if (byte_cnt != SPLIT)
+    fail ("writev() returned %d instead of %d", byte_cnt, SPLIT);
+  CHECK (tell (handle) == SPLIT, "tell after writev");
+
+  iov[0].iov_base = sample + SPLIT;
+  iov[0].iov_len = size - SPLIT;
+  byte_cnt = pwritev (handle, iov, 1, SPLIT);
+  if (byte_cnt != (int) (size - SPLIT))
+    fail ("pwritev() returned %d instead of %zu", byte_cnt, size - SPLIT);
+  CHECK (tell (handle) == SPLIT, "tell after pwritev");
+
+  /* Scatter it back with a different split. */
+  memset (buf, 0, sizeof buf);
+  iov[0].iov_base = buf;
+  iov[0].iov_len = 100;
+  iov[1].iov_base = buf + 100;
+  iov[1].iov_len = size - 100;
+  byte_cnt = preadv (handle, iov, 2, 0);
+  if (byte_cnt != (int) size)
+    fail ("preadv() returned %d instead of %zu", byte_cnt, size);
+  compare_bytes (buf, sample, size, 0, "test.txt");
+
+  memset (buf, 0, sizeof buf);
+  seek (handle, 0);
+  iov[0].iov_len = 1;
+  iov[1].iov_base = buf + 1;
+  iov[1].iov_len = size - 1;
+  byte_cnt = readv (handle, iov, 2);
+  if (byte_cnt != (int) size)
+    fail ("readv() returned %d instead of %zu", byte_cnt, size);
+  compare_bytes (buf, sample, size, 0, "test.txt");
+
+  CHECK (readv (handle, iov, 2) == 0, "readv at end of file");
+  CHECK (readv (handle, iov, -1) == -1, "readv with negative count");
+}
@@ -0,0 +1,16 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(rw-vec) begin
+(rw-vec) create "test.txt"
+(rw-vec) open "test.txt"
+(rw-vec) tell after writev
+(rw-vec) tell after pwritev
+(rw-vec) readv at end of file
+(rw-vec) readv with negative count
+(rw-vec) end
+rw-vec: exit(0)
+EOF
+pass;
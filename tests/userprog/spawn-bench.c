@@ -0,0 +1,73 @@
+/* Starts child-simple repeatedly, first with fork() and exec()
+   and then with spawn(), and checks that spawn() does no more
+   kernel work than fork() did.  The parent keeps a large, touched
+   buffer that fork() has to duplicate and spawn() does not.  Also
+   checks that spawn() applies its descriptor actions without
+   touching the parent's descriptors and reports a missing
+   executable to the parent. */
+
+#include <syscall.h>
+#include "tests/userprog/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define ROUNDS 4
+#define BUF_SIZE (64 * 4096)
+
+static char buf[BUF_SIZE];
+
+void
+test_main (void) 
+{
+  struct spawn_action actions[2];
+  long long before, fork_cnt, spawn_cnt;
+  int fd, pid, i;
+
+  for (i = 0; i < BUF_SIZE; i += 4096)
+    buf[i] = i / 4096;
+
+  before = get_kernel_malloc_cnt ();
+  for (i = 0; i < ROUNDS; i++)
+    {
+      pid = fork ("child");
+      if (pid == 0)
+        exec ("child-simple");
+      if (wait (pid) != 81)
+        fail ("fork+exec round %d: wrong exit status", i);
+    }
+  fork_cnt = get_kernel_malloc_cnt () - before;
+  msg ("fork+exec ran %d children", ROUNDS);
+
+  before = get_kernel_malloc_cnt ();
+  for (i = 0; i < ROUNDS; i++)
+    {
+      pid = spawn ("child-simple", NULL, 0);
+      if (pid < 0 || wait (pid) != 81)
+        fail ("spawn round %d: wrong exit status", i);
+    }
+  spawn_cnt = get_kernel_malloc_cnt () - before;
+  msg ("spawn ran %d children", ROUNDS);
+
+  if (spawn_cnt > fork_cnt)
+    fail ("spawn made %lld kernel allocations, fork+exec %lld",
+          spawn_cnt, fork_cnt);
+  msg ("spawn was no more expensive than fork+exec");
+
+  CHECK ((fd = open ("sample.txt")) > 1, "open \"sample.txt\"");
+  actions[0].op = SPAWN_DUP2;
+  actions[0].fd = fd;
+  actions[0].newfd = 10;
+  actions[1].op = SPAWN_CLOSE;
+  actions[1].fd = fd;
+  actions[1].newfd = 0;
+  CHECK ((pid = spawn ("child-close 10", actions, 2)) > 0,
+         "spawn child-close with the file moved to fd 10");
+  CHECK (wait (pid) == 0, "wait for child-close");
+  check_file_handle (fd, "sample.txt", sample, sizeof sample - 1);
+
+  CHECK (spawn ("no-such-file", NULL, 0) == -1, "spawn missing file");
+
+  for (i = 0; i < BUF_SIZE; i += 4096)
+    if (buf[i] != i / 4096)
+      fail ("buffer corrupted at page %d", i / 4096);
+}
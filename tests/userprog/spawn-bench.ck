@@ -0,0 +1,39 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(spawn-bench) begin
+(child-simple) run
+child: exit(81)
+(child-simple) run
+child: exit(81)
+(child-simple) run
+child: exit(81)
+(child-simple) run
+child: exit(81)
+(spawn-bench) fork+exec ran 4 children
+(child-simple) run
+child-simple: exit(81)
+(child-simple) run
+child-simple: exit(81)
+(child-simple) run
+child-simple: exit(81)
+(child-simple) run
+child-simple: exit(81)
+(spawn-bench) spawn ran 4 children
+(spawn-bench) spawn was no more expensive than fork+exec
+(spawn-bench) open "sample.txt"
+(spawn-bench) spawn child-close with the file moved to fd 10
+(child-close) begin
+(child-close) verified contents of "sample.txt"
+(child-close) end
+child-close: exit(0)
+(spawn-bench) wait for child-close
+(spawn-bench) verified contents of "sample.txt"
+load: no-such-file: open failed
+(spawn-bench) spawn missing file
+(spawn-bench) end
+spawn-bench: exit(0)
+EOF
+pass;
@@ -0,0 +1,44 @@
+/* Writes the first half of a file-backed mapping into the second
+   half of the same file with write(), so the kernel reads the user
+   buffer from pages backed by the very inode it is writing.  The
+   buffer has to be pinned before the write takes the inode's locks,
+   otherwise faulting it in (or evicting one of its dirty pages) in
+   the middle of the write would need those locks again. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define HALF (16 * 4096)
+
+static char expected[2 * HALF];
+
+void
+test_main (void)
+{
+  char *map = (char *) 0x10000000;
+  int handle;
+  size_t i;
+
+  for (i = 0; i < HALF; i++)
+    expected[i] = expected[HALF + i] = 'a' + i % 23;
+
+  CHECK (create ("self", sizeof expected), "create \"self\"");
+  CHECK ((handle = open ("self")) > 1, "open \"self\"");
+  CHECK (mmap (map, sizeof expected, 1, handle, 0) != MAP_FAILED,
+         "mmap \"self\"");
+
+  /* Dirty the first half through the mapping only. */
+  memcpy (map, expected, HALF);
+
+  seek (handle, HALF);
+  CHECK (write (handle, map, HALF) == HALF, "write first half to second");
+  if (memcmp (map + HALF, expected + HALF, HALF))
+    fail ("second half of mapping differs");
+  msg ("second half of mapping matches");
+
+  munmap (map);
+  close (handle);
+  check_file ("self", expected, sizeof expected);
+}
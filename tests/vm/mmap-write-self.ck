@@ -0,0 +1,17 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(mmap-write-self) begin
+(mmap-write-self) create "self"
+(mmap-write-self) open "self"
+(mmap-write-self) mmap "self"
+(mmap-write-self) write first half to second
+(mmap-write-self) second half of mapping matches
+(mmap-write-self) open "self" for verification
+(mmap-write-self) verified contents of "self"
+(mmap-write-self) close "self"
+(mmap-write-self) end
+EOF
+pass;
@@ -0,0 +1,43 @@
+/* Sweeps a large zero-initialized array one byte per page, which
+   needs a fresh TLB entry for every page when it is mapped with
+   4 kB pages, and checks that each 2 MB-aligned part of it was
+   mapped as one physically contiguous huge page. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+#define HUGE_SIZE (2 * 1024 * 1024)
+#define HUGE_CNT 2
+#define PAGE_CNT (HUGE_CNT * HUGE_SIZE / PAGE_SIZE)
+#define PASSES 16
+
+static char buf[HUGE_CNT * HUGE_SIZE] __attribute__ ((aligned (HUGE_SIZE)));
+
+void
+test_main (void)
+{
+  size_t i, h;
+  int pass;
+
+  for (pass = 0; pass < PASSES; pass++)
+    for (i = 0; i < PAGE_CNT; i++)
+      buf[i * PAGE_SIZE]++;
+  for (i = 0; i < PAGE_CNT; i++)
+    if (buf[i * PAGE_SIZE] != PASSES)
+      fail ("byte %zu: %d != %d", i * PAGE_SIZE, buf[i * PAGE_SIZE], PASSES);
+  msg ("swept %d pages %d times", PAGE_CNT, PASSES);
+
+  for (h = 0; h < HUGE_CNT; h++)
+    {
+      char *base = buf + h * HUGE_SIZE;
+      char *pa = get_phys_addr (base);
+      bool huge = (unsigned long) pa % HUGE_SIZE == 0;
+
+      for (i = 1; huge && i < HUGE_SIZE / PAGE_SIZE; i++)
+        huge = get_phys_addr (base + i * PAGE_SIZE) == pa + i * PAGE_SIZE;
+      CHECK (huge, "check huge page %zu", h);
+    }
+}
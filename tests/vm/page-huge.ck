@@ -0,0 +1,12 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(page-huge) begin
+(page-huge) swept 1024 pages 16 times
+(page-huge) check huge page 0
+(page-huge) check huge page 1
+(page-huge) end
+EOF
+pass;
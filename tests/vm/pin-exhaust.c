@@ -0,0 +1,22 @@
+/* Reads from a file into a buffer larger than all of user memory.
+   The kernel pins the whole buffer before the read, so it runs out
+   of frames it can evict.  The process must be terminated with -1
+   exit code rather than hang the kernel. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define BUF_SIZE (16 * 1024 * 1024)
+
+static char buf[BUF_SIZE];
+
+void
+test_main (void)
+{
+  int handle;
+
+  CHECK ((handle = open ("sample.txt")) > 1, "open \"sample.txt\"");
+  read (handle, buf, sizeof buf);
+  fail ("survived pinning more memory than there is");
+}
@@ -0,0 +1,10 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(pin-exhaust) begin
+(pin-exhaust) open "sample.txt"
+pin-exhaust: exit(-1)
+EOF
+pass;
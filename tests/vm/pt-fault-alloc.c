@@ -0,0 +1,36 @@
+/* Touches pages of a lazily loaded segment one by one and checks
+   that each page fault costs only the allocations needed for the
+   new page itself, i.e. that looking pages up does not allocate. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+#define PAGE_CNT 64
+
+/* One struct page, one struct frame and one struct load_info. */
+#define ALLOCS_PER_FAULT 3
+
+static char buf[PAGE_CNT * PAGE_SIZE];
+
+void
+test_main (void)
+{
+  long long malloc_cnt;
+  size_t i;
+
+  malloc_cnt = get_kernel_malloc_cnt ();
+  for (i = 0; i < PAGE_CNT; i++)
+    buf[i * PAGE_SIZE] = i;
+  malloc_cnt = get_kernel_malloc_cnt () - malloc_cnt;
+
+  for (i = 0; i < PAGE_CNT; i++)
+    if (buf[i * PAGE_SIZE] != (char) i)
+      fail ("byte %zu: %d != %d", i * PAGE_SIZE, buf[i * PAGE_SIZE], (char) i);
+  msg ("touched %d pages", PAGE_CNT);
+
+  CHECK (malloc_cnt <= PAGE_CNT * ALLOCS_PER_FAULT,
+         "check allocations per fault");
+}
@@ -0,0 +1,11 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(pt-fault-alloc) begin
+(pt-fault-alloc) touched 64 pages
+(pt-fault-alloc) check allocations per fault
+(pt-fault-alloc) end
+EOF
+pass;
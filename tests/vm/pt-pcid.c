@@ -0,0 +1,55 @@
+/* Runs two processes that keep sweeping their own working sets
+   while the timer switches between them, then checks that with
+   PCIDs most of those switches kept the TLB instead of flushing
+   it.  The test is run on a CPU model with PCID and INVPCID, and
+   fails if the kernel did not turn PCIDs on. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+#define PAGE_CNT 32
+#define ROUNDS 20000
+
+static char buf[PAGE_CNT * PAGE_SIZE];
+
+static void
+sweep (char tag)
+{
+  int round;
+  size_t i;
+
+  for (round = 0; round < ROUNDS; round++)
+    for (i = 0; i < PAGE_CNT; i++)
+      buf[i * PAGE_SIZE] = tag;
+  for (i = 0; i < PAGE_CNT; i++)
+    if (buf[i * PAGE_SIZE] != tag)
+      fail ("page %zu of %c: %c", i, tag, buf[i * PAGE_SIZE]);
+}
+
+void
+test_main (void)
+{
+  long long loads, flushes;
+  pid_t child;
+
+  CHECK (get_pcid_enabled (), "PCIDs are enabled");
+
+  loads = get_cr3_load_cnt ();
+  flushes = get_tlb_flush_cnt ();
+
+  child = fork ("child");
+  if (child == 0)
+    {
+      sweep ('c');
+      exit (0x42);
+    }
+  sweep ('p');
+  CHECK (wait (child) == 0x42, "wait for child");
+
+  loads = get_cr3_load_cnt () - loads;
+  flushes = get_tlb_flush_cnt () - flushes;
+  CHECK (flushes * 2 < loads,
+         "check TLB flushes on address space switches");
+}
@@ -0,0 +1,12 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(pt-pcid) begin
+(pt-pcid) PCIDs are enabled
+(pt-pcid) wait for child
+(pt-pcid) check TLB flushes on address space switches
+(pt-pcid) end
+EOF
+pass;
@@ -0,0 +1,64 @@
+/* Executes a second copy of itself and checks that both copies
+   map their code, and their initialized data until it is written,
+   to the same frames.  Writing the data must give the writer a
+   private copy and leave the other copy alone. */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <syscall.h>
+#include "tests/lib.h"
+
+#define PAGE_SIZE 4096
+
+const char *test_name = "share-text";
+
+/* Fills a page of its own, so nothing else written by the program
+   shares it. */
+static volatile int data[PAGE_SIZE / sizeof (int)]
+  __attribute__ ((aligned (PAGE_SIZE))) = { 42 };
+
+/* Returns the number of the frame that maps VA. */
+static int
+frame_of (const volatile void *va)
+{
+  return (uintptr_t) get_phys_addr ((void *) va) / PAGE_SIZE;
+}
+
+int main (int argc, char *argv[]);
+
+/* The second copy, given the parent's frames. */
+static int
+second_copy (int text_frame, int data_frame)
+{
+  CHECK (data[0] == 42, "second copy reads initialized data");
+  CHECK (frame_of (main) == text_frame, "code is shared");
+  CHECK (frame_of (data) == data_frame, "unwritten data is shared");
+  data[0] = 7;
+  CHECK (frame_of (data) != data_frame, "written data is private");
+  return 0;
+}
+
+int
+main (int argc, char *argv[])
+{
+  char child_cmd[64];
+  pid_t pid;
+  int data_frame;
+
+  if (argc == 3)
+    return second_copy (atoi (argv[1]), atoi (argv[2]));
+
+  msg ("begin");
+  CHECK (data[0] == 42, "read initialized data");
+  data_frame = frame_of (data);
+  snprintf (child_cmd, sizeof child_cmd, "share-text %d %d",
+            frame_of (main), data_frame);
+  if (!(pid = fork ("share-text")))
+    exec (child_cmd);
+  CHECK (wait (pid) == 0, "wait for second copy");
+  CHECK (data[0] == 42 && frame_of (data) == data_frame,
+         "data unchanged after second copy wrote it");
+  msg ("end");
+  return 0;
+}
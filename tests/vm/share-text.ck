@@ -0,0 +1,16 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(share-text) begin
+(share-text) read initialized data
+(share-text) second copy reads initialized data
+(share-text) code is shared
+(share-text) unwritten data is shared
+(share-text) written data is private
+(share-text) wait for second copy
+(share-text) data unchanged after second copy wrote it
+(share-text) end
+EOF
+pass;
@@ -100,6 +100,11 @@ main (void) {
 #ifdef USERPROG
 	exception_init ();
 	syscall_init ();
+	exec_cache_init ();
+	register_malloc_inspect_intr ();
+	register_tlb_inspect_intr ();
+	register_syscall_inspect_intr ();
+	register_palloc_inspect_intr ();
 #endif
 	/* Start thread scheduler and enable interrupts. */
 	thread_start ();
@@ -155,6 +160,18 @@ paging_init (uint64_t mem_end) {
 	for (uint64_t pa = 0; pa < mem_end; pa += PGSIZE) {
 		uint64_t va = (uint64_t) ptov(pa);
 
+		// Whole 2 MiB chunks past the legacy first chunk that hold no
+		// kernel text are mapped by one writable PDE, which saves page
+		// tables and TLB entries for the whole direct map.
+		if (pa != 0 && pa % HUGE_PGSIZE == 0 && pa + HUGE_PGSIZE <= mem_end
+				&& (va + HUGE_PGSIZE <= (uint64_t) &start
+					|| va >= (uint64_t) &_end_kernel_text)) {
+			if ((pte = pml4e_walk_pde (pml4, va, 1)) != NULL)
+				*pte = pa | PTE_P | PTE_W | PTE_PS;
+			pa += HUGE_PGSIZE - PGSIZE;
+			continue;
+		}
+
 		perm = PTE_P | PTE_W;
 		if ((uint64_t) &start <= va && va < (uint64_t) &_end_kernel_text)
 			perm &= ~PTE_W;
@@ -165,6 +182,7 @@ paging_init (uint64_t mem_end) {
 
 	// reload cr3
 	pml4_activate(0);
+	pcid_init ();
 }
 
 /* Breaks the kernel command line into words and returns them as
@@ -268,6 +286,7 @@ run_actions (char **argv) {
 		{"run", 2, run_task},
 #ifdef FILESYS
 		{"ls", 1, fsutil_ls},
+		{"frag", 1, fsutil_frag},
 		{"cat", 2, fsutil_cat},
 		{"rm", 2, fsutil_rm},
 		{"put", 2, fsutil_put},
@@ -314,6 +333,7 @@ usage (void) {
 #endif
 #ifdef FILESYS
 			"  ls                 List files in the root directory.\n"
+			"  frag               Report fragmentation of files and free space.\n"
 			"  cat FILE           Print FILE to the console.\n"
 			"  rm FILE            Delete FILE.\n"
 			"Use these actions indirectly via `pintos' -g and -p options:\n"
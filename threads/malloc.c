@@ -5,6 +5,7 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
+#include "threads/interrupt.h"
 #include "threads/palloc.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
@@ -61,6 +62,9 @@ struct block {
 static struct desc descs[10];   /* Descriptors. */
 static size_t desc_cnt;         /* Number of descriptors. */
 
+/* Number of malloc() calls so far, read by tests via int 0x45. */
+static long long malloc_cnt;
+
 static struct arena *block_to_arena (struct block *);
 static struct block *arena_to_block (struct arena *, size_t idx);
 
@@ -90,6 +94,9 @@ malloc (size_t size) {
 	/* A null pointer satisfies a request for 0 bytes. */
 	if (size == 0)
 		return NULL;
+	/* Counted atomically, since no lock is held yet and large
+	   requests never take one. */
+	__atomic_add_fetch (&malloc_cnt, 1, __ATOMIC_RELAXED);
 
 	/* Find the smallest descriptor that satisfies a SIZE-byte
 	   request. */
@@ -266,3 +273,17 @@ arena_to_block (struct arena *a, size_t idx) {
 			+ sizeof *a
 			+ idx * a->desc->block_size);
 }
+
+static void
+inspect_malloc_cnt (struct intr_frame *f) {
+	f->R.rax = malloc_cnt;
+}
+
+/* Tool for testing kernel allocations. Calling this function via int 0x45.
+ * Output:
+ *   @RAX - Number of malloc() calls since boot. */
+void
+register_malloc_inspect_intr (void) {
+	intr_register_int (0x45, 3, INTR_OFF, inspect_malloc_cnt,
+			"Inspect Malloc Count");
+}
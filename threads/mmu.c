@@ -6,12 +6,109 @@
 #include "threads/palloc.h"
 #include "threads/thread.h"
 #include "threads/mmu.h"
+#include "threads/interrupt.h"
 #include "intrinsic.h"
+#include <bitmap.h>
+
+/* Process-context identifiers (PCIDs).
+
+   With CR4.PCIDE set, TLB entries are tagged with the PCID held
+   in the low 12 bits of CR3, and a CR3 load with CR3_NOFLUSH set
+   keeps them, so switching between processes need not flush the
+   TLB.  Each pml4 gets its own PCID, which is kept in PML4 entry
+   PCID_SLOT: that entry is never present, so the CPU ignores the
+   rest of its bits.  PCID 0 belongs to base_pml4, which only has
+   the kernel mappings that never change, and to any pml4 created
+   after the PCIDs ran out, which is flushed on every switch.
+
+   A PTE changed while its pml4 is not active must not live on in
+   that pml4's TLB entries.  tlb_invalidate() drops the entry with
+   INVPCID when the CPU has it and otherwise marks the pml4
+   PCID_STALE, which makes its next activation flush. */
+#define PCID_SLOT 511                 /* PML4 entry holding the PCID. */
+#define PCID_STALE 0x2                /* Flush on next activation. */
+#define PCID_CNT 4096                 /* Number of PCIDs. */
+#define CR3_NOFLUSH (1ULL << 63)      /* Keep TLB entries of the PCID. */
+#define CR4_PCIDE (1 << 17)           /* CR4 bit enabling PCIDs. */
+#define CPUID_1_ECX_PCID (1 << 17)    /* CPU supports PCIDs. */
+#define CPUID_7_EBX_INVPCID (1 << 10) /* CPU supports INVPCID. */
+#define INVPCID_ADDR 0                /* Invalidate one address. */
+
+static bool pcid_enabled;
+static bool invpcid_enabled;
+static struct bitmap *pcid_map;       /* PCIDs in use. */
+
+/* Statistics. */
+static long long cr3_load_cnt;        /* Address space activations. */
+static long long tlb_flush_cnt;       /* Activations that flushed. */
+
+static unsigned pcid_alloc (void);
+static void pcid_free (unsigned pcid);
+static unsigned pml4_pcid (uint64_t *pml4);
+static void tlb_invalidate (uint64_t *pml4, const void *va);
+
+/* Pages set aside for splitting huge pages, chained through their
+ * first word.  pml4_set_huge_page() puts one page here for each
+ * huge mapping it installs, and splitting or destroying the mapping
+ * takes it back out, so a split never has to allocate.  Splits
+ * happen when a page is evicted or unmapped, which is exactly when
+ * memory is short. */
+static void *split_reserve;
+
+/* Adds a page to split_reserve.  Returns false if none is free. */
+static bool
+split_reserve_add (void) {
+	void *page = palloc_get_page (0);
+	enum intr_level old_level;
+
+	if (page == NULL)
+		return false;
+	old_level = intr_disable ();
+	*(void **) page = split_reserve;
+	split_reserve = page;
+	intr_set_level (old_level);
+	return true;
+}
+
+/* Removes a page from split_reserve and returns it. */
+static void *
+split_reserve_take (void) {
+	enum intr_level old_level = intr_disable ();
+	void *page = split_reserve;
+
+	ASSERT (page != NULL);
+	split_reserve = *(void **) page;
+	intr_set_level (old_level);
+	return page;
+}
+
+/* Replaces the 2 MiB mapping in *PDE by a page table of 512
+ * PTEs that map the same frames with the same flags.  The
+ * translations do not change, so no TLB flush is needed here.
+ * The page table comes from split_reserve, so this cannot fail. */
+static void
+pde_split (uint64_t *pde) {
+	uint64_t *pt = split_reserve_take ();
+
+	uint64_t pa = PTE_ADDR (*pde);
+	uint64_t flags = *pde & PTE_FLAGS & ~PTE_PS;
+	for (unsigned i = 0; i < HUGE_PGCNT; i++)
+		pt[i] = (pa + i * PGSIZE) | flags;
+	*pde = vtop (pt) | PTE_U | PTE_W | PTE_P;
+}
 
 static uint64_t *
 pgdir_walk (uint64_t *pdp, const uint64_t va, int create) {
 	int idx = PDX (va);
 	if (pdp) {
+		if (pdp[idx] & PTE_PS) {
+			/* A huge page has no page table.  Lookups get the PDE,
+			 * whose A and D bits sit where a PTE's do; CREATE splits
+			 * it so that VA gets an entry of its own. */
+			if (!create)
+				return &pdp[idx];
+			pde_split (&pdp[idx]);
+		}
 		uint64_t *pte = (uint64_t *) pdp[idx];
 		if (!((uint64_t) pte & PTE_P)) {
 			if (create) {
@@ -88,6 +185,29 @@ pml4e_walk (uint64_t *pml4e, const uint64_t va, int create) {
 	return pte;
 }
 
+/* Returns the address of the page directory entry for virtual
+ * address VA in page map level 4, PML4E, creating the upper
+ * levels if CREATE is true.  Unlike pml4e_walk(), the PDE is
+ * returned as is, so it may map a huge page or nothing at all. */
+uint64_t *
+pml4e_walk_pde (uint64_t *pml4e, const uint64_t va, int create) {
+	uint64_t *table = pml4e;
+
+	for (uint64_t shift = PML4SHIFT; shift > PDXSHIFT; shift -= 9) {
+		uint64_t *entry = &table[(va >> shift) & 0x1FF];
+		if (!(*entry & PTE_P)) {
+			if (!create)
+				return NULL;
+			uint64_t *new_page = palloc_get_page (PAL_ZERO);
+			if (new_page == NULL)
+				return NULL;
+			*entry = vtop (new_page) | PTE_U | PTE_W | PTE_P;
+		}
+		table = ptov (PTE_ADDR (*entry));
+	}
+	return &table[PDX (va)];
+}
+
 /* Creates a new page map level 4 (pml4) has mappings for kernel
  * virtual addresses, but none for user virtual addresses.
  * Returns the new page directory, or a null pointer if memory
@@ -95,8 +215,11 @@ pml4e_walk (uint64_t *pml4e, const uint64_t va, int create) {
 uint64_t *
 pml4_create (void) {
 	uint64_t *pml4 = palloc_get_page (0);
-	if (pml4)
+	if (pml4) {
 		memcpy (pml4, base_pml4, PGSIZE);
+		/* The PCID's previous owner may still have TLB entries. */
+		pml4[PCID_SLOT] = ((uint64_t) pcid_alloc () << PTXSHIFT) | PCID_STALE;
+	}
 	return pml4;
 }
 
@@ -122,7 +245,14 @@ pgdir_for_each (uint64_t *pdp, pte_for_each_func *func, void *aux,
 		unsigned pml4_index, unsigned pdp_index) {
 	for (unsigned i = 0; i < PGSIZE / sizeof(uint64_t *); i++) {
 		uint64_t *pte = ptov((uint64_t *) pdp[i]);
-		if (((uint64_t) pte) & PTE_P)
+		if ((((uint64_t) pte) & PTE_P) && (pdp[i] & PTE_PS)) {
+			/* FUNC sees a huge page once, through its PDE. */
+			void *va = (void *) (((uint64_t) pml4_index << PML4SHIFT) |
+								 ((uint64_t) pdp_index << PDPESHIFT) |
+								 ((uint64_t) i << PDXSHIFT));
+			if (!func (&pdp[i], va, aux))
+				return false;
+		} else if (((uint64_t) pte) & PTE_P)
 			if (!pt_for_each ((uint64_t *) PTE_ADDR (pte), func, aux,
 					pml4_index, pdp_index, i))
 				return false;
@@ -169,7 +299,10 @@ static void
 pgdir_destroy (uint64_t *pdp) {
 	for (unsigned i = 0; i < PGSIZE / sizeof(uint64_t *); i++) {
 		uint64_t *pte = ptov((uint64_t *) pdp[i]);
-		if (((uint64_t) pte) & PTE_P)
+		if ((((uint64_t) pte) & PTE_P) && (pdp[i] & PTE_PS)) {
+			palloc_free_multiple ((void *) PTE_ADDR (pte), HUGE_PGCNT);
+			palloc_free_page (split_reserve_take ());
+		} else if (((uint64_t) pte) & PTE_P)
 			pt_destroy (PTE_ADDR (pte));
 	}
 	palloc_free_page ((void *) pdp);
@@ -196,14 +329,35 @@ pml4_destroy (uint64_t *pml4) {
 	uint64_t *pdpe = ptov ((uint64_t *) pml4[0]);
 	if (((uint64_t) pdpe) & PTE_P)
 		pdpe_destroy ((void *) PTE_ADDR (pdpe));
+	pcid_free (pml4_pcid (pml4));
 	palloc_free_page ((void *) pml4);
 }
 
 /* Loads page directory PD into the CPU's page directory base
- * register. */
+ * register.  With PCIDs, the TLB entries of PD survive unless PD
+ * went stale while it was inactive. */
 void
 pml4_activate (uint64_t *pml4) {
-	lcr3 (vtop (pml4 ? pml4 : base_pml4));
+	uint64_t cr3;
+
+	if (pml4 == NULL)
+		pml4 = base_pml4;
+	cr3 = vtop (pml4);
+	cr3_load_cnt++;
+
+	if (pcid_enabled) {
+		unsigned pcid = pml4_pcid (pml4);
+		if (pml4 == base_pml4
+				|| (pcid != 0 && !(pml4[PCID_SLOT] & PCID_STALE)))
+			cr3 |= CR3_NOFLUSH;
+		else
+			tlb_flush_cnt++;
+		if (pml4 != base_pml4)
+			pml4[PCID_SLOT] &= ~PCID_STALE;
+		cr3 |= pcid;
+	} else
+		tlb_flush_cnt++;
+	lcr3 (cr3);
 }
 
 /* Looks up the physical address that corresponds to user virtual
@@ -216,6 +370,8 @@ pml4_get_page (uint64_t *pml4, const void *uaddr) {
 
 	uint64_t *pte = pml4e_walk (pml4, (uint64_t) uaddr, 0);
 
+	if (pte && (*pte & PTE_P) && (*pte & PTE_PS))
+		return ptov (PTE_ADDR (*pte)) + ((uint64_t) uaddr & (HUGE_PGSIZE - 1));
 	if (pte && (*pte & PTE_P))
 		return ptov (PTE_ADDR (*pte)) + pg_ofs (uaddr);
 	return NULL;
@@ -243,6 +399,29 @@ pml4_set_page (uint64_t *pml4, void *upage, void *kpage, bool rw) {
 	return pte != NULL;
 }
 
+/* Maps the HUGE_PGSIZE bytes of user virtual memory at UPAGE to
+ * the physically contiguous frames at kernel virtual address KPAGE
+ * with a single PDE.  Both addresses must be HUGE_PGSIZE aligned.
+ * If WRITABLE is true, the new pages are read/write; otherwise
+ * they are read-only.
+ * Returns false if memory allocation fails or if part of the
+ * region is already covered by a page table.  A page is reserved
+ * for splitting the mapping later, see split_reserve. */
+bool
+pml4_set_huge_page (uint64_t *pml4, void *upage, void *kpage, bool rw) {
+	ASSERT ((uint64_t) upage % HUGE_PGSIZE == 0);
+	ASSERT ((uint64_t) kpage % HUGE_PGSIZE == 0);
+	ASSERT (is_user_vaddr (upage));
+	ASSERT (pml4 != base_pml4);
+
+	uint64_t *pde = pml4e_walk_pde (pml4, (uint64_t) upage, 1);
+
+	if (pde == NULL || (*pde & PTE_P) || !split_reserve_add ())
+		return false;
+	*pde = vtop (kpage) | PTE_P | PTE_PS | (rw ? PTE_W : 0) | PTE_U;
+	return true;
+}
+
 /* Marks user virtual page UPAGE "not present" in page
  * directory PD.  Later accesses to the page will fault.  Other
  * bits in the page table entry are preserved.
@@ -254,11 +433,16 @@ pml4_clear_page (uint64_t *pml4, void *upage) {
 	ASSERT (is_user_vaddr (upage));
 
 	pte = pml4e_walk (pml4, (uint64_t) upage, false);
+	if (pte != NULL && (*pte & PTE_PS) != 0) {
+		/* Only UPAGE goes away, so the huge page must be split.
+		 * The page table for that is already reserved. */
+		pte = pml4e_walk (pml4, (uint64_t) upage, true);
+		ASSERT (pte != NULL);
+	}
 
 	if (pte != NULL && (*pte & PTE_P) != 0) {
 		*pte &= ~PTE_P;
-		if (rcr3 () == vtop (pml4))
-			invlpg ((uint64_t) upage);
+		tlb_invalidate (pml4, upage);
 	}
 }
 
@@ -283,8 +467,7 @@ pml4_set_dirty (uint64_t *pml4, const void *vpage, bool dirty) {
 		else
 			*pte &= ~(uint32_t) PTE_D;
 
-		if (rcr3 () == vtop (pml4))
-			invlpg ((uint64_t) vpage);
+		tlb_invalidate (pml4, vpage);
 	}
 }
 
@@ -309,7 +492,104 @@ pml4_set_accessed (uint64_t *pml4, const void *vpage, bool accessed) {
 		else
 			*pte &= ~(uint32_t) PTE_A;
 
-		if (rcr3 () == vtop (pml4))
-			invlpg ((uint64_t) vpage);
+		tlb_invalidate (pml4, vpage);
+	}
+}
+
+/* Makes sure that no TLB entry for VA in PML4 outlives a change
+ * to its PTE. */
+static void
+tlb_invalidate (uint64_t *pml4, const void *va) {
+	if (PTE_ADDR (rcr3 ()) == vtop (pml4))
+		invlpg ((uint64_t) va);
+	else if (pcid_enabled) {
+		/* PML4's entries were kept when it was switched out. */
+		unsigned pcid = pml4_pcid (pml4);
+		if (invpcid_enabled && pcid != 0)
+			invpcid (INVPCID_ADDR, pcid, (uint64_t) va);
+		else
+			pml4[PCID_SLOT] |= PCID_STALE;
+	}
+}
+
+/* Returns the PCID of PML4. */
+static unsigned
+pml4_pcid (uint64_t *pml4) {
+	if (pml4 == base_pml4)
+		return 0;
+	return (pml4[PCID_SLOT] >> PTXSHIFT) & (PCID_CNT - 1);
+}
+
+/* Returns a free PCID, or 0 if there is none. */
+static unsigned
+pcid_alloc (void) {
+	size_t pcid = 0;
+
+	if (pcid_enabled) {
+		enum intr_level old_level = intr_disable ();
+		pcid = bitmap_scan_and_flip (pcid_map, 1, 1, false);
+		intr_set_level (old_level);
+		if (pcid == BITMAP_ERROR)
+			pcid = 0;
 	}
+	return pcid;
+}
+
+/* Releases PCID, which came from pcid_alloc(). */
+static void
+pcid_free (unsigned pcid) {
+	if (pcid != 0)
+		bitmap_reset (pcid_map, pcid);
+}
+
+/* Turns on PCIDs if the CPU supports them.  Must be called
+ * while base_pml4 is active with PCID 0. */
+void
+pcid_init (void) {
+	uint32_t eax, ebx, ecx, edx;
+
+	cpuid (1, 0, &eax, &ebx, &ecx, &edx);
+	if (!(ecx & CPUID_1_ECX_PCID))
+		return;
+
+	pcid_map = bitmap_create (PCID_CNT);
+	if (pcid_map == NULL)
+		return;
+	bitmap_mark (pcid_map, 0);
+
+	cpuid (0, 0, &eax, &ebx, &ecx, &edx);
+	if (eax >= 7) {
+		cpuid (7, 0, &eax, &ebx, &ecx, &edx);
+		invpcid_enabled = (ebx & CPUID_7_EBX_INVPCID) != 0;
+	}
+
+	lcr4 (rcr4 () | CR4_PCIDE);
+	pcid_enabled = true;
+}
+
+static void
+inspect_tlb (struct intr_frame *f) {
+	switch (f->R.rdx) {
+		case 0:
+			f->R.rax = cr3_load_cnt;
+			break;
+		case 1:
+			f->R.rax = tlb_flush_cnt;
+			break;
+		default:
+			f->R.rax = pcid_enabled;
+			break;
+	}
+}
+
+/* Tool for testing address space switches. Calling this function via int 0x46.
+ * Input:
+ *   @RDX - 0 for the number of address space activations,
+ *          1 for the number of those that flushed the TLB,
+ *          2 for whether PCIDs are in use
+ * Output:
+ *   @RAX - Requested value. */
+void
+register_tlb_inspect_intr (void) {
+	intr_register_int (0x46, 3, INTR_OFF, inspect_tlb, "Inspect TLB");
 }
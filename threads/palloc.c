@@ -8,7 +8,9 @@
 #include <stdio.h>
 #include <string.h>
 #include "threads/init.h"
+#include "threads/interrupt.h"
 #include "threads/loader.h"
+#include "threads/pte.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
 
@@ -296,6 +298,38 @@ palloc_get_page (enum palloc_flags flags) {
 	return palloc_get_multiple (flags, 1);
 }
 
+/* Obtains HUGE_PGCNT contiguous free pages starting at a multiple
+   of HUGE_PGSIZE, so that they can be mapped by a single page
+   directory entry, and returns their kernel virtual address.
+   FLAGS are interpreted as in palloc_get_multiple().  The pages
+   may be freed all at once or one by one. */
+void *
+palloc_get_huge_page (enum palloc_flags flags) {
+	struct pool *pool = flags & PAL_USER ? &user_pool : &kernel_pool;
+	size_t page_cnt = bitmap_size (pool->used_map);
+	size_t page_idx = (HUGE_PGCNT - pg_no (pool->base) % HUGE_PGCNT) % HUGE_PGCNT;
+	void *pages = NULL;
+
+	lock_acquire (&pool->lock);
+	for (; page_idx + HUGE_PGCNT <= page_cnt; page_idx += HUGE_PGCNT)
+		if (bitmap_none (pool->used_map, page_idx, HUGE_PGCNT)) {
+			bitmap_set_multiple (pool->used_map, page_idx, HUGE_PGCNT, true);
+			pages = pool->base + PGSIZE * page_idx;
+			break;
+		}
+	lock_release (&pool->lock);
+
+	if (pages) {
+		if (flags & PAL_ZERO)
+			memset (pages, 0, HUGE_PGSIZE);
+	} else {
+		if (flags & PAL_ASSERT)
+			PANIC ("palloc_get: out of huge pages");
+	}
+
+	return pages;
+}
+
 /* Frees the PAGE_CNT pages starting at PAGES. */
 void
 palloc_free_multiple (void *pages, size_t page_cnt) {
@@ -328,6 +362,23 @@ palloc_free_page (void *page) {
 	palloc_free_multiple (page, 1);
 }
 
+static void
+inspect_used_page_cnt (struct intr_frame *f) {
+	f->R.rax = bitmap_count (kernel_pool.used_map, 0,
+			bitmap_size (kernel_pool.used_map), true)
+		+ bitmap_count (user_pool.used_map, 0,
+			bitmap_size (user_pool.used_map), true);
+}
+
+/* Tool for testing memory leaks. Calling this function via int 0x48.
+ * Output:
+ *   @RAX - Number of pages in use in both pools. */
+void
+register_palloc_inspect_intr (void) {
+	intr_register_int (0x48, 3, INTR_OFF, inspect_used_page_cnt,
+			"Inspect Used Page Count");
+}
+
 /* Initializes pool P as starting at START and ending at END */
 static void
 init_pool (struct pool *p, void **bm_base, uint64_t start, uint64_t end) {
@@ -7,6 +7,7 @@
 #include "threads/flags.h"
 #include "threads/interrupt.h"
 #include "threads/intr-stubs.h"
+#include "threads/malloc.h"
 #include "threads/palloc.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
@@ -224,23 +225,18 @@ thread_create (const char *name, int priority,
 	t->tf.cs = SEL_KCSEG;
 	t->tf.eflags = FLAG_IF;
 
-	t->fdt = palloc_get_multiple(PAL_ZERO, FDT_PAGES);
-	if(t->fdt == NULL){
-		return TID_ERROR;
-	}
-#ifndef VM
-	t->fdt_dup= palloc_get_multiple(PAL_ZERO, FDT_PAGES);
-	if(t->fdt_dup == NULL){
+#ifdef USERPROG
+	t->exit_info = malloc (sizeof *t->exit_info);
+	if (t->exit_info == NULL) {
+		palloc_free_page (t);
 		return TID_ERROR;
 	}
-#endif
-	list_push_back(&thread_current()->child_list,&t->child_elem);
-	sema_init(&t->exit_sema,0);
-	t->next_fd = 2;
-	t->fdt[0] = STDIN_FILENO;
-	t->fdt[1] = STDOUT_FILENO;
-#ifndef VM
-	t->next_dup = 2;
+	t->exit_info->tid = tid;
+	t->exit_info->status = 0;
+	t->exit_info->ref_cnt = 2;
+	sema_init (&t->exit_info->loaded, 0);
+	sema_init (&t->exit_info->exited, 0);
+	list_push_back (&thread_current ()->child_list, &t->exit_info->elem);
 #endif
 	
 	/* Add to run queue. */
@@ -650,10 +646,10 @@ init_thread (struct thread *t, const char *name, int priority) {
 	t-> nice = 0;
 	t->recent_cpu = 0;
 	t->exit_status = 0;
-	t->next_fd = 2;
+#ifdef USERPROG
+	fd_table_init (&t->fdt);
+#endif
 	list_init(&t->child_list);
-	sema_init(&t->child_wait_sema,0);
-	sema_init(&t->dupl_sema,0);
 }
 
 /* Chooses and returns the next thread to be scheduled.  Should
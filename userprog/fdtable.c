@@ -0,0 +1,195 @@
+/* fdtable.c: Per-process file descriptor tables. */
+
+#include "userprog/fdtable.h"
+#include <debug.h>
+#include <string.h>
+#include "filesys/file.h"
+#include "threads/malloc.h"
+
+/* Bits per bitmap word. */
+#define WORD_BITS 64
+
+/* Descriptors below this are reserved for the console. */
+#define FD_FIRST 2
+
+static bool fd_table_grow (struct fd_table *, int min_cap);
+static int next_used (const struct fd_table *, int fd);
+
+static inline bool
+slot_used (const struct fd_table *t, int fd) {
+	return (t->used[fd / WORD_BITS] >> (fd % WORD_BITS)) & 1;
+}
+
+static inline void
+set_slot (struct fd_table *t, int fd, struct file *file) {
+	t->files[fd] = file;
+	if (file != NULL)
+		t->used[fd / WORD_BITS] |= (uint64_t) 1 << (fd % WORD_BITS);
+	else
+		t->used[fd / WORD_BITS] &= ~((uint64_t) 1 << (fd % WORD_BITS));
+}
+
+/* Initializes T as an empty table.  Slots are allocated on first
+ * use, so threads that never open a file cost nothing. */
+void
+fd_table_init (struct fd_table *t) {
+	t->files = NULL;
+	t->used = NULL;
+	t->cap = 0;
+}
+
+/* Makes DST, an empty table, hold a copy of every open file of SRC,
+ * as fork() does.  The copies have their own positions, but
+ * descriptors that share an open file in SRC share one in DST too.
+ * Returns false if memory allocation fails, leaving in DST what was
+ * copied so far. */
+bool
+fd_table_copy (struct fd_table *dst, const struct fd_table *src) {
+	int fd;
+
+	ASSERT (dst->cap == 0);
+	if (src->cap == 0)
+		return true;
+	if (!fd_table_grow (dst, src->cap))
+		return false;
+
+	for (fd = next_used (src, FD_FIRST); fd < src->cap;
+			fd = next_used (src, fd + 1)) {
+		struct file *file = src->files[fd];
+		struct file *copy = NULL;
+
+		/* A shared open file was copied at its first descriptor. */
+		if (file_ref_cnt (file) > 1) {
+			int prev;
+			for (prev = next_used (src, FD_FIRST); prev < fd;
+					prev = next_used (src, prev + 1))
+				if (src->files[prev] == file) {
+					copy = file_ref (dst->files[prev]);
+					break;
+				}
+		}
+		if (copy == NULL)
+			copy = file_duplicate (file);
+		if (copy == NULL)
+			return false;
+		set_slot (dst, fd, copy);
+	}
+	return true;
+}
+
+/* Closes every descriptor of T and frees the table. */
+void
+fd_table_destroy (struct fd_table *t) {
+	int fd;
+
+	for (fd = next_used (t, FD_FIRST); fd < t->cap; fd = next_used (t, fd + 1))
+		file_close (t->files[fd]);
+	free (t->files);
+	free (t->used);
+	fd_table_init (t);
+}
+
+/* Installs FILE at the lowest free descriptor of T and returns the
+ * descriptor, or -1 if T is full.  The table takes over the
+ * caller's reference to FILE. */
+int
+fd_install (struct fd_table *t, struct file *file) {
+	int w;
+
+	ASSERT (file != NULL);
+	for (w = 0; w < t->cap / WORD_BITS; w++)
+		if (~t->used[w] != 0)
+			break;
+	if (w == t->cap / WORD_BITS && !fd_table_grow (t, t->cap + 1))
+		return -1;
+
+	int fd = w * WORD_BITS + __builtin_ctzll (~t->used[w]);
+	set_slot (t, fd, file);
+	return fd;
+}
+
+/* Returns the open file of descriptor FD of T, or NULL if FD is not
+ * an open file. */
+struct file *
+fd_lookup (const struct fd_table *t, int fd) {
+	if (fd < FD_FIRST || fd >= t->cap)
+		return NULL;
+	return t->files[fd];
+}
+
+/* Closes descriptor FD of T.  Returns false if it was not open. */
+bool
+fd_close (struct fd_table *t, int fd) {
+	struct file *file = fd_lookup (t, fd);
+
+	if (file == NULL)
+		return false;
+	set_slot (t, fd, NULL);
+	file_close (file);
+	return true;
+}
+
+/* Makes NEWFD of T refer to the open file of OLDFD, closing what
+ * NEWFD referred to first.  Returns NEWFD, or -1 if OLDFD is not
+ * open, NEWFD is out of range or memory allocation fails. */
+int
+fd_dup2 (struct fd_table *t, int oldfd, int newfd) {
+	struct file *file = fd_lookup (t, oldfd);
+
+	if (file == NULL || newfd < FD_FIRST || newfd >= FDT_CNT_LIMIT)
+		return -1;
+	if (oldfd == newfd)
+		return newfd;
+	if (newfd >= t->cap && !fd_table_grow (t, newfd + 1))
+		return -1;
+
+	fd_close (t, newfd);
+	set_slot (t, newfd, file_ref (file));
+	return newfd;
+}
+
+/* Grows T to at least MIN_CAP slots, doubling.  Returns false if
+ * that exceeds FDT_CNT_LIMIT or memory allocation fails. */
+static bool
+fd_table_grow (struct fd_table *t, int min_cap) {
+	int cap = t->cap != 0 ? t->cap : WORD_BITS;
+
+	while (cap < min_cap)
+		cap *= 2;
+	if (cap > FDT_CNT_LIMIT)
+		return false;
+	if (cap == t->cap)
+		return true;
+
+	struct file **files = calloc (cap, sizeof *files);
+	uint64_t *used = calloc (cap / WORD_BITS, sizeof *used);
+	if (files == NULL || used == NULL) {
+		free (files);
+		free (used);
+		return false;
+	}
+	if (t->cap != 0) {
+		memcpy (files, t->files, t->cap * sizeof *files);
+		memcpy (used, t->used, t->cap / WORD_BITS * sizeof *used);
+	} else
+		used[0] = (1 << FD_FIRST) - 1;
+	free (t->files);
+	free (t->used);
+	t->files = files;
+	t->used = used;
+	t->cap = cap;
+	return true;
+}
+
+/* Returns the first open descriptor of T at or after FD, or T's
+ * capacity if there is none. */
+static int
+next_used (const struct fd_table *t, int fd) {
+	while (fd < t->cap) {
+		uint64_t word = t->used[fd / WORD_BITS] >> (fd % WORD_BITS);
+		if (word != 0)
+			return fd + __builtin_ctzll (word);
+		fd = (fd / WORD_BITS + 1) * WORD_BITS;
+	}
+	return t->cap;
+}
@@ -20,15 +20,20 @@
 #include "intrinsic.h"
 #include "userprog/syscall.h"
 #include "lib/kernel/hash.h"
+#include "filesys/inode.h"
+#include "threads/malloc.h"
 #ifdef VM
 #include "vm/vm.h"
 #endif
 
 static void process_cleanup (void);
 static bool load (const char *file_name, struct intr_frame *if_);
+static bool process_load (char *f_name, struct intr_frame *if_);
 static void initd (void *f_name);
 static void __do_fork (void *);
-struct thread *process_get_child(tid_t child_tid);
+static void spawn_start (void *aux);
+struct exit_info *process_get_child(tid_t child_tid);
+static void exit_info_put (struct exit_info *);
 
 static void start_process (void* file_name_);
 static void parsing_file_input(char *f_name, struct intr_frame *if_);
@@ -98,23 +103,122 @@ process_fork (const char *name, struct intr_frame *if_ UNUSED) {
 		return TID_ERROR;
 	}
 
-	struct thread *child = process_get_child(pid);
-	sema_down(&child->dupl_sema); //자식을 찾은 경우 fork task thread가 끝날때까지 wait
-	if(child->exit_status == TID_ERROR){
-		sema_up(&child->exit_sema);
+	struct exit_info *child = process_get_child(pid);
+	sema_down(&child->loaded); //자식을 찾은 경우 fork task thread가 끝날때까지 wait
+	if(child->status == TID_ERROR){
+		list_remove(&child->elem);
+		exit_info_put(child);
 		return TID_ERROR;
 	}
 	return pid;
 }
 
-struct thread *process_get_child(tid_t child_tid){
+/* Arguments passed from process_spawn() to spawn_start(). */
+struct spawn_args {
+	struct thread *parent;
+	char *cmd_line;                         /* Page owned by the child. */
+	const struct spawn_action *actions;
+	int action_cnt;
+	bool success;                           /* Set by the child. */
+};
+
+/* Starts the program in the command line CMD_LINE as a new child
+ * process, with the descriptor ACTIONS applied to the child.  Unlike
+ * fork() followed by exec(), nothing of the caller's address space
+ * is copied: the child loads the executable into an empty one.
+ * CMD_LINE is a page from palloc_get_page() and is always freed.
+ * Returns the new process's thread id, or TID_ERROR if the thread
+ * cannot be created or the program cannot be loaded. */
+tid_t
+process_spawn (char *cmd_line, const struct spawn_action *actions,
+		int action_cnt) {
+	struct spawn_args args = {
+		.parent = thread_current (),
+		.cmd_line = cmd_line,
+		.actions = actions,
+		.action_cnt = action_cnt,
+		.success = false,
+	};
+	char name[sizeof args.parent->name];
+
+	strlcpy (name, cmd_line, sizeof name);
+	name[strcspn (name, " ")] = '\0';
+	tid_t pid = thread_create (name, PRI_DEFAULT, spawn_start, &args);
+	if (pid == TID_ERROR){
+		palloc_free_page (cmd_line);
+		return TID_ERROR;
+	}
+
+	/* ARGS lives on our stack, so wait until the child is done with
+	 * it.  The child reports whether the load succeeded. */
+	struct exit_info *child = process_get_child(pid);
+	sema_down(&child->loaded);
+	if(!args.success){
+		list_remove(&child->elem);
+		exit_info_put(child);
+		return TID_ERROR;
+	}
+	return pid;
+}
+
+/* Thread function of a spawned process.  Copies the parent's
+ * descriptors, applies the spawn actions and loads the program. */
+static void
+spawn_start (void *aux) {
+	struct spawn_args *args = aux;
+	struct thread *parent = args->parent;
+	struct thread *current = thread_current ();
+	struct intr_frame if_;
+
+#ifdef VM
+	supplemental_page_table_init (&current->spt);
+#endif
+	if (!fd_table_copy (&current->fdt, &parent->fdt))
+		goto error;
+
+	for (int i = 0; i < args->action_cnt; i++) {
+		const struct spawn_action *a = &args->actions[i];
+		if (a->fd < 2 || a->fd >= FDT_CNT_LIMIT)
+			goto error;
+		if (a->op == SPAWN_CLOSE)
+			fd_close (&current->fdt, a->fd);
+		else if (a->op == SPAWN_DUP2) {
+			if (fd_dup2 (&current->fdt, a->fd, a->newfd) < 0)
+				goto error;
+		} else
+			goto error;
+	}
+	process_init ();
+
+	if (!process_load (args->cmd_line, &if_)) {
+		args->cmd_line = NULL;
+		goto error;
+	}
+	args->success = true;
+	sema_up(&current->exit_info->loaded);
+	do_iret (&if_);
+	NOT_REACHED ();
+
+error:
+	if (args->cmd_line != NULL)
+		palloc_free_page (args->cmd_line);
+	/* The parent reports the failure, so exit without the message
+	 * that exit() prints. */
+	current->exit_status = TID_ERROR;
+	sema_up(&current->exit_info->loaded);
+	thread_exit ();
+}
+
+/* Returns the exit info of the current process's child CHILD_TID,
+ * or NULL if it has no such child or has already waited for it. */
+struct exit_info *process_get_child(tid_t child_tid){
 	struct thread *curr = thread_current ();
 	struct list_elem *elem;
 	if (list_empty(&curr->child_list)){
 		return NULL;
 	}
 	for(elem = list_begin(&curr->child_list);elem != list_end(&curr->child_list);elem = list_next(elem)){
-		struct thread *find_child = list_entry(elem,struct thread,child_elem);
+		struct exit_info *find_child = list_entry(elem,struct exit_info,elem);
 		if(find_child->tid == child_tid){
 			return find_child;
 		}
@@ -201,20 +305,12 @@ __do_fork (void *aux) {
 	}
 		
 #endif
-	for (int i = 0; i < FDT_CNT_LIMIT; i++) {
-		if (i<2){
-			current->fdt[i] = i;
-			continue;
-		}
-		struct file *file = parent->fdt[i];
-		if (file == NULL) {
-			continue;
-		}
-		file = file_duplicate(file);
-		current->fdt[i] = file;
-	}
-	current -> next_fd = parent -> next_fd;
-	sema_up(&current->dupl_sema);
+	if (!fd_table_copy (&current->fdt, &parent->fdt))
+		goto error;
+	/* The parent's ring stays with the parent and its worker; the
+	 * child must register a ring of its own. */
+	current->ring = NULL;
+	sema_up(&current->exit_info->loaded);
 	process_init();
 
 	/* Finally, switch to the newly created process. */
@@ -223,7 +319,8 @@ __do_fork (void *aux) {
 		//fork하는 thread는 exit 대신 context switching 된다.
 error:
 	succ =false;
-	sema_up(&current->dupl_sema);
+	current->exit_info->status = TID_ERROR;
+	sema_up(&current->exit_info->loaded);
 	exit(-1);
 }
 
@@ -231,53 +328,62 @@ error:
  * Returns -1 on fail. */
 int
 process_exec (void *f_name) {
-	char *file_name = f_name;
-	char *buf;
-	bool success;
-
-	
 	/* We cannot use the intr_frame in the thread structure.
 	 * This is because when current thread rescheduled,
 	 * it stores the execution information to the member. */
-	
 	struct intr_frame _if;
-	_if.ds = _if.es = _if.ss = SEL_UDSEG;
-	_if.cs = SEL_UCSEG;
-	_if.eflags = FLAG_IF | FLAG_MBS;
 
 	/* We first kill the current context */
+	ring_release ();
 	process_cleanup ();
 
+	if (!process_load (f_name, &_if))
+		return -1;
+	/* Start switched process. */
+	do_iret (&_if);
+	NOT_REACHED ();
+}
+
+/* Loads the program and arguments in the command line F_NAME into
+ * the current thread, which must have no address space, and sets up
+ * IF_ to enter it.  F_NAME is a page from palloc_get_page() and is
+ * freed.  Returns true if successful, false otherwise. */
+static bool
+process_load (char *f_name, struct intr_frame *if_) {
+	char *file_name = f_name;
+	bool success;
+
+	if_->ds = if_->es = if_->ss = SEL_UDSEG;
+	if_->cs = SEL_UCSEG;
+	if_->eflags = FLAG_IF | FLAG_MBS;
+
 	char *save_ptr;
 	char *f_copy;
 	f_copy = palloc_get_page(0);
-	if (f_copy == NULL)
-		return TID_ERROR;
+	if (f_copy == NULL){
+		palloc_free_page (file_name);
+		return false;
+	}
 	strlcpy (f_copy, file_name, PGSIZE);
 	
 	f_copy = strtok_r(f_copy," ",&save_ptr);
 	/* And then load the binary */
-	lock_acquire(&filesys_lock);
-	success = load (f_copy, &_if);
-	lock_release(&filesys_lock);
+	success = load (f_copy, if_);
 	/* If load failed, quit. */
 	palloc_free_page (f_copy);
 	if (!success){
 		palloc_free_page (file_name);
-		return -1;
+		return false;
 	}
-	parsing_file_input(file_name,&_if); //file이 있는 경우에만 parsing하도록
-	// hex_dump(_if.rsp,_if.rsp,USER_STACK-_if.rsp,true);
+	parsing_file_input(file_name,if_); //file이 있는 경우에만 parsing하도록
+	// hex_dump(if_->rsp,if_->rsp,USER_STACK-if_->rsp,true);
 #ifdef VM
-	thread_current()->curr_rsp = (void*)_if.rsp;
+	thread_current()->curr_rsp = (void*)if_->rsp;
 #endif
 	palloc_free_page (file_name);
-	/* Start switched process. */
-	do_iret (&_if);
-	NOT_REACHED ();
+	return true;
 }
 
-
 /* Waits for thread TID to die and returns its exit status.  If
  * it was terminated by the kernel (i.e. killed due to an
  * exception), returns -1.  If TID is invalid or if it was not a
@@ -294,15 +400,15 @@ process_wait (tid_t child_tid) {
 	}
 	struct thread *curr = thread_current();
 
-	struct thread *child = process_get_child(child_tid);
+	struct exit_info *child = process_get_child(child_tid);
 	
 	if (child == NULL){
 		return -1;
 	}
-	sema_down(&child->child_wait_sema);
-	int child_exist_status = child->exit_status;
-	list_remove(&child->child_elem);
-	sema_up(&child->exit_sema);
+	sema_down(&child->exited);
+	int child_exist_status = child->status;
+	list_remove(&child->elem);
+	exit_info_put(child);
 	return child_exist_status;
 }
 
@@ -310,70 +416,43 @@ process_wait (tid_t child_tid) {
 void
 process_exit (void) {
 	struct thread *curr = thread_current ();
-#ifndef VM
-	bool is_dup = false;
-	for(int i =2;i<FDT_CNT_LIMIT;i++){
-		if(curr->fdt[i] == NULL){
-			continue;
-		}
-		else{
-			for(int j=2;j<curr->next_dup;j++){
-				if(curr->fdt_dup[j] == curr->fdt[i]){
-					curr->fdt_dup[j] = NULL;
-					curr->fdt[i] = NULL;
-					is_dup = true;
-					break;
-				}
-			}
-			if(is_dup){
-				is_dup = false;
-				continue;
-			}
-			else{
-				file_close(curr->fdt[i]);
-				curr->fdt[i] = NULL;
-			}
-		}
-	}
-	
-	palloc_free_multiple(curr->fdt_dup,FDT_PAGES);
-#endif
-	if(curr->next_fd >=2){
-		for(int i =2;i<FDT_CNT_LIMIT;i++){
-			if(curr->fdt[i] == NULL){
-				continue;
-			}
-			file_close(curr->fdt[i]);
-		}
-	}
-	
+	/* The ring's worker may still use files and user memory. */
+	ring_release ();
+	fd_table_destroy (&curr->fdt);
+
 	if (curr->loading_file){
 		file_close(curr->loading_file);
 		curr->loading_file = NULL;
 	}
-	palloc_free_multiple(curr->fdt,FDT_PAGES);
-	
 
-	
-	
-
-	// //죽을때 wait 부르지 않은 자식들 exit 허용하고 exit
-	// //error : list_remove를 사용 시 페이지 폴트 : 권한없는 메모리 접근
-	// if(!list_empty(&curr->child_list)){
-	// 	struct list_elem *elem;
-	// 	for(elem=list_begin(&curr->child_list);elem!=list_end(&curr->child_list);){
-	// 		struct thread *waiting_child = list_entry(elem,struct thread,child_elem);
-	// 		printf("%s\n",waiting_child->name);
-	// 		elem = list_remove(elem);
-	// 		sema_up(&waiting_child->exit_sema);
-	// 	}
-	// }
-	sema_up(&curr->child_wait_sema);
+	/* Children we never waited for are reaped when they exit, or now
+	 * if they already have. */
+	while (!list_empty (&curr->child_list))
+		exit_info_put (list_entry (list_pop_front (&curr->child_list),
+					struct exit_info, elem));
 	process_cleanup ();
-	sema_down(&curr->exit_sema);
-#ifdef VM
-	hash_destroy(&curr->spt.pages,hash_action_free);
-#endif
+
+	/* Nothing is left to free but the thread page, which the
+	 * scheduler frees, so the parent may go on. */
+	if (curr->exit_info != NULL) {
+		curr->exit_info->status = curr->exit_status;
+		sema_up (&curr->exit_info->exited);
+		exit_info_put (curr->exit_info);
+		curr->exit_info = NULL;
+	}
+}
+
+/* Drops a reference to exit info INFO, freeing it if that was the
+ * last one.  The parent and the child may drop theirs at the same
+ * time. */
+static void
+exit_info_put (struct exit_info *info) {
+	enum intr_level old_level = intr_disable ();
+	int ref_cnt = --info->ref_cnt;
+	intr_set_level (old_level);
+
+	if (ref_cnt == 0)
+		free (info);
 }
 
 /* Free the current process's resources. */
@@ -415,20 +494,7 @@ process_activate (struct thread *next) {
 }
 
 int process_add_fd(struct file *f){
-	struct thread *curr = thread_current();
-	struct file **fdt = curr->fdt;
-	
-	while(curr->next_fd<FDT_CNT_LIMIT && fdt[curr->next_fd]){
-		curr->next_fd++;
-	}
-
-	if(curr->next_fd == FDT_CNT_LIMIT){
-		return -1;
-	}
-	
-	fdt[curr->next_fd] = f;
-
-	return curr->next_fd;
+	return fd_install (&thread_current ()->fdt, f);
 }
 
 
@@ -495,33 +561,177 @@ static bool load_segment (struct file *file, off_t ofs, uint8_t *upage,
 
 
 
-/* Loads an ELF executable from FILE_NAME into the current thread.
- * Stores the executable's entry point into *RIP
- * and its initial stack pointer into *RSP.
- * Returns true if successful, false otherwise. */
-static bool
-load (const char *file_name, struct intr_frame *if_) {
-	struct thread *t = thread_current ();
+/* A PT_LOAD segment, laid out for load_segment(). */
+struct exec_segment {
+	uint64_t file_page;         /* Page-aligned file offset. */
+	uint64_t mem_page;          /* Page-aligned user address. */
+	uint32_t read_bytes;        /* Bytes read from the file. */
+	uint32_t zero_bytes;        /* Bytes zeroed after them. */
+	bool writable;
+};
+
+/* The parsed and validated headers of an executable.  Images are
+ * kept in the exec cache, so that executing a program again skips
+ * reading and checking its headers. */
+struct exec_image {
+	struct list_elem elem;      /* Element in exec_cache. */
+	struct inode *inode;        /* Executable, reopened while cached. */
+	unsigned write_cnt;         /* inode_write_cnt() when parsed. */
+	int use_cnt;                /* Loads using the image. */
+	bool cached;                /* In exec_cache? */
+	uint64_t entry;             /* Entry point. */
+	int seg_cnt;                /* Number of segments. */
+	struct exec_segment segs[]; /* PT_LOAD segments, in file order. */
+};
+
+/* Maximum number of images in the exec cache. */
+#define EXEC_CACHE_SIZE 8
+
+/* Cached images, most recently used first. */
+static struct list exec_cache;
+static struct lock exec_cache_lock;
+
+/* Number of times executable headers were parsed, read by tests via
+ * int 0x4c. */
+static long long exec_parse_cnt;
+
+static void
+inspect_exec_parse_cnt (struct intr_frame *f) {
+	f->R.rax = exec_parse_cnt;
+}
+
+/* Initializes the exec cache and registers int 0x4c, which returns
+ * in RAX the number of times executable headers were parsed. */
+void
+exec_cache_init (void) {
+	list_init (&exec_cache);
+	lock_init (&exec_cache_lock);
+	intr_register_int (0x4c, 3, INTR_OFF, inspect_exec_parse_cnt,
+			"Inspect Exec Header Parses");
+}
+
+/* Releases IMAGE, which must not be cached. */
+static void
+exec_image_free (struct exec_image *image) {
+	inode_close (image->inode);
+	free (image);
+}
+
+/* Returns the cached image of FILE with a new use, or NULL if FILE
+ * has none or was written since it was parsed. */
+static struct exec_image *
+exec_image_get (struct file *file) {
+	struct inode *inode = file_get_inode (file);
+	struct list_elem *e;
+
+	lock_acquire (&exec_cache_lock);
+	for (e = list_begin (&exec_cache); e != list_end (&exec_cache);
+			e = list_next (e)) {
+		struct exec_image *image = list_entry (e, struct exec_image, elem);
+		if (image->inode != inode)
+			continue;
+		list_remove (&image->elem);
+		if (image->write_cnt != inode_write_cnt (inode)) {
+			image->cached = false;
+			if (image->use_cnt == 0)
+				exec_image_free (image);
+			break;
+		}
+		list_push_front (&exec_cache, &image->elem);
+		image->use_cnt++;
+		lock_release (&exec_cache_lock);
+		return image;
+	}
+	lock_release (&exec_cache_lock);
+	return NULL;
+}
+
+/* Drops a use of IMAGE. */
+static void
+exec_image_put (struct exec_image *image) {
+	lock_acquire (&exec_cache_lock);
+	if (--image->use_cnt == 0 && !image->cached)
+		exec_image_free (image);
+	lock_release (&exec_cache_lock);
+}
+
+/* Takes IMAGE out of the exec cache, freeing it unless it is in
+ * use.  exec_cache_lock must be held. */
+static void
+exec_image_uncache (struct exec_image *image) {
+	list_remove (&image->elem);
+	image->cached = false;
+	if (image->use_cnt == 0)
+		exec_image_free (image);
+}
+
+/* Drops the cached image of INODE, which is being removed, so that
+ * the cache does not keep the file, and its sectors, alive. */
+void
+exec_cache_forget (struct inode *inode) {
+	struct list_elem *e;
+
+	lock_acquire (&exec_cache_lock);
+	for (e = list_begin (&exec_cache); e != list_end (&exec_cache);
+			e = list_next (e)) {
+		struct exec_image *image = list_entry (e, struct exec_image, elem);
+		if (image->inode == inode) {
+			exec_image_uncache (image);
+			break;
+		}
+	}
+	lock_release (&exec_cache_lock);
+}
+
+/* Empties the exec cache, closing the inodes it holds open, before
+ * the file system shuts down. */
+void
+exec_cache_flush (void) {
+	lock_acquire (&exec_cache_lock);
+	while (!list_empty (&exec_cache))
+		exec_image_uncache (list_entry (list_front (&exec_cache),
+					struct exec_image, elem));
+	lock_release (&exec_cache_lock);
+}
+
+/* Enters IMAGE, which has one use, into the exec cache, making
+ * room by dropping the least recently used unused image.  IMAGE is
+ * left uncached if every cached image is in use. */
+static void
+exec_image_add (struct exec_image *image) {
+	lock_acquire (&exec_cache_lock);
+	if (list_size (&exec_cache) >= EXEC_CACHE_SIZE) {
+		struct list_elem *e;
+		for (e = list_rbegin (&exec_cache); e != list_rend (&exec_cache);
+				e = list_prev (e)) {
+			struct exec_image *victim = list_entry (e, struct exec_image, elem);
+			if (victim->use_cnt == 0) {
+				exec_image_uncache (victim);
+				break;
+			}
+		}
+	}
+	if (list_size (&exec_cache) < EXEC_CACHE_SIZE) {
+		image->cached = true;
+		list_push_front (&exec_cache, &image->elem);
+	}
+	lock_release (&exec_cache_lock);
+}
+
+/* Reads and validates the ELF headers of FILE.  Returns the new
+ * image with one use, or NULL if FILE is not a loadable executable
+ * or memory allocation fails. */
+static struct exec_image *
+exec_image_parse (struct file *file, const char *file_name) {
+	struct exec_image *image;
 	struct ELF ehdr;
-	struct file *file = NULL;
 	off_t file_ofs;
-	bool success = false;
 	int i;
 
-	
-	/* Allocate and activate page directory. */
-	t->pml4 = pml4_create ();
-	if (t->pml4 == NULL)
-		goto done;
-	process_activate (thread_current ());
-	/* Open executable file. */
-	file = filesys_open (file_name);
-	if (file == NULL) {
-		printf ("load: %s: open failed\n", file_name);
-		goto done;
-	}
+	exec_parse_cnt++;
+
 	/* Read and verify executable header. */
-	if (file_read (file, &ehdr, sizeof ehdr) != sizeof ehdr
+	if (file_read_at (file, &ehdr, sizeof ehdr, 0) != sizeof ehdr
 			|| memcmp (ehdr.e_ident, "\177ELF\2\1\1", 7)
 			|| ehdr.e_type != 2
 			|| ehdr.e_machine != 0x3E // amd64
@@ -529,20 +739,29 @@ load (const char *file_name, struct intr_frame *if_) {
 			|| ehdr.e_phentsize != sizeof (struct Phdr)
 			|| ehdr.e_phnum > 1024) {
 		printf ("load: %s: error loading executable\n", file_name);
-		goto done;
+		return NULL;
 	}
 
+	/* Every program header may be a PT_LOAD. */
+	image = malloc (sizeof *image + ehdr.e_phnum * sizeof *image->segs);
+	if (image == NULL)
+		return NULL;
+	image->inode = inode_reopen (file_get_inode (file));
+	image->write_cnt = inode_write_cnt (image->inode);
+	image->use_cnt = 1;
+	image->cached = false;
+	image->entry = ehdr.e_entry;
+	image->seg_cnt = 0;
+
 	/* Read program headers. */
 	file_ofs = ehdr.e_phoff;
 	for (i = 0; i < ehdr.e_phnum; i++) {
 		struct Phdr phdr;
 
 		if (file_ofs < 0 || file_ofs > file_length (file))
-			goto done;
-		file_seek (file, file_ofs);
-
-		if (file_read (file, &phdr, sizeof phdr) != sizeof phdr)
-			goto done;
+			goto error;
+		if (file_read_at (file, &phdr, sizeof phdr, file_ofs) != sizeof phdr)
+			goto error;
 		file_ofs += sizeof phdr;
 		switch (phdr.p_type) {
 			case PT_NULL:
@@ -555,43 +774,92 @@ load (const char *file_name, struct intr_frame *if_) {
 			case PT_DYNAMIC:
 			case PT_INTERP:
 			case PT_SHLIB:
-				goto done;
+				goto error;
 			case PT_LOAD:
 				if (validate_segment (&phdr, file)) {
-					bool writable = (phdr.p_flags & PF_W) != 0;
-					uint64_t file_page = phdr.p_offset & ~PGMASK;
-					uint64_t mem_page = phdr.p_vaddr & ~PGMASK;
+					struct exec_segment *seg = &image->segs[image->seg_cnt++];
 					uint64_t page_offset = phdr.p_vaddr & PGMASK;
-					uint32_t read_bytes, zero_bytes;
+					seg->writable = (phdr.p_flags & PF_W) != 0;
+					seg->file_page = phdr.p_offset & ~PGMASK;
+					seg->mem_page = phdr.p_vaddr & ~PGMASK;
 					if (phdr.p_filesz > 0) {
 						/* Normal segment.
 						 * Read initial part from disk and zero the rest. */
-						read_bytes = page_offset + phdr.p_filesz;
-						zero_bytes = (ROUND_UP (page_offset + phdr.p_memsz, PGSIZE)
-								- read_bytes);
+						seg->read_bytes = page_offset + phdr.p_filesz;
+						seg->zero_bytes = (ROUND_UP (page_offset + phdr.p_memsz, PGSIZE)
+								- seg->read_bytes);
 					} else {
 						/* Entirely zero.
 						 * Don't read anything from disk. */
-						read_bytes = 0;
-						zero_bytes = ROUND_UP (page_offset + phdr.p_memsz, PGSIZE);
+						seg->read_bytes = 0;
+						seg->zero_bytes = ROUND_UP (page_offset + phdr.p_memsz, PGSIZE);
 					}
-					if (!load_segment (file, file_page, (void *) mem_page,
-								read_bytes, zero_bytes, writable))
-						goto done;
 				}
 				else
-					goto done;
+					goto error;
 				break;
 		}
 	}
+	return image;
+
+error:
+	exec_image_free (image);
+	return NULL;
+}
+
+/* Loads an ELF executable from FILE_NAME into the current thread.
+ * Stores the executable's entry point into *RIP
+ * and its initial stack pointer into *RSP.
+ * Returns true if successful, false otherwise. */
+static bool
+load (const char *file_name, struct intr_frame *if_) {
+	struct thread *t = thread_current ();
+	struct exec_image *image = NULL;
+	struct file *file = NULL;
+	bool success = false;
+	int i;
+
+	
+	/* Allocate and activate page directory. */
+	t->pml4 = pml4_create ();
+	if (t->pml4 == NULL)
+		goto done;
+	process_activate (thread_current ());
+	/* Open executable file. */
+	file = filesys_open (file_name);
+	if (file == NULL) {
+		printf ("load: %s: open failed\n", file_name);
+		goto done;
+	}
+	/* Denied first, so the headers cannot change under the cached
+	 * image while we use it. */
 	file_deny_write(file); // 파일 복사 중 쓰기 방지
+
+	image = exec_image_get (file);
+	if (image == NULL) {
+		image = exec_image_parse (file, file_name);
+		if (image == NULL)
+			goto done;
+		exec_image_add (image);
+	}
+
+	for (i = 0; i < image->seg_cnt; i++) {
+		const struct exec_segment *seg = &image->segs[i];
+		if (!load_segment (file, seg->file_page, (void *) seg->mem_page,
+					seg->read_bytes, seg->zero_bytes, seg->writable))
+			goto done;
+	}
+	/* The previous program of an exec()ing process may be written
+	 * again. */
+	if (t->loading_file)
+		file_close (t->loading_file);
 	t->loading_file = file;
 
 	/* Set up stack. */
 	if (!setup_stack (if_))
 		goto done;
 	/* Start address. */
-	if_->rip = ehdr.e_entry;
+	if_->rip = image->entry;
 	
 	/* TODO: Your code goes here.
 	 * TODO: Implement argument passing (see project2/argument_passing.html). */
@@ -603,6 +871,10 @@ load (const char *file_name, struct intr_frame *if_) {
 
 done:
 	/* We arrive here whether the load is successful or not. */
+	if (image != NULL)
+		exec_image_put (image);
+	if (file != NULL && t->loading_file != file)
+		file_close (file);
 	return success;
 }
 
@@ -833,32 +1105,15 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
 	ASSERT (pg_ofs (upage) == 0);
 	ASSERT (ofs % PGSIZE == 0);
 
-	file_seek (file, ofs);
-	while (read_bytes > 0 || zero_bytes > 0) {
-		size_t page_read_bytes = read_bytes < PGSIZE ? read_bytes : PGSIZE;
-		size_t page_zero_bytes = PGSIZE - page_read_bytes;
-
-		/* TODO: Set up aux to pass information to the lazy_load_segment. */
-		struct load_info *load_info = (struct load_info *)malloc(sizeof(struct load_info));
-		if (load_info == NULL){
-			return false;
-		}
-		load_info->file = file;
-		load_info->page_read_bytes = page_read_bytes;
-		load_info->page_zero_bytes = page_zero_bytes;
-		load_info->ofs = ofs;
-		if (!vm_alloc_page_with_initializer (VM_ANON, upage,
-					writable, lazy_load_segment, load_info)){
-			free(load_info);
-			return false;
-			}
-
-		read_bytes -= page_read_bytes;
-		zero_bytes -= page_zero_bytes;
-		upage += PGSIZE;
-		ofs += page_read_bytes;
-	}
-	return true;
+	/* The segment is recorded as one VMA; its pages are created by
+	 * vm_try_handle_fault() when first touched.  Read-only segments
+	 * are backed by the file itself and writable ones by anonymous
+	 * memory, but both are read through the text cache so that
+	 * processes running the same executable share its pages. */
+	enum vm_type type = (writable ? VM_ANON : VM_FILE) | VM_SHARED;
+	return vma_create (&thread_current ()->spt, upage,
+			read_bytes + zero_bytes, type, file, ofs, read_bytes,
+			writable) != NULL;
 }
 
 /* Create a PAGE of stack at the USER_STACK. Return true on success. */
@@ -1,9 +1,14 @@
 #include "userprog/syscall.h"
 #include <stdio.h>
+#include <limits.h>
 #include <syscall-nr.h>
+#include <iovec.h>
+#include <ring.h>
+#include <spawn.h>
 #include "threads/interrupt.h"
 #include "threads/thread.h"
 #include "threads/palloc.h"
+#include "threads/malloc.h"
 #include "threads/loader.h"
 #include "userprog/gdt.h"
 #include "threads/flags.h"
@@ -11,10 +16,13 @@
 #include "userprog/process.h"
 #include "filesys/filesys.h"
 #include "filesys/file.h"
+#include "filesys/inode.h"
+#include "filesys/pipe.h"
 #include "lib/kernel/stdio.h"
+#include "devices/input.h"
+#include "userprog/uaccess.h"
 #ifdef VM
 #include "vm/vm.h"
-void check_invalid_write(void *addr);
 #endif
 
 
@@ -34,9 +42,21 @@ int read(int fd, void *buffer, unsigned size);
 void seek (int fd, unsigned position);
 unsigned tell (int fd);
 void close (int fd);
-#ifndef VM
+int readv(int fd, const struct iovec *iov, int iovcnt);
+int writev(int fd, const struct iovec *iov, int iovcnt);
+int preadv(int fd, const struct iovec *iov, int iovcnt, off_t offset);
+int pwritev(int fd, const struct iovec *iov, int iovcnt, off_t offset);
+int ring_setup(struct ring *ring);
+int ring_enter(void);
+static void ring_wait_idle (void);
+#ifdef VM
+static bool ring_in_range (const void *start, const void *end);
+#endif
+int spawn(const char *cmd_line, const struct spawn_action *actions, int action_cnt);
+int pipe(int *fds);
+int splice(int fd_in, int fd_out, unsigned size);
 int dup2(int oldfd, int newfd);
-#else
+#ifdef VM
 void munmap (void *addr);
 void * mmap (void *addr, size_t length, int writable, int fd, off_t offset);
 #endif
@@ -54,9 +74,12 @@ void * mmap (void *addr, size_t length, int writable, int fd, off_t offset);
 #define MSR_LSTAR 0xc0000082        /* Long mode SYSCALL target */
 #define MSR_SYSCALL_MASK 0xc0000084 /* Mask for the eflags */
 
+/* Number of system calls handled since boot, read by tests via
+ * int 0x47. */
+static long long syscall_cnt;
+
 void
 syscall_init (void) {
-	lock_init(&filesys_lock);
 	write_msr(MSR_STAR, ((uint64_t)SEL_UCSEG - 0x10) << 48  |
 			((uint64_t)SEL_KCSEG) << 32);
 	write_msr(MSR_LSTAR, (uint64_t) syscall_entry);
@@ -73,6 +96,7 @@ void
 syscall_handler (struct intr_frame *f UNUSED) {
 	// TODO: Your implementation goes here.
 	int syscall_num = f->R.rax; // rax에 존재하는 시스템콜 넘버 추출
+	syscall_cnt++;
 #ifdef VM
 	thread_current()->curr_rsp = f->rsp;
 #endif
@@ -132,19 +156,54 @@ syscall_handler (struct intr_frame *f UNUSED) {
 		case SYS_CLOSE:
 			close(f->R.rdi);
 			break;
-#ifndef VM
+
+		case SYS_READV:
+			f->R.rax = readv(f->R.rdi,(const struct iovec *)f->R.rsi,f->R.rdx);
+			break;
+
+		case SYS_WRITEV:
+			f->R.rax = writev(f->R.rdi,(const struct iovec *)f->R.rsi,f->R.rdx);
+			break;
+
+		case SYS_PREADV:
+			f->R.rax = preadv(f->R.rdi,(const struct iovec *)f->R.rsi,f->R.rdx,f->R.r10);
+			break;
+
+		case SYS_PWRITEV:
+			f->R.rax = pwritev(f->R.rdi,(const struct iovec *)f->R.rsi,f->R.rdx,f->R.r10);
+			break;
+
+		case SYS_RING_SETUP:
+			f->R.rax = ring_setup((struct ring *)f->R.rdi);
+			break;
+
+		case SYS_RING_ENTER:
+			f->R.rax = ring_enter();
+			break;
+
+		case SYS_SPAWN:
+			f->R.rax = spawn((const char *)f->R.rdi,(const struct spawn_action *)f->R.rsi,f->R.rdx);
+			break;
+
+		case SYS_PIPE:
+			f->R.rax = pipe((int *)f->R.rdi);
+			break;
+
+		case SYS_SPLICE:
+			f->R.rax = splice(f->R.rdi,f->R.rsi,f->R.rdx);
+			break;
 		case SYS_DUP2:
 			f->R.rax = dup2(f->R.rdi,f->R.rsi);
 			break;
-#else
+#ifdef VM
 		case SYS_MMAP:
 			f->R.rax = mmap(f->R.rdi,f->R.rsi,f->R.rdx,f->R.r10,f->R.r8);
 			break;
 		case SYS_MUNMAP:
 			munmap(f->R.rdi);
 			break;
-	}
 #endif
+	}
 }
 
 void check_addr(void *addr){
@@ -158,26 +217,15 @@ void check_addr(void *addr){
 #endif
 }
 
-#ifdef VM
-void check_invalid_write(void *addr){
-	if (addr <= USER_STACK && addr >= USER_STACK - (1<<20)){
-		return;
-	}
-	struct page *page = spt_find_page(&thread_current()->spt,addr);
-	if(page == NULL){
-		exit(-1);
-	}
-	else if(page->writable == false){
-		exit(-1);
-	}
+/* Returns the open file for FD, or NULL if FD is not a file. */
+static struct file *
+fd_to_file (int fd){
+	return fd_lookup (&thread_current ()->fdt, fd);
 }
-#endif
 
 int open(const char *file_name){
 	check_addr(file_name);
-	lock_acquire(&filesys_lock);
 	struct file *file = filesys_open(file_name);
-	lock_release(&filesys_lock);
 	if (file == NULL) {
 		return -1;
 	}
@@ -203,11 +251,29 @@ int exec(const char *cmd_line){
 	}
 }
 
+int spawn(const char *cmd_line, const struct spawn_action *actions, int action_cnt){
+	check_addr(cmd_line);
+	if (action_cnt < 0 || action_cnt > SPAWN_ACTIONS_MAX){
+		return -1;
+	}
+
+	struct spawn_action actions_copy[SPAWN_ACTIONS_MAX];
+	if (!copy_from_user(actions_copy, actions, action_cnt * sizeof *actions)){
+		exit(-1);
+	}
+	char *cmd_line_copy;
+	cmd_line_copy = palloc_get_page(0);
+	if (cmd_line_copy == NULL){
+		return -1;
+	}
+	strlcpy (cmd_line_copy,cmd_line,PGSIZE);
+	return process_spawn(cmd_line_copy,actions_copy,action_cnt);
+}
+
 void exit(int status){
 	struct thread *curr = thread_current ();
 	printf("%s: exit(%d)\n",curr->name,status);
 	curr->exit_status = status;
-	sema_up(&curr->child_wait_sema);
 	thread_exit();
 }
 
@@ -217,33 +283,80 @@ void halt(void){
 
 int write(int fd, void *buffer, unsigned size){
 	check_addr(buffer);
-
-	struct thread *curr = thread_current();
-	if(fd < 1){
-		return -1;
+	/* Pinned up front: the file system must not fault on BUFFER
+	 * while it holds the inode's locks. */
+	if(!pin_user_pages(buffer,size,false)){
+		exit(-1);
 	}
-	lock_acquire(&filesys_lock);
+
+	int write_size = -1;
 	if (fd == 1){
 		putbuf((char*)buffer,(size_t)size);
-		lock_release(&filesys_lock);
-		return size;
+		write_size = size;
 	}
-	if(curr->fdt[fd] == NULL){
-		lock_release(&filesys_lock);
-		return -1;
+	else if(fd_to_file(fd) != NULL){
+		write_size = (int)file_write(fd_to_file(fd),buffer,(off_t)size);
 	}
-	
-	int write_size = (int)file_write(curr->fdt[fd],buffer,(off_t)size);
-	lock_release(&filesys_lock);
+	unpin_user_pages(buffer,size);
 	return write_size;
 
 }
 
+/* Creates a pipe and stores the descriptors of its read end and
+ * write end in FDS[0] and FDS[1].  Returns 0, or -1 if the pipe or
+ * the descriptors cannot be allocated. */
+int pipe(int *fds){
+	struct file *read_end, *write_end;
+	int kfds[2];
+
+	if (!pipe_create(&read_end, &write_end)){
+		return -1;
+	}
+	kfds[0] = process_add_fd(read_end);
+	if (kfds[0] == -1){
+		file_close(read_end);
+		file_close(write_end);
+		return -1;
+	}
+	kfds[1] = process_add_fd(write_end);
+	if (kfds[1] == -1){
+		close(kfds[0]);
+		file_close(write_end);
+		return -1;
+	}
+	if (!copy_to_user(fds, kfds, sizeof kfds)){
+		close(kfds[0]);
+		close(kfds[1]);
+		exit(-1);
+	}
+	return 0;
+}
+
+/* Moves up to SIZE bytes between a pipe and a file without copying
+ * them through user memory.  One of FD_IN and FD_OUT must be a pipe
+ * end and the other a file, used at its current position.  Returns
+ * the number of bytes moved, or -1 on error. */
+int splice(int fd_in, int fd_out, unsigned size){
+	struct file *in = fd_to_file(fd_in);
+	struct file *out = fd_to_file(fd_out);
+
+	if (in == NULL || out == NULL || size > INT_MAX){
+		return -1;
+	}
+	/* Data leaves a pipe through its read end and enters it through
+	 * its write end. */
+	if (file_get_pipe(in) != NULL && !file_is_pipe_writer(in)
+			&& file_get_pipe(out) == NULL){
+		return pipe_splice_to_file(file_get_pipe(in), out, size);
+	}
+	if (file_get_pipe(in) == NULL && file_is_pipe_writer(out)){
+		return pipe_splice_from_file(file_get_pipe(out), in, size);
+	}
+	return -1;
+}
+
 int fork(const char *file, struct intr_frame *f){
-	lock_acquire(&filesys_lock);
-	int fork_pid = process_fork(file,f);
-	lock_release(&filesys_lock);
-	return fork_pid;
+	return process_fork(file,f);
 }
 
 int wait(tid_t child_tid){
@@ -254,9 +367,7 @@ int wait(tid_t child_tid){
 
 bool create_file(const char *file, unsigned initial_size){
 	check_addr(file);
-	lock_acquire(&filesys_lock);
 	bool success = filesys_create(file,initial_size);
-	lock_release(&filesys_lock);
 	return success;
 }
 
@@ -268,115 +379,180 @@ bool remove_file(const char *file){
 }
 
 int filesize(int fd){
-	struct thread *curr = thread_current ();
-	if (fd < 2 || curr->fdt[fd] == NULL){
+	struct file *file = fd_to_file(fd);
+	if (file == NULL){
 		return -1;
 	}
 	
-	return file_length(curr->fdt[fd]);
+	return file_length(file);
 }
 
 int read(int fd, void *buffer, unsigned size){
 	check_addr(buffer);
-#ifdef VM
-	check_invalid_write(buffer);
-#endif
-	if(fd == 1 || fd < 0){
-		return -1;
+	if(!pin_user_pages(buffer,size,true)){
+		exit(-1);
 	}
-	struct thread *curr = thread_current ();
-	lock_acquire(&filesys_lock);
+
+	int read_size = -1;
 	if (fd == 0){
-		int read_size = strlen(input_getc());
-		lock_release(&filesys_lock);
-		return read_size;
+		uint8_t *buf = buffer;
+		for (unsigned i = 0; i < size; i++){
+			buf[i] = input_getc();
+		}
+		read_size = size;
 	}
-	
-	if(curr->fdt[fd] == NULL){
-		lock_release(&filesys_lock);
-		return -1;
+	else if(fd_to_file(fd) != NULL){
+		read_size = (int)file_read(fd_to_file(fd),buffer,(off_t)size);
 	}
-	struct file *file = curr->fdt[fd];
-	int read_size = (int)file_read(file,buffer,(off_t)size);
-	lock_release(&filesys_lock);
+	unpin_user_pages(buffer,size);
 	return read_size;
 }
 
 void seek (int fd, unsigned position){
-	struct thread *curr = thread_current();
+	struct file *file = fd_to_file(fd);
 	if(position < 0){
 		return;
 	}
-	if (curr->fdt[fd] != NULL){
-		file_seek(curr->fdt[fd],(off_t)position);
+	if (file != NULL){
+		file_seek(file,(off_t)position);
 	}
 }
 
 unsigned tell (int fd){
-	struct thread *curr = thread_current();
-	if (fd >1 && curr->fdt[fd] != NULL){
-		unsigned point = (unsigned)file_tell(curr->fdt[fd]);
+	struct file *file = fd_to_file(fd);
+	if (file != NULL){
+		unsigned point = (unsigned)file_tell(file);
 		return point;
 	}
 	else{
 		return -1; // 어떻게 예외처리?
 	}
 }
-#ifndef VM
-void close (int fd){
-	struct thread *curr = thread_current ();
-	struct file *closing_file = curr->fdt[fd];
-	if(closing_file != NULL){
-		if(fd >1){
-			for(int i = 2; i< curr->next_dup;i++){
-				if(curr->fdt_dup[i] == curr->fdt[fd]){
-					curr->fdt_dup[i] == NULL;
-					curr->fdt[fd] == NULL;
-					return;
-				}
+
+/* Copies the IOVCNT user segments at UIOV into KIOV and pins
+ * every segment, so the transfer itself needs no further checks.
+ * TO_USER is true if the segments will be written, as for a read.
+ * Exits the process on a bad address.  Returns the total length, or
+ * -1, with nothing pinned, if IOVCNT or the total is out of range.
+ * A nonnegative return must be paired with unpin_iovec(). */
+static int
+pin_iovec (struct iovec *kiov, const struct iovec *uiov, int iovcnt,
+		bool to_user){
+	int total = 0;
+	int i;
+
+	if (iovcnt < 0 || iovcnt > IOV_MAX){
+		return -1;
+	}
+	if (!copy_from_user(kiov, uiov, iovcnt * sizeof *uiov)){
+		exit(-1);
+	}
+	for (i = 0; i < iovcnt; i++){
+		if (kiov[i].iov_len > (size_t) (INT_MAX - total)){
+			break;
+		}
+		total += kiov[i].iov_len;
+	}
+	if (i < iovcnt){
+		return -1;
+	}
+
+	for (i = 0; i < iovcnt; i++){
+		if (!pin_user_pages(kiov[i].iov_base, kiov[i].iov_len, to_user)){
+			while (i-- > 0){
+				unpin_user_pages(kiov[i].iov_base, kiov[i].iov_len);
 			}
+			exit(-1);
 		}
-		file_close(curr->fdt[fd]);
-		curr->fdt[fd] = NULL;
 	}
+	return total;
 }
 
-int dup2(int oldfd, int newfd){
-	if(oldfd < 2){
-		return -1;
+/* Releases the pins taken by pin_iovec(). */
+static void
+unpin_iovec (const struct iovec *kiov, int iovcnt){
+	for (int i = 0; i < iovcnt; i++){
+		unpin_user_pages(kiov[i].iov_base, kiov[i].iov_len);
 	}
+}
 
-	if(oldfd == newfd){
-		return newfd;
+int readv(int fd, const struct iovec *iov, int iovcnt){
+	struct iovec kiov[IOV_MAX];
+	int total = pin_iovec(kiov, iov, iovcnt, true);
+	if (total < 0){
+		return -1;
 	}
+	int read_size = -1;
+	if (fd == 0){
+		for (int i = 0; i < iovcnt; i++){
+			uint8_t *buf = kiov[i].iov_base;
+			for (size_t j = 0; j < kiov[i].iov_len; j++){
+				buf[j] = input_getc();
+			}
+		}
+		read_size = total;
+	}
+	else if (fd_to_file(fd) != NULL){
+		read_size = (int) file_readv(fd_to_file(fd), kiov, iovcnt);
+	}
+	unpin_iovec(kiov, iovcnt);
+	return read_size;
+}
 
-	struct thread *curr = thread_current ();
-
-	if (curr->fdt[newfd] != NULL){
+int writev(int fd, const struct iovec *iov, int iovcnt){
+	struct iovec kiov[IOV_MAX];
+	int total = pin_iovec(kiov, iov, iovcnt, false);
+	if (total < 0){
 		return -1;
 	}
+	int write_size = -1;
+	if (fd == 1){
+		for (int i = 0; i < iovcnt; i++){
+			putbuf(kiov[i].iov_base, kiov[i].iov_len);
+		}
+		write_size = total;
+	}
+	else if (fd_to_file(fd) != NULL){
+		write_size = (int) file_writev(fd_to_file(fd), kiov, iovcnt);
+	}
+	unpin_iovec(kiov, iovcnt);
+	return write_size;
+}
 
-	lock_acquire(&filesys_lock);
-	curr->fdt[newfd] = curr->fdt[oldfd];
-	curr->fdt_dup[curr->next_dup] = curr->fdt[newfd];
-	curr->next_dup++;
-	lock_release(&filesys_lock);
+int preadv(int fd, const struct iovec *iov, int iovcnt, off_t offset){
+	struct iovec kiov[IOV_MAX];
+	struct file *file = fd_to_file(fd);
+	if (file == NULL || offset < 0
+			|| pin_iovec(kiov, iov, iovcnt, true) < 0){
+		return -1;
+	}
+	int read_size = (int) file_readv_at(file, kiov, iovcnt, offset);
+	unpin_iovec(kiov, iovcnt);
+	return read_size;
+}
 
-	return newfd;
+int pwritev(int fd, const struct iovec *iov, int iovcnt, off_t offset){
+	struct iovec kiov[IOV_MAX];
+	struct file *file = fd_to_file(fd);
+	if (file == NULL || offset < 0
+			|| pin_iovec(kiov, iov, iovcnt, false) < 0){
+		return -1;
+	}
+	int write_size = (int) file_writev_at(file, kiov, iovcnt, offset);
+	unpin_iovec(kiov, iovcnt);
+	return write_size;
 }
-#else
 
 void close (int fd){
-	struct thread *curr = thread_current ();
-	if (fd < 2){
-		return;
-	}
-	struct file *closing_file = curr->fdt[fd];
-	if(closing_file != NULL){
-		file_close(curr->fdt[fd]);
-		curr->fdt[fd] = NULL;
-	}
+	ring_wait_idle ();
+	fd_close (&thread_current ()->fdt, fd);
+}
+
+int dup2(int oldfd, int newfd){
+	ring_wait_idle ();
+	return fd_dup2 (&thread_current ()->fdt, oldfd, newfd);
 }
+#ifdef VM
 
 void *
 mmap (void *addr, size_t length, int writable, int fd, off_t offset) {
@@ -386,15 +562,11 @@ mmap (void *addr, size_t length, int writable, int fd, off_t offset) {
 	if(offset % PGSIZE != 0){
 		return NULL;
 	}
-	struct thread *curr = thread_current ();
-	if(fd < 2){
-		return NULL;
-	}
-	if(curr->fdt[fd] == NULL){
+	struct file *file = fd_to_file(fd);
+	if(file == NULL){
 		return NULL;
 	}
-	struct file *file = curr->fdt[fd];
-	if (file_length(file) == 0 ){
+	if (file_length(file) <= 0 ){
 		return NULL;
 	}
 	if (length == 0 || (long)length < 0){
@@ -408,8 +580,397 @@ mmap (void *addr, size_t length, int writable, int fd, off_t offset) {
 
 void
 munmap (void *addr) {
+	struct thread *curr = thread_current ();
+	struct vma *vma;
+
 	check_addr(addr);
+	ring_wait_idle ();
+	/* A ring in the mapping is unregistered with it. */
+	vma = vma_find (&curr->spt, addr);
+	if (vma != NULL && ring_in_range (vma->start, vma->end)){
+		ring_release ();
+	}
 	do_munmap(addr);
 }
 
-#endif
\ No newline at end of file
+#endif
+
+/* A registered ring and the kernel thread that serves it.
+ *
+ * ring_enter() hands reads and writes of regular files to the
+ * worker and returns without waiting for them, so up to
+ * RING_ENTRIES of them can be in flight while the process runs.
+ * The worker runs on the owner's page table, so it reaches user
+ * memory directly; the ring and every buffer it touches are pinned
+ * by the owner beforehand and cannot fault.  Pins belong to the
+ * owner's SPT, so the owner also releases them, when it retires
+ * completed requests.
+ *
+ * Everything else (open, close, mmap, nop, and reads or writes of
+ * the console and pipes) changes the descriptor table or address
+ * space, or may block on the process itself.  Such an entry waits
+ * until every entry before it has completed and then runs in
+ * ring_enter(), which makes it a fence. */
+struct ring_worker {
+	struct ring *ring;          /* User ring, pinned while registered. */
+	struct thread *owner;       /* Process that registered the ring. */
+	struct lock lock;           /* Protects the fields below and CQ. */
+	struct condition changed;   /* A request was queued or completed. */
+	struct list pending;        /* Requests for the worker, in order. */
+	struct list done;           /* Completed requests, still pinned. */
+	int inflight;               /* Requests queued or running. */
+	bool dying;                 /* Worker should exit when idle. */
+	struct semaphore dead;      /* Upped when the worker is gone. */
+};
+
+/* A read or write handed to the worker. */
+struct ring_req {
+	struct list_elem elem;      /* In pending or done. */
+	struct ring_sqe sqe;        /* Copy of the submission. */
+	struct file *file;          /* File of SQE.FD. */
+};
+
+static void ring_worker (void *w_);
+
+/* Posts a completion for USER_DATA with result RES.  W's lock must
+ * be held. */
+static void
+ring_post (struct ring_worker *w, uint64_t user_data, int64_t res){
+	struct ring *ring = w->ring;
+	struct ring_cqe *cqe = &ring->cq[ring->cq_tail % RING_ENTRIES];
+
+	ASSERT (lock_held_by_current_thread (&w->lock));
+	cqe->user_data = user_data;
+	cqe->res = res;
+	/* The process must not see the new tail before the entry. */
+	barrier ();
+	ring->cq_tail++;
+}
+
+/* Drops the pins and frees the requests W has completed.  Must run
+ * in the owner's context. */
+static void
+ring_retire (struct ring_worker *w){
+	struct list done;
+
+	list_init (&done);
+	lock_acquire (&w->lock);
+	while (!list_empty (&w->done))
+		list_push_back (&done, list_pop_front (&w->done));
+	lock_release (&w->lock);
+
+	while (!list_empty (&done)){
+		struct ring_req *req = list_entry (list_pop_front (&done),
+				struct ring_req, elem);
+		unpin_user_pages ((void *) req->sqe.addr, req->sqe.len);
+		free (req);
+	}
+}
+
+/* Waits until the current process's ring has no request in flight
+ * and retires them.  Does nothing if no ring is registered.  Called
+ * before anything that could pull a file or page out from under the
+ * worker. */
+static void
+ring_wait_idle (void){
+	struct ring_worker *w = thread_current ()->ring;
+
+	if (w == NULL){
+		return;
+	}
+	lock_acquire (&w->lock);
+	while (w->inflight > 0){
+		cond_wait (&w->changed, &w->lock);
+	}
+	lock_release (&w->lock);
+	ring_retire (w);
+}
+
+#ifdef VM
+/* Returns true if the current process's ring overlaps [START, END). */
+static bool
+ring_in_range (const void *start, const void *end){
+	struct ring_worker *w = thread_current ()->ring;
+
+	return w != NULL && (void *) w->ring < end
+		&& (void *) (w->ring + 1) > start;
+}
+#endif
+
+/* Unregisters the current process's ring, if any, after the
+ * requests in flight have completed, and stops its worker. */
+void
+ring_release (void){
+	struct thread *curr = thread_current ();
+	struct ring_worker *w = curr->ring;
+
+	if (w == NULL){
+		return;
+	}
+	lock_acquire (&w->lock);
+	w->dying = true;
+	cond_broadcast (&w->changed, &w->lock);
+	lock_release (&w->lock);
+	sema_down (&w->dead);
+
+	ring_retire (w);
+	unpin_user_pages (w->ring, sizeof *w->ring);
+	curr->ring = NULL;
+	free (w);
+}
+
+/* Registers RING, which must be a struct ring in user memory, as
+ * the current process's ring, replacing any ring registered before,
+ * resets its indices and starts its worker.  The ring stays pinned
+ * until it is unregistered by exit, exec, munmap of its pages or
+ * another ring_setup(). */
+int ring_setup(struct ring *ring){
+	struct thread *curr = thread_current ();
+	struct ring_worker *w;
+
+	ring_release ();
+	if (!pin_user_pages(ring, sizeof *ring, true)){
+		exit(-1);
+	}
+	w = malloc (sizeof *w);
+	if (w == NULL){
+		unpin_user_pages(ring, sizeof *ring);
+		return -1;
+	}
+	ring->sq_head = ring->sq_tail = 0;
+	ring->cq_head = ring->cq_tail = 0;
+	w->ring = ring;
+	w->owner = curr;
+	lock_init (&w->lock);
+	cond_init (&w->changed);
+	list_init (&w->pending);
+	list_init (&w->done);
+	w->inflight = 0;
+	w->dying = false;
+	sema_init (&w->dead, 0);
+	if (thread_create ("ring", PRI_DEFAULT, ring_worker, w) == TID_ERROR){
+		unpin_user_pages(ring, sizeof *ring);
+		free (w);
+		return -1;
+	}
+	curr->ring = w;
+	return 0;
+}
+
+/* Runs the operation described by SQE in the caller's context and
+ * returns its result. */
+static int64_t
+ring_execute (const struct ring_sqe *sqe){
+	void *addr = (void *) sqe->addr;
+	struct file *file;
+	int64_t res;
+
+	switch (sqe->opcode){
+		case RING_OP_NOP:
+			return 0;
+
+		case RING_OP_READ:
+		case RING_OP_WRITE:
+			if (sqe->off < 0){
+				return sqe->opcode == RING_OP_READ
+					? read(sqe->fd, addr, sqe->len)
+					: write(sqe->fd, addr, sqe->len);
+			}
+			file = fd_to_file(sqe->fd);
+			if (file == NULL){
+				return -1;
+			}
+			if (!pin_user_pages(addr, sqe->len, sqe->opcode == RING_OP_READ)){
+				exit(-1);
+			}
+			res = sqe->opcode == RING_OP_READ
+				? file_read_at(file, addr, sqe->len, sqe->off)
+				: file_write_at(file, addr, sqe->len, sqe->off);
+			unpin_user_pages(addr, sqe->len);
+			return res;
+
+		case RING_OP_OPEN:
+			return open(addr);
+
+		case RING_OP_CLOSE:
+			close(sqe->fd);
+			return 0;
+#ifdef VM
+		case RING_OP_MMAP:
+			return (int64_t) mmap(addr, sqe->len,
+					(sqe->flags & RING_F_WRITABLE) != 0, sqe->fd, sqe->off);
+#endif
+		default:
+			return -1;
+	}
+}
+
+/* Returns the regular file SQE reads or writes, if the worker can
+ * run SQE, or NULL if SQE must run in ring_enter().  Requests at the
+ * file position run in ring_enter() too, since the position is not
+ * protected against the owner's own read(), write() and seek(). */
+static struct file *
+ring_async_file (const struct ring_sqe *sqe){
+	struct file *file;
+
+	if (sqe->opcode != RING_OP_READ && sqe->opcode != RING_OP_WRITE){
+		return NULL;
+	}
+	if (sqe->off < 0){
+		return NULL;
+	}
+	file = fd_to_file(sqe->fd);
+	return file != NULL && file_get_pipe (file) == NULL ? file : NULL;
+}
+
+/* Runs REQ in the worker and returns its result. */
+static int64_t
+ring_do_io (const struct ring_req *req){
+	const struct ring_sqe *sqe = &req->sqe;
+	void *addr = (void *) sqe->addr;
+
+	ASSERT (sqe->off >= 0);
+	if (sqe->opcode == RING_OP_READ){
+		return file_read_at(req->file, addr, sqe->len, sqe->off);
+	}
+	return file_write_at(req->file, addr, sqe->len, sqe->off);
+}
+
+/* Serves the ring W until ring_release(): runs queued requests in
+ * order and posts their completions. */
+static void
+ring_worker (void *w_){
+	struct ring_worker *w = w_;
+	struct thread *curr = thread_current ();
+	enum intr_level old_level;
+
+	/* Borrow the owner's address space, see struct ring_worker. */
+	old_level = intr_disable ();
+	curr->pml4 = w->owner->pml4;
+	process_activate (curr);
+	intr_set_level (old_level);
+
+	lock_acquire (&w->lock);
+	for (;;){
+		while (list_empty (&w->pending) && !w->dying){
+			cond_wait (&w->changed, &w->lock);
+		}
+		if (list_empty (&w->pending)){
+			break;
+		}
+		struct ring_req *req = list_entry (list_pop_front (&w->pending),
+				struct ring_req, elem);
+		lock_release (&w->lock);
+		int64_t res = ring_do_io (req);
+		lock_acquire (&w->lock);
+		ring_post (w, req->sqe.user_data, res);
+		list_push_back (&w->done, &req->elem);
+		w->inflight--;
+		cond_broadcast (&w->changed, &w->lock);
+	}
+	lock_release (&w->lock);
+
+	/* Give the address space back before the owner may destroy it. */
+	old_level = intr_disable ();
+	curr->pml4 = NULL;
+	process_activate (curr);
+	intr_set_level (old_level);
+	sema_up (&w->dead);
+}
+
+/* Consumes the submitted entries of the current process's ring, in
+ * order, and returns the number consumed, or -1 if no ring is
+ * registered.  Reads and writes of regular files are queued for the
+ * worker and complete later; any other entry first waits for the
+ * entries before it and completes before this returns.  Stops early
+ * so that the completion queue cannot overflow. */
+int ring_enter(void){
+	struct ring_worker *w = thread_current()->ring;
+	struct ring *ring;
+	int done = 0;
+
+	if (w == NULL){
+		return -1;
+	}
+	ring = w->ring;
+	ring_retire (w);
+	for (;;){
+		struct ring_sqe sqe;
+		struct file *file;
+
+		lock_acquire (&w->lock);
+		if (ring->sq_head == ring->sq_tail
+				|| ring->cq_tail - ring->cq_head + w->inflight >= RING_ENTRIES){
+			lock_release (&w->lock);
+			break;
+		}
+		/* Copy the entry so the process cannot change it under us. */
+		sqe = ring->sq[ring->sq_head % RING_ENTRIES];
+		ring->sq_head++;
+		lock_release (&w->lock);
+
+		file = ring_async_file (&sqe);
+		if (file != NULL){
+			struct ring_req *req = malloc (sizeof *req);
+			if (req == NULL){
+				lock_acquire (&w->lock);
+				ring_post (w, sqe.user_data, -1);
+				lock_release (&w->lock);
+			} else {
+				if (!pin_user_pages ((void *) sqe.addr, sqe.len,
+							sqe.opcode == RING_OP_READ)){
+					free (req);
+					exit(-1);
+				}
+				req->sqe = sqe;
+				req->file = file;
+				lock_acquire (&w->lock);
+				list_push_back (&w->pending, &req->elem);
+				w->inflight++;
+				cond_broadcast (&w->changed, &w->lock);
+				lock_release (&w->lock);
+			}
+		} else {
+			int64_t res;
+
+			ring_wait_idle ();
+			res = ring_execute (&sqe);
+			lock_acquire (&w->lock);
+			ring_post (w, sqe.user_data, res);
+			lock_release (&w->lock);
+		}
+		done++;
+	}
+	return done;
+}
+
+static void
+inspect_syscall_cnt (struct intr_frame *f) {
+	f->R.rax = syscall_cnt;
+}
+
+static void
+inspect_extents (struct intr_frame *f) {
+	struct file *file = fd_to_file (f->R.rdx);
+
+	f->R.rax = file != NULL
+		? (long long) inode_extent_cnt (file_get_inode (file)) : -1;
+}
+
+/* Tool for testing system call batching. Calling this function via int 0x47.
+ * Output:
+ *   @RAX - Number of system calls since boot.
+ *
+ * Tool for testing file layout. Calling this function via int 0x4d.
+ * Input:
+ *   @RDX - File descriptor.
+ * Output:
+ *   @RAX - Number of runs of consecutive sectors that the file's data
+ *          occupies, or -1 if the descriptor is not a file. */
+void
+register_syscall_inspect_intr (void) {
+	intr_register_int (0x47, 3, INTR_OFF, inspect_syscall_cnt,
+			"Inspect Syscall Count");
+	intr_register_int (0x4d, 3, INTR_ON, inspect_extents,
+			"Inspect File Extents");
+}
@@ -0,0 +1,103 @@
+/* uaccess.c: Kernel access to user memory.
+ *
+ * A user range is validated once, page by page, against the page
+ * table (or, with VM, the SPT and VMAs) and its pages are pinned
+ * for the duration of the access.  The kernel can then copy to or
+ * from the range, or hand it to the file system for I/O, without
+ * faulting while it holds locks and without a per-byte check. */
+
+#include "userprog/uaccess.h"
+#include <stdint.h>
+#include <string.h>
+#include "threads/mmu.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#ifdef VM
+#include "vm/vm.h"
+#endif
+
+/* Returns true if [UADDR, UADDR + SIZE) lies entirely in user
+ * space. */
+static bool
+is_user_range (const void *uaddr, size_t size) {
+	uintptr_t start = (uintptr_t) uaddr;
+
+	return uaddr != NULL && start + size >= start
+		&& is_user_vaddr (uaddr) && is_user_vaddr (uaddr + size - 1);
+}
+
+/* Unpins the pages from the one containing START up to, but not
+ * including, the page at END. */
+static void
+unpin_range (const void *start, const void *end) {
+#ifdef VM
+	const void *p;
+
+	for (p = pg_round_down (start); p < end; p += PGSIZE)
+		vm_unpin_page ((void *) p);
+#else
+	(void) start;
+	(void) end;
+#endif
+}
+
+/* Validates every page of the SIZE-byte user range at UADDR for
+ * reading, or for writing if WRITE, and pins them until
+ * unpin_user_pages().  Missing pages are brought in.  Returns false,
+ * with nothing pinned, if any page is invalid.  An empty range is
+ * always valid. */
+bool
+pin_user_pages (const void *uaddr, size_t size, bool write) {
+	const void *p;
+
+	if (size == 0)
+		return true;
+	if (!is_user_range (uaddr, size))
+		return false;
+
+	for (p = pg_round_down (uaddr); p < uaddr + size; p += PGSIZE) {
+#ifdef VM
+		bool ok = vm_pin_page ((void *) p, write);
+#else
+		/* Without VM every valid user page is always resident. */
+		uint64_t *pte = pml4e_walk (thread_current ()->pml4, (uint64_t) p, 0);
+		bool ok = pte != NULL && (*pte & PTE_P) && is_user_pte (pte)
+			&& (!write || is_writable (pte));
+#endif
+		if (!ok) {
+			unpin_range (uaddr, p);
+			return false;
+		}
+	}
+	return true;
+}
+
+/* Releases the pins taken by pin_user_pages() on the same range. */
+void
+unpin_user_pages (const void *uaddr, size_t size) {
+	if (size > 0)
+		unpin_range (uaddr, uaddr + size);
+}
+
+/* Copies SIZE bytes from user address USRC to kernel buffer DST.
+ * Returns false, copying nothing, if the user range is invalid. */
+bool
+copy_from_user (void *dst, const void *usrc, size_t size) {
+	if (!pin_user_pages (usrc, size, false))
+		return false;
+	memcpy (dst, usrc, size);
+	unpin_user_pages (usrc, size);
+	return true;
+}
+
+/* Copies SIZE bytes from kernel buffer SRC to user address UDST.
+ * Returns false, copying nothing, if the user range is invalid or
+ * not writable. */
+bool
+copy_to_user (void *udst, const void *src, size_t size) {
+	if (!pin_user_pages (udst, size, true))
+		return false;
+	memcpy (udst, src, size);
+	unpin_user_pages (udst, size);
+	return true;
+}
@@ -39,6 +39,7 @@ anon_initializer (struct page *page, enum vm_type type, void *kva) {
 	anon_page->swap_idx = -1;
 	list_push_back(&frame_list,&page->frame_elem);
 	clock_buffer_elem = &page->frame_elem;
+	return true;
 }
 
 /* Swap in the page by read contents from the swap disk. */
@@ -97,7 +98,7 @@ anon_swap_out (struct page *page) {
 	anon_page->swap_idx = (int)swap_idx;
 
 	page->frame->kva = NULL;
-	pml4_clear_page(thread_current()->pml4,page->va);
+	pml4_clear_page(page->thread->pml4,page->va);
 
 	vm_remove_frame(page);
 	anon_page->type = (VM_SWAP|type);
@@ -5,10 +5,6 @@
 #include "include/lib/stdio.h"
 #include "vm/file.h"
 
-static bool
-load_file_page (struct file *file_origin, off_t ofs, uint8_t *upage,
-		uint32_t read_bytes, uint32_t zero_bytes, bool writable);
-
 static bool file_backed_swap_in (struct page *page, void *kva);
 static bool file_backed_swap_out (struct page *page);
 static void file_backed_destroy (struct page *page);
@@ -70,9 +66,7 @@ file_backed_swap_out (struct page *page) {
 	}
 	struct thread *curr = thread_current();
 	if(pml4_is_dirty(curr->pml4,page->va) && file_page->page_read_bytes > 0){
-		lock_acquire(&filesys_lock);
 		file_write_at(file_page->file,page->frame->kva,file_page->page_read_bytes,file_page->ofs);
-		lock_release(&filesys_lock);
 		pml4_set_dirty(curr->pml4,page->va,0);
 	}
 	page->frame->kva = NULL;
@@ -90,16 +84,14 @@ file_backed_destroy (struct page *page) {
 	struct file_page *file_page = &page->file;
 	if(!(page->file.type & VM_DISK)){
 		if(pml4_is_dirty(page->thread->pml4,page->va) && file_page->page_read_bytes > 0){
-			lock_acquire(&filesys_lock);
 			file_write_at(file_page->file,page->frame->kva,file_page->page_read_bytes,file_page->ofs);
-			lock_release(&filesys_lock);
 			pml4_set_dirty(page->thread->pml4,page->va,0);
 		}
 		palloc_free_page(page->frame->kva);
 		pml4_clear_page(page->thread->pml4,page->va);
 		vm_remove_frame(page);
 	}
-	file_close(file_page->file);
+	/* The file belongs to the page's VMA and is closed with it. */
 	free(page->frame);
 }
 
@@ -116,76 +108,28 @@ do_mmap (void *addr, size_t length, int writable,
 		printf("NULL point denied\n");
 		return NULL;
 	}
-	if(addr <= USER_STACK && addr >= curr->stack_bottom){
+	void *end = pg_round_up(addr + length);
+	if(end <= addr || !is_user_vaddr(end - 1)){
 		return NULL;
 	}
-
-	void *check_addr = addr;
-
-	do{
-		if(spt_find_page(&curr->spt,check_addr) == NULL){
-			check_addr += PGSIZE;
-		}
-		else{
-			return NULL;
-		}
-	}while(check_addr < addr + length);
-
-	size_t read_bytes = length>(file_length(file)-offset)?file_length(file)-offset:length;
-	size_t zero_bytes = length>(file_length(file)-offset)?length-(file_length(file)-offset):ROUND_UP(read_bytes,PGSIZE)-read_bytes;
-
-	if(load_file_page(file,offset,addr,read_bytes,zero_bytes,writable)){
-		return addr;
+	if(addr < (void *) USER_STACK && end > curr->stack_bottom){
+		return NULL;
 	}
-	else{
+	/* Existing pages all belong to a VMA or to the stack, so one
+	 * interval query covers the whole range. */
+	if(vma_overlaps(&curr->spt,addr,end)){
 		return NULL;
 	}
-}
 
-static bool
-load_file_page (struct file *file_origin, off_t ofs, uint8_t *upage,
-		uint32_t read_bytes, uint32_t zero_bytes, bool writable) {
-	ASSERT ((read_bytes + zero_bytes) % PGSIZE == 0);
-	ASSERT (pg_ofs (upage) == 0);
-	ASSERT (ofs % PGSIZE == 0);
-	void *start_upage = upage;
-	while (read_bytes > 0 || zero_bytes > 0) {
-		struct file *file = file_reopen(file_origin);
-		size_t page_read_bytes = read_bytes < PGSIZE ? read_bytes : PGSIZE;
-		size_t page_zero_bytes = PGSIZE - page_read_bytes;
-
-		struct load_info *load_info = (struct load_info *)malloc(sizeof(struct load_info));
-		if(load_info == NULL){
-			file_close(file);
-			return false;
-		}
-		load_info->file = file;
-		load_info->page_read_bytes = page_read_bytes;
-		load_info->page_zero_bytes = page_zero_bytes;
-		load_info->ofs = ofs;
-		//mmap 요청 시작 주소의 페이지에 마킹해두기
-		if(start_upage == upage){
-			if(!vm_alloc_page_with_initializer(VM_FILE|VM_MARKER_1,upage,writable,lazy_load_file_segment,load_info)){
-				file_close(file);
-				free(load_info);
-				return false;
-			}
-		}
-		else{
-			if(!vm_alloc_page_with_initializer(VM_FILE,upage,writable,lazy_load_file_segment,load_info)){
-				file_close(file);
-				free(load_info);
-				return false;
-			}
-		}
-		
-		/* Advance. */
-		read_bytes -= page_read_bytes;
-		zero_bytes -= page_zero_bytes;
-		upage += PGSIZE;
-		ofs += page_read_bytes;
+	off_t flen = file_length(file);
+	size_t read_bytes = offset < flen ? (size_t)(flen - offset) : 0;
+	if(read_bytes > length){
+		read_bytes = length;
 	}
-	return true;
+	if(vma_create(&curr->spt,addr,length,VM_FILE,file,offset,read_bytes,writable) == NULL){
+		return NULL;
+	}
+	return addr;
 }
 
 bool
@@ -223,33 +167,22 @@ lazy_load_file_segment (struct page *page, void *aux) {
 /* Do the munmap */
 void
 do_munmap (void *addr) {
-	// int i = 0;
 	struct thread *curr = thread_current();
-	struct page *page = spt_find_page(&curr->spt,addr);
-	if(page == NULL){
-		return;
-	}
-	if(page_get_type(page) != VM_FILE){
-		return;
-	}
-	if(page->operations->type == VM_UNINIT && page->uninit.type != (VM_FILE|VM_MARKER_1)){
+	struct vma *vma = vma_find(&curr->spt,addr);
+	if(vma == NULL || vma->start != addr || VM_TYPE(vma->type) != VM_FILE
+			|| (vma->type & VM_SHARED)){
 		return;
 	}
-	if(page->file.type != (VM_FILE|VM_MARKER_1)){
-		return;
-	}
-	do{
-		struct hash_elem *deleting_hash = &page->spt_elem;
-		if(hash_delete(&curr->spt.pages,&page->spt_elem) != deleting_hash){
-			return;
+	/* Only pages that were touched exist; the rest of the mapping
+	 * lives in the VMA alone. */
+	for(void *upage = vma->start; upage < vma->end; upage += PGSIZE){
+		struct page *page = spt_find_page(&curr->spt,upage);
+		if(page == NULL){
+			continue;
 		}
 		sema_down(&swap_sema);
 		spt_remove_page(&curr->spt,page);
 		sema_up(&swap_sema);
-		addr += PGSIZE;
-		page = spt_find_page(&curr->spt,addr);
-		if(page == NULL){
-			return;
-		}
-	}while((page->operations->type == VM_FILE && page->file.type == VM_FILE) || (page->operations->type == VM_UNINIT && page->uninit.type == VM_FILE));
+	}
+	vma_destroy(&curr->spt,vma);
 }
@@ -0,0 +1,156 @@
+/* share.c: Text cache, the read-only pages of executables shared
+ * between processes.
+ *
+ * Pages of an executable's PT_LOAD segments are not read into a
+ * private frame per process.  A read fault maps the one frame that
+ * holds the page for (inode, offset) instead, reading it from the
+ * file only if no process has it mapped.  Read-only segments stay
+ * shared for their lifetime; a write to a page of a writable data
+ * segment gives that page a private anonymous copy first (see
+ * vm_handle_wp()).
+ *
+ * Shared frames are not on the frame list and so are never evicted:
+ * a frame goes away with the last page that maps it.  The executable
+ * is write-denied while it runs, so cached contents never go stale.
+ * All functions here must be called with swap_sema held. */
+
+#include "vm/vm.h"
+#include "vm/share.h"
+#include "filesys/inode.h"
+#include "threads/malloc.h"
+#include "threads/mmu.h"
+
+static bool share_swap_in (struct page *page, void *kva);
+static bool share_swap_out (struct page *page);
+static void share_destroy (struct page *page);
+
+static const struct page_operations share_ops = {
+	.swap_in = share_swap_in,
+	.swap_out = share_swap_out,
+	.destroy = share_destroy,
+	.type = VM_FILE | VM_SHARED,
+};
+
+/* Every shared frame, keyed by inode, offset and length. */
+static struct hash share_table;
+
+static uint64_t share_hash (const struct hash_elem *e, void *aux UNUSED);
+static bool share_less (const struct hash_elem *a_,
+		const struct hash_elem *b_, void *aux UNUSED);
+
+/* Initializes the text cache. */
+void
+vm_share_init (void) {
+	hash_init (&share_table, share_hash, share_less, NULL);
+}
+
+/* Returns the cached frame for READ_BYTES bytes of INODE at OFS
+ * with a new reference, or NULL if the page is not cached. */
+struct share_entry *
+share_get (struct inode *inode, off_t ofs, size_t read_bytes) {
+	struct share_entry key = {
+		.inode = inode, .ofs = ofs, .read_bytes = read_bytes,
+	};
+	struct hash_elem *e = hash_find (&share_table, &key.elem);
+
+	if (e == NULL)
+		return NULL;
+	struct share_entry *entry = hash_entry (e, struct share_entry, elem);
+	entry->map_cnt++;
+	return entry;
+}
+
+/* Enters KVA, already filled with READ_BYTES bytes of INODE at OFS,
+ * into the cache with one reference.  The cache takes over KVA.
+ * Returns NULL if memory allocation fails. */
+struct share_entry *
+share_add (struct inode *inode, off_t ofs, size_t read_bytes, void *kva) {
+	struct share_entry *entry = malloc (sizeof *entry);
+
+	if (entry == NULL)
+		return NULL;
+	entry->inode = inode_reopen (inode);
+	entry->ofs = ofs;
+	entry->read_bytes = read_bytes;
+	entry->kva = kva;
+	entry->map_cnt = 1;
+	hash_insert (&share_table, &entry->elem);
+	return entry;
+}
+
+/* Takes another reference to ENTRY. */
+void
+share_ref (struct share_entry *entry) {
+	entry->map_cnt++;
+}
+
+/* Drops a reference to ENTRY, freeing the frame with the last. */
+void
+share_put (struct share_entry *entry) {
+	ASSERT (entry->map_cnt > 0);
+	if (--entry->map_cnt > 0)
+		return;
+	hash_delete (&share_table, &entry->elem);
+	palloc_free_page (entry->kva);
+	inode_close (entry->inode);
+	free (entry);
+}
+
+/* Turns PAGE into a page mapped from ENTRY, whose reference PAGE
+ * takes over. */
+void
+share_initializer (struct page *page, struct share_entry *entry) {
+	page->operations = &share_ops;
+	page->share.entry = entry;
+}
+
+/* Returns true if PAGE is mapped from the text cache. */
+bool
+page_is_shared (const struct page *page) {
+	return page->operations == &share_ops;
+}
+
+/* Shared pages stay mapped until destroyed, so they never come
+ * back in. */
+static bool
+share_swap_in (struct page *page UNUSED, void *kva UNUSED) {
+	return false;
+}
+
+/* Shared frames are not on the frame list and are never chosen
+ * for eviction. */
+static bool
+share_swap_out (struct page *page UNUSED) {
+	return false;
+}
+
+/* Unmaps PAGE and drops its reference.  PAGE will be freed by the
+ * caller. */
+static void
+share_destroy (struct page *page) {
+	pml4_clear_page (page->thread->pml4, page->va);
+	share_put (page->share.entry);
+	free (page->frame);
+}
+
+static uint64_t
+share_hash (const struct hash_elem *e, void *aux UNUSED) {
+	const struct share_entry *entry = hash_entry (e, struct share_entry, elem);
+	uint64_t key[2] = { (uint64_t) entry->inode,
+		((uint64_t) entry->ofs << 16) ^ entry->read_bytes };
+
+	return hash_bytes (key, sizeof key);
+}
+
+static bool
+share_less (const struct hash_elem *a_, const struct hash_elem *b_,
+		void *aux UNUSED) {
+	const struct share_entry *a = hash_entry (a_, struct share_entry, elem);
+	const struct share_entry *b = hash_entry (b_, struct share_entry, elem);
+
+	if (a->inode != b->inode)
+		return a->inode < b->inode;
+	if (a->ofs != b->ofs)
+		return a->ofs < b->ofs;
+	return a->read_bytes < b->read_bytes;
+}
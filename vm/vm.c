@@ -12,11 +12,28 @@
 
 
 
-bool
-page_less (const struct hash_elem *a_,const struct hash_elem *b_, void *aux UNUSED);
-
-unsigned
-page_hash (const struct hash_elem *p_, void *aux UNUSED);
+/* The supplemental page table is a radix tree with the shape of the
+ * x86-64 page table: four levels of 512-entry nodes indexed by the
+ * same va bits that pml4e_walk() uses, with struct page pointers in
+ * the leaves.  Nodes are palloc'd pages and only exist for populated
+ * parts of the address space, so lookups touch four cache lines,
+ * iteration runs in address order and teardown only visits live
+ * nodes.  A node is freed as soon as its last entry is cleared, so
+ * mapping and unmapping does not accumulate empty nodes. */
+#define SPT_LEVELS 4
+#define SPT_ENTRIES (PGSIZE / sizeof (void *))
+
+/* Performs some operation on PAGE, given auxiliary data AUX.
+ * Returning false stops the walk. */
+typedef bool spt_action_func (struct page *page, void *aux);
+
+static struct page **spt_slot (struct supplemental_page_table *spt,
+		const void *va, bool create);
+static bool spt_walk (void **node, int level, spt_action_func *action,
+		void *aux);
+static void spt_prune (struct supplemental_page_table *spt, const void *va);
+static void spt_destroy (void **node, int level);
+static bool spt_copy_page (struct page *cp_page, void *dst_);
 
 /* Initializes the virtual memory subsystem by invoking each subsystem's
  * intialize codes. */
@@ -32,6 +49,7 @@ vm_init (void) {
 	register_inspect_intr ();
 	/* DO NOT MODIFY UPPER LINES. */
 	/* TODO: Your code goes here. */
+	vm_share_init ();
 }
 
 /* Get the type of the page. This function is useful if you want to know the
@@ -99,17 +117,9 @@ err:
 /* Find VA from spt and return page. On error, return NULL. */
 struct page *
 spt_find_page (struct supplemental_page_table *spt UNUSED, void *va UNUSED) {
-	struct page *page = NULL;
-	page = malloc(sizeof(struct page));
-	struct hash_elem *elem;
-	
-	page -> va = pg_round_down(va);
-	elem = hash_find(&spt->pages,&page->spt_elem);
-	if(elem == NULL){
-		return NULL;
-	}
-	free(page);
-	return hash_entry(elem,struct page,spt_elem);
+	/* Runs on every fault, so it must not allocate. */
+	struct page **slot = spt_slot(spt,va,false);
+	return slot != NULL ? *slot : NULL;
 }
 
 /* Insert PAGE into spt with validation. */
@@ -117,48 +127,71 @@ bool
 spt_insert_page (struct supplemental_page_table *spt UNUSED,
 		struct page *page UNUSED) {
 	int succ = false;
-	// struct hash_elem *hash_elem;
 	/* TODO: Fill this function. */
-	if((hash_insert(&spt->pages,&page->spt_elem)) == NULL){
+	struct page **slot = spt_slot(spt,page->va,true);
+	if(slot != NULL && *slot == NULL){
+		*slot = page;
 		succ = true;
 	}
+	else if(slot == NULL){
+		/* Drop the part of the path that was allocated. */
+		spt_prune(spt,page->va);
+	}
 	return succ;
 }
 
 void
 spt_remove_page (struct supplemental_page_table *spt, struct page *page) {
+	struct page **slot = spt_slot (spt, page->va, false);
+	if (slot != NULL && *slot == page) {
+		*slot = NULL;
+		spt_prune (spt, page->va);
+	}
 	vm_dealloc_page (page);
-	return true;
 }
 
-/* Get the struct frame, that will be evicted. */
+/* Get the struct frame, that will be evicted.  Returns NULL if
+ * every frame is pinned. */
 static struct frame *
 vm_get_victim (void) {
 	struct page *victim_page = clock_evict_policy();
-	struct frame *victim = victim_page->frame;
 	 /* TODO: The policy for eviction is up to you. */
 	
-	return victim;
+	return victim_page != NULL ? victim_page->frame : NULL;
 }
 
+/* Advances the clock hand to the next unpinned page that was not
+ * accessed since the hand last passed it and returns that page.
+ * The first pass over the frames may only clear accessed bits, so
+ * the hand goes around at most twice; if it finds nothing by then
+ * every frame is pinned and NULL is returned. */
 static struct page *clock_evict_policy (void) {
-	struct list_elem *elem;
-	struct list_elem *start_elem = clock_buffer_elem;
+	struct list_elem *elem = clock_buffer_elem;
 	struct page *evict_page = NULL;
-	do{
-		for(elem = start_elem->next;elem != list_end(&frame_list);list_next(elem)){
-			evict_page = list_entry(elem,struct page,frame_elem);
-			if(pml4_is_accessed(evict_page->thread->pml4,evict_page->va)){
-				pml4_set_accessed(evict_page->thread->pml4,evict_page->va,false);
-			}
-			else{
-				clock_buffer_elem = elem != list_begin(&frame_list) ? elem->prev:list_end(&frame_list)->prev;
-				return evict_page;
-			}
+	size_t scan_cnt;
+
+	if(list_empty(&frame_list)){
+		return NULL;
+	}
+	for(scan_cnt = 2 * list_size(&frame_list); scan_cnt > 0; scan_cnt--){
+		elem = list_next(elem);
+		if(elem == list_end(&frame_list)){
+			elem = list_begin(&frame_list);
 		}
-		start_elem = list_head(&frame_list);
-	}while(true);
-	
+		evict_page = list_entry(elem,struct page,frame_elem);
+		if(evict_page->pin_cnt > 0){
+			/* The kernel is doing I/O on it. */
+			continue;
+		}
+		if(pml4_is_accessed(evict_page->thread->pml4,evict_page->va)){
+			pml4_set_accessed(evict_page->thread->pml4,evict_page->va,false);
+		}
+		else{
+			clock_buffer_elem = elem != list_begin(&frame_list) ? elem->prev:list_end(&frame_list)->prev;
+			return evict_page;
+		}
+	}
+	return NULL;
 }
 
 /* Evict one page and return the corresponding frame.
@@ -166,6 +199,9 @@ static struct page *clock_evict_policy (void) {
 static struct frame *
 vm_evict_frame (void) {
 	struct frame *victim UNUSED = vm_get_victim ();
+	if(victim == NULL){
+		return NULL;
+	}
 	struct page *victim_page = victim->page;
 	void *kva = victim->kva;
 	/* TODO: swap out the victim and return the evicted frame. */
@@ -174,20 +210,26 @@ vm_evict_frame (void) {
 }
 
 /* palloc() and get frame. If there is no available page, evict(내쫓다) the page
- * and return it. This always return valid address. That is, if the user pool
- * memory is full, this function evicts the frame to get the available memory
- * space.*/
+ * and return it. That is, if the user pool memory is full, this function
+ * evicts the frame to get the available memory space.  Returns NULL if
+ * that fails too, which happens when every frame is pinned. */
 static struct frame *
 vm_get_frame (void) {
 	struct frame *frame = NULL;
 	frame = (struct frame *)malloc(sizeof(struct frame));
+	if(frame == NULL){
+		return NULL;
+	}
 	/* TODO: Fill this function. */
 	frame->kva = palloc_get_page(PAL_USER|PAL_ZERO);
 	frame->page = NULL;
 	if(frame->kva == NULL){
 		frame->kva = vm_evict_frame();
 	}
-	ASSERT (frame != NULL);
+	if(frame->kva == NULL){
+		free(frame);
+		return NULL;
+	}
 	ASSERT (frame->page == NULL);
 	return frame;
 }
@@ -207,9 +249,34 @@ vm_stack_growth (void *addr UNUSED) {
 	
 }
 
-/* Handle the fault on write_protected page */
+/* Handle the fault on write_protected page.  A writable page that
+ * is still mapped from the text cache gets a private anonymous copy
+ * of the shared frame. */
 static bool
-vm_handle_wp (struct page *page UNUSED) {
+vm_handle_wp (struct page *page) {
+	struct thread *curr = thread_current ();
+	bool success = false;
+
+	sema_down (&swap_sema);
+	if (page_is_shared (page) && page->writable) {
+		struct share_entry *entry = page->share.entry;
+		struct frame *frame = vm_get_frame ();
+		if (frame == NULL) {
+			sema_up (&swap_sema);
+			return false;
+		}
+
+		memcpy (frame->kva, entry->kva, PGSIZE);
+		pml4_clear_page (curr->pml4, page->va);
+		free (page->frame);
+		anon_initializer (page, VM_ANON, frame->kva);
+		frame->page = page;
+		page->frame = frame;
+		share_put (entry);
+		success = pml4_set_page (curr->pml4, page->va, frame->kva, true);
+	}
+	sema_up (&swap_sema);
+	return success;
 }
 
 /* Return true on success */
@@ -221,7 +288,10 @@ vm_try_handle_fault (struct intr_frame *f UNUSED, void *addr UNUSED,
 	struct page *page = NULL;
 
 	if(!not_present){
-		return false;
+		/* Only a write to a page shared with the text cache can be
+		 * resolved. */
+		page = write ? spt_find_page(spt,addr) : NULL;
+		return page != NULL && vm_handle_wp(page);
 	}
 	if(user){
 		if(!is_user_vaddr(addr) || addr == NULL){
@@ -231,6 +301,13 @@ vm_try_handle_fault (struct intr_frame *f UNUSED, void *addr UNUSED,
 	
 	page = spt_find_page(spt,addr);
 	if(page == NULL){
+		/* Pages of a VMA are created on their first fault. */
+		struct vma *vma = vma_find (spt, addr);
+		if (vma != NULL) {
+			if (write && !vma->writable)
+				return false;
+			return vma_claim_page (vma, pg_round_down (addr), write);
+		}
 		if((user && addr >= f->rsp-8 )||(!user && addr >= curr->curr_rsp-8 )){
 			if(curr->stack_bottom >= USER_STACK - stack_growth_limit+PGSIZE && addr <= USER_STACK){
 				vm_stack_growth(addr);
@@ -264,11 +341,199 @@ vm_claim_page (void *va UNUSED) {
 	return vm_do_claim_page (page);
 }
 
+/* Claims the HUGE_PGSIZE-aligned run of pages at UPAGE as zeroed
+ * anonymous pages in one huge frame, mapped by a single PDE.  Each
+ * page still has its own struct page and struct frame, so fork and
+ * eviction handle them like any other page; evicting one of them
+ * splits the mapping.  Returns false and leaves nothing behind if a
+ * page of the run already exists or no aligned frame is free, in
+ * which case the caller falls back to ordinary pages. */
+bool
+vm_claim_huge_page (void *upage, bool writable) {
+	struct thread *curr = thread_current ();
+	struct supplemental_page_table *spt = &curr->spt;
+	size_t i;
+
+	ASSERT ((uint64_t) upage % HUGE_PGSIZE == 0);
+
+	for (i = 0; i < HUGE_PGCNT; i++)
+		if (spt_find_page (spt, upage + i * PGSIZE) != NULL)
+			return false;
+
+	uint8_t *kva = palloc_get_huge_page (PAL_USER | PAL_ZERO);
+	if (kva == NULL)
+		return false;
+
+	sema_down (&swap_sema);
+	for (i = 0; i < HUGE_PGCNT; i++) {
+		void *va = upage + i * PGSIZE;
+		if (!vm_alloc_page (VM_ANON, va, writable))
+			break;
+		struct page *page = spt_find_page (spt, va);
+		struct frame *frame = malloc (sizeof *frame);
+		if (frame == NULL) {
+			spt_remove_page (spt, page);
+			break;
+		}
+		frame->kva = kva + i * PGSIZE;
+		frame->page = page;
+		page->frame = frame;
+		swap_in (page, frame->kva);
+	}
+	if (i == HUGE_PGCNT && pml4_set_huge_page (curr->pml4, upage, kva, writable)) {
+		sema_up (&swap_sema);
+		return true;
+	}
+
+	/* None of the pages was mapped yet, so they simply go away. */
+	while (i-- > 0)
+		spt_remove_page (spt, spt_find_page (spt, upage + i * PGSIZE));
+	sema_up (&swap_sema);
+	palloc_free_multiple (kva, HUGE_PGCNT);
+	return false;
+}
+
+/* Maps UPAGE read-only to the text cache's frame for READ_BYTES
+ * bytes of FILE at OFS, reading the frame in first if no process
+ * has it mapped.  If WRITABLE, the first write to the page replaces
+ * the mapping with a private copy, see vm_handle_wp(). */
+bool
+vm_claim_shared_page (void *upage, struct file *file, off_t ofs,
+		size_t read_bytes, bool writable) {
+	struct thread *curr = thread_current ();
+	struct inode *inode = file_get_inode (file);
+	struct share_entry *entry;
+	struct frame *frame;
+
+	struct page *page = malloc (sizeof *page);
+	if (page == NULL)
+		return false;
+
+	sema_down (&swap_sema);
+	entry = share_get (inode, ofs, read_bytes);
+	if (entry != NULL) {
+		frame = malloc (sizeof *frame);
+		if (frame == NULL)
+			goto fail_put;
+		frame->kva = entry->kva;
+	} else {
+		frame = vm_get_frame ();
+		if (frame == NULL)
+			goto fail_free;
+		if (file_read_at (file, frame->kva, read_bytes, ofs) != (off_t) read_bytes) {
+			palloc_free_page (frame->kva);
+			goto fail_free;
+		}
+		memset (frame->kva + read_bytes, 0, PGSIZE - read_bytes);
+		entry = share_add (inode, ofs, read_bytes, frame->kva);
+		if (entry == NULL) {
+			palloc_free_page (frame->kva);
+			goto fail_free;
+		}
+	}
+
+	*page = (struct page) {
+		.va = upage,
+		.thread = curr,
+		.writable = writable,
+	};
+	share_initializer (page, entry);
+	frame->page = page;
+	page->frame = frame;
+	if (!spt_insert_page (&curr->spt, page))
+		goto fail_put;
+	if (!pml4_set_page (curr->pml4, upage, frame->kva, false)) {
+		spt_remove_page (&curr->spt, page);
+		sema_up (&swap_sema);
+		return false;
+	}
+	sema_up (&swap_sema);
+	return true;
+
+fail_put:
+	share_put (entry);
+fail_free:
+	free (frame);
+	sema_up (&swap_sema);
+	free (page);
+	return false;
+}
+
+/* Makes the page that contains user address VA resident and pins
+ * it, so that its frame is not chosen for eviction until
+ * vm_unpin_page().  A missing page is brought in exactly as a fault
+ * on VA would bring it in.  If WRITE, the page must be writable.
+ * Returns false if VA is not valid for the access.
+ *
+ * The kernel pins user buffers before it takes file system locks.
+ * A fault taken while holding such a lock could otherwise evict a
+ * file-backed page and write it back through the very lock already
+ * held. */
+bool
+vm_pin_page (void *va, bool write) {
+	struct thread *curr = thread_current ();
+	struct supplemental_page_table *spt = &curr->spt;
+	void *upage = pg_round_down (va);
+
+	if (va == NULL || !is_user_vaddr (va))
+		return false;
+
+	for (;;) {
+		struct page *page = spt_find_page (spt, upage);
+		if (page == NULL) {
+			struct vma *vma = vma_find (spt, upage);
+			if (vma != NULL) {
+				if ((write && !vma->writable) || !vma_claim_page (vma, upage, write))
+					return false;
+			} else {
+				/* Below the stack: grow it as the fault handler would. */
+				void *old_bottom = curr->stack_bottom;
+				if (va < curr->curr_rsp - 8 || va >= USER_STACK
+						|| curr->stack_bottom < USER_STACK - stack_growth_limit + PGSIZE)
+					return false;
+				vm_stack_growth (va);
+				if (curr->stack_bottom == old_bottom)
+					return false;
+			}
+			continue;
+		}
+		if (write && !page->writable)
+			return false;
+		/* The kernel must not write to a frame other processes see. */
+		if (write && page_is_shared (page) && !vm_handle_wp (page))
+			return false;
+
+		/* Residency and the pin are checked and set together, under
+		 * the lock that eviction holds. */
+		sema_down (&swap_sema);
+		if (pml4_get_page (curr->pml4, upage) != NULL) {
+			page->pin_cnt++;
+			sema_up (&swap_sema);
+			return true;
+		}
+		sema_up (&swap_sema);
+		if (!vm_do_claim_page (page))
+			return false;
+	}
+}
+
+/* Releases a pin taken by vm_pin_page() on the page containing VA. */
+void
+vm_unpin_page (void *va) {
+	struct page *page = spt_find_page (&thread_current ()->spt, va);
+
+	ASSERT (page != NULL && page->pin_cnt > 0);
+	sema_down (&swap_sema);
+	page->pin_cnt--;
+	sema_up (&swap_sema);
+}
+
 /* Claim the PAGE and set up the mmu. */
 static bool
 vm_do_claim_page (struct page *page) {
 	sema_down(&swap_sema);
 	if(!vm_connect_page_frame(page)){
+		sema_up(&swap_sema);
 		return false;
 	}
 	struct frame *frame =page->frame;
@@ -282,7 +547,8 @@ vm_connect_page_frame(struct page *page){
 	struct frame *frame = vm_get_frame ();
 	struct thread *curr = thread_current ();
 	if(frame == NULL){
-		exit(-4);
+		/* Every frame is pinned.  The caller fails the access. */
+		return false;
 	}
 	/* Set links */
 	frame->page = page;
@@ -299,60 +565,85 @@ vm_connect_page_frame(struct page *page){
 /* Initialize new supplemental page table */
 void
 supplemental_page_table_init (struct supplemental_page_table *spt UNUSED) {
-	struct thread *curr = thread_current();
-	if (!hash_init(&spt->pages,page_hash,page_less,NULL)){
-		printf("빡종");
-		exit(-1);
-	}
+	spt->root = NULL;
+	vma_init (spt);
 }
 
 /* Copy supplemental page table from src to dst */
 bool
 supplemental_page_table_copy (struct supplemental_page_table *dst UNUSED,
 		struct supplemental_page_table *src UNUSED) {
+	/* Areas come first: copied pages point into the child's VMA files. */
+	if (!vma_copy (dst, src)){
+		return false;
+	}
+	return src->root == NULL
+		|| spt_walk (src->root, SPT_LEVELS - 1, spt_copy_page, dst);
+}
+
+/* Copies CP_PAGE of the parent into DST_, the child's table. */
+static bool
+spt_copy_page (struct page *cp_page, void *dst_) {
+	struct supplemental_page_table *dst = dst_;
 	bool success = true;
-	struct hash_iterator i;
-	
-   	hash_first (&i, &src->pages);
-   	while (hash_next (&i)){
-		struct page *cp_page = hash_entry (hash_cur (&i), struct page, spt_elem);
-		enum vm_type cp_type = cp_page->operations->type;
-		struct page *new_page = (struct page *)malloc(sizeof(struct page));
-		if(new_page == NULL){
-			exit(-13);
+	enum vm_type cp_type = cp_page->operations->type;
+	struct page *new_page = (struct page *)malloc(sizeof(struct page));
+	if(new_page == NULL){
+		return false;
+	}
+	memcpy(new_page,cp_page,sizeof(struct page));
+	new_page->frame = NULL;
+	new_page->thread = thread_current();
+	/* Pins, such as the parent's ring, stay with the parent. */
+	new_page->pin_cnt = 0;
+	if(!spt_insert_page(dst,new_page)){
+		free(new_page);
+		return false;
+	}
+	if(page_is_shared(cp_page)){
+		/* Text cache frames are mapped again, not copied, so a
+		 * forked data page stays shared until one side writes. */
+		sema_down(&swap_sema);
+		share_ref(new_page->share.entry);
+		sema_up(&swap_sema);
+		struct frame *frame = malloc(sizeof(struct frame));
+		if(frame == NULL){
+			return false;
 		}
-		memcpy(new_page,cp_page,sizeof(struct page));
-		new_page->frame = NULL;
-		new_page->thread = thread_current();
-		spt_insert_page(dst,new_page);
-		switch(VM_TYPE(cp_type)){
-			case VM_UNINIT:
-				success = uninit_duplicate_aux(cp_page,new_page);
-				if(!success){
+		frame->kva = cp_page->frame->kva;
+		frame->page = new_page;
+		new_page->frame = frame;
+		return pml4_set_page(new_page->thread->pml4,new_page->va,frame->kva,false);
+	}
+	switch(VM_TYPE(cp_type)){
+		case VM_UNINIT:
+			success = uninit_duplicate_aux(cp_page,new_page);
+			if(!success){
+				return false;
+			}
+			struct vma *uninit_vma = vma_find (dst, new_page->va);
+			if (uninit_vma != NULL && new_page->uninit.aux != NULL)
+				((struct load_info *) new_page->uninit.aux)->file = uninit_vma->file;
+			break;
+		case VM_ANON:
+			if(!(cp_type & VM_SWAP)){
+				if(!vm_connect_page_frame(new_page)){
 					return false;
 				}
-				break;
-			case VM_ANON:
-				if(!(cp_type & VM_SWAP)){
-					if(!vm_connect_page_frame(new_page)){
-						return false;
-					}
-					memcpy(new_page->frame->kva,cp_page->frame->kva,PGSIZE);
-				}
-				new_page->anon.fork_cnt += 1;
-				break;
-			case VM_FILE:
-				if(!(cp_type & VM_DISK)){
-					if(!vm_connect_page_frame(new_page)){
-						return false;
-					}
-					memcpy(new_page->frame->kva,cp_page->frame->kva,PGSIZE);
+				memcpy(new_page->frame->kva,cp_page->frame->kva,PGSIZE);
+			}
+			new_page->anon.fork_cnt += 1;
+			break;
+		case VM_FILE:
+			if(!(cp_type & VM_DISK)){
+				if(!vm_connect_page_frame(new_page)){
+					return false;
 				}
-				struct file *reopen_file = file_reopen(&cp_page->file.file);
-				struct file_page *file_page = &new_page->file;
-				file_page->file = reopen_file;
-				break;
-		}
+				memcpy(new_page->frame->kva,cp_page->frame->kva,PGSIZE);
+			}
+			struct file_page *file_page = &new_page->file;
+			file_page->file = vma_find (dst, new_page->va)->file;
+			break;
 	}
 	return success;
 }
@@ -362,32 +653,113 @@ void
 supplemental_page_table_kill (struct supplemental_page_table *spt UNUSED) {
 	/* TODO: Destroy all the supplemental_page_table hold by thread and
 	 * TODO: writeback all the modified contents to the storage. */
-	hash_clear(&spt->pages,hash_action_free);
+	if (spt->root != NULL){
+		spt_destroy (spt->root, SPT_LEVELS - 1);
+		spt->root = NULL;
+	}
+	/* File pages write back through their VMA's file, so the VMAs
+	 * go last. */
+	vma_kill (spt);
 }
 
-void hash_action_free (struct hash_elem *e,void *aux){
-	struct page *page = hash_entry(e,struct page,spt_elem);
-	sema_down(&swap_sema);
-	vm_dealloc_page(page);
-	sema_up(&swap_sema);
+/* Index of VA within a radix tree node at LEVEL; level 3 is the
+ * root and uses the PML4 bits, level 0 holds pages and uses the PT
+ * bits. */
+static inline size_t
+spt_index (const void *va, int level) {
+	return ((uint64_t) va >> (PTXSHIFT + 9 * level)) & 0x1FF;
 }
 
+/* Returns the leaf slot that holds the page for VA in SPT.  Missing
+ * nodes are allocated if CREATE is true; otherwise, or if allocation
+ * fails, returns NULL when the path does not exist. */
+static struct page **
+spt_slot (struct supplemental_page_table *spt, const void *va, bool create) {
+	void ***link = &spt->root;
+	int level;
+
+	for (level = SPT_LEVELS - 1; ; level--) {
+		if (*link == NULL) {
+			if (!create)
+				return NULL;
+			*link = palloc_get_page (PAL_ZERO);
+			if (*link == NULL)
+				return NULL;
+		}
+		if (level == 0)
+			return (struct page **) &(*link)[spt_index (va, 0)];
+		link = (void ***) &(*link)[spt_index (va, level)];
+	}
+}
 
-/* Returns a hash value for page p. */
-unsigned
-page_hash (const struct hash_elem *p_, void *aux UNUSED) {
-  const struct page *p = hash_entry (p_, struct page, spt_elem);
-  return hash_bytes (&p->va, sizeof p->va);
+/* Returns true if no slot of NODE is in use. */
+static bool
+spt_node_empty (void **node) {
+	size_t i;
+
+	for (i = 0; i < SPT_ENTRIES; i++)
+		if (node[i] != NULL)
+			return false;
+	return true;
 }
 
+/* Frees the nodes on the path to VA in SPT that hold nothing,
+ * starting from the lowest one and stopping at the first node that
+ * is still in use.  Scanning a node costs about as much as zeroing
+ * the page it would free, and only happens when a page goes away. */
+static void
+spt_prune (struct supplemental_page_table *spt, const void *va) {
+	void ***links[SPT_LEVELS];
+	void ***link = &spt->root;
+	int level;
+
+	for (level = SPT_LEVELS - 1; level >= 0 && *link != NULL; level--) {
+		links[level] = link;
+		if (level > 0)
+			link = (void ***) &(*link)[spt_index (va, level)];
+	}
+	for (level++; level < SPT_LEVELS && spt_node_empty (*links[level]);
+			level++) {
+		palloc_free_page (*links[level]);
+		*links[level] = NULL;
+	}
+}
 
-bool
-page_less (const struct hash_elem *a_,
-           const struct hash_elem *b_, void *aux UNUSED) {
-  const struct page *a = hash_entry (a_, struct page, spt_elem);
-  const struct page *b = hash_entry (b_, struct page, spt_elem);
+/* Calls ACTION for every page below NODE, a node at LEVEL, in
+ * increasing va order.  Returns false as soon as ACTION does. */
+static bool
+spt_walk (void **node, int level, spt_action_func *action, void *aux) {
+	size_t i;
+
+	for (i = 0; i < SPT_ENTRIES; i++) {
+		if (node[i] == NULL)
+			continue;
+		if (level == 0) {
+			if (!action (node[i], aux))
+				return false;
+		} else if (!spt_walk (node[i], level - 1, action, aux))
+			return false;
+	}
+	return true;
+}
 
-  return a->va < b->va;
+/* Deallocates every page below NODE, a node at LEVEL, and frees the
+ * nodes themselves. */
+static void
+spt_destroy (void **node, int level) {
+	size_t i;
+
+	for (i = 0; i < SPT_ENTRIES; i++) {
+		if (node[i] == NULL)
+			continue;
+		if (level == 0) {
+			sema_down(&swap_sema);
+			vm_dealloc_page(node[i]);
+			sema_up(&swap_sema);
+		} else
+			spt_destroy (node[i], level - 1);
+	}
+	palloc_free_page (node);
 }
 
 void vm_remove_frame(struct page *page){
@@ -0,0 +1,190 @@
+/* vma.c: Per-process virtual memory areas.
+ *
+ * A VMA describes a whole mapping (an ELF segment or an mmap
+ * region) instead of one `struct page' per 4 kB.  The backing file
+ * is reopened once per VMA rather than once per page, and pages are
+ * materialized lazily by vma_claim_page() when they fault. */
+
+#include "vm/vma.h"
+#include "vm/vm.h"
+#include "threads/malloc.h"
+#include "threads/pte.h"
+#include "threads/vaddr.h"
+#include "filesys/file.h"
+#include "userprog/process.h"
+
+static bool vma_less (const struct rb_elem *a_, const struct rb_elem *b_,
+		void *aux UNUSED);
+static void vma_free (struct rb_elem *e, void *aux UNUSED);
+
+/* Initializes the VMA tree of SPT. */
+void
+vma_init (struct supplemental_page_table *spt) {
+	rb_init (&spt->vmas, vma_less, NULL);
+}
+
+/* Creates a VMA covering LENGTH bytes (rounded up to whole pages)
+ * from START and inserts it into SPT.  The first READ_BYTES bytes
+ * are backed by FILE starting at OFFSET and the rest is zeroed.
+ * FILE, if non-null, is reopened so that the VMA holds its own
+ * reference.  Returns the new VMA, or NULL if the range overlaps an
+ * existing VMA or memory allocation fails. */
+struct vma *
+vma_create (struct supplemental_page_table *spt, void *start, size_t length,
+		enum vm_type type, struct file *file, off_t offset, size_t read_bytes,
+		bool writable) {
+	ASSERT (pg_ofs (start) == 0);
+	ASSERT (VM_TYPE (type) == VM_ANON || VM_TYPE (type) == VM_FILE);
+	ASSERT (!(type & VM_SHARED) || file != NULL);
+
+	void *end = pg_round_up (start + length);
+	if (length == 0 || vma_overlaps (spt, start, end))
+		return NULL;
+
+	struct vma *vma = malloc (sizeof *vma);
+	if (vma == NULL)
+		return NULL;
+	vma->start = start;
+	vma->end = end;
+	vma->type = type;
+	vma->offset = offset;
+	vma->read_bytes = read_bytes;
+	vma->writable = writable;
+	vma->file = NULL;
+	if (file != NULL) {
+		vma->file = file_reopen (file);
+		if (vma->file == NULL) {
+			free (vma);
+			return NULL;
+		}
+	}
+	rb_insert (&spt->vmas, &vma->elem);
+	return vma;
+}
+
+/* Returns the VMA of SPT that contains VA, or NULL if VA is not
+ * inside any VMA. */
+struct vma *
+vma_find (struct supplemental_page_table *spt, const void *va) {
+	struct vma key = { .start = (void *) va };
+	struct rb_elem *e;
+
+	e = rb_floor (&spt->vmas, &key.elem);
+	if (e != NULL) {
+		struct vma *vma = rb_entry (e, struct vma, elem);
+		if (va < vma->end)
+			return vma;
+	}
+	return NULL;
+}
+
+/* Returns true if any VMA of SPT intersects [START, END). */
+bool
+vma_overlaps (struct supplemental_page_table *spt, const void *start,
+		const void *end) {
+	struct vma key = { .start = (void *) start };
+	struct rb_elem *e;
+
+	/* The only candidates are the last VMA starting at or before
+	 * START and the first one starting after it. */
+	e = rb_floor (&spt->vmas, &key.elem);
+	if (e != NULL && rb_entry (e, struct vma, elem)->end > start)
+		return true;
+	e = rb_ceil (&spt->vmas, &key.elem);
+	return e != NULL && rb_entry (e, struct vma, elem)->start < end;
+}
+
+/* Removes VMA from SPT and releases it.  Pages already created
+ * for the VMA must have been removed from SPT by the caller. */
+void
+vma_destroy (struct supplemental_page_table *spt, struct vma *vma) {
+	rb_remove (&spt->vmas, &vma->elem);
+	vma_free (&vma->elem, NULL);
+}
+
+/* Copies every VMA of SRC into DST, reopening the backing files.
+ * Returns false if memory allocation fails. */
+bool
+vma_copy (struct supplemental_page_table *dst,
+		struct supplemental_page_table *src) {
+	struct rb_elem *e;
+
+	for (e = rb_first (&src->vmas); e != NULL; e = rb_next (e)) {
+		struct vma *vma = rb_entry (e, struct vma, elem);
+		if (vma_create (dst, vma->start, vma->end - vma->start, vma->type,
+					vma->file, vma->offset, vma->read_bytes,
+					vma->writable) == NULL)
+			return false;
+	}
+	return true;
+}
+
+/* Destroys every VMA of SPT. */
+void
+vma_kill (struct supplemental_page_table *spt) {
+	rb_clear (&spt->vmas, vma_free);
+}
+
+/* Creates the page at UPAGE inside VMA and claims a frame for it,
+ * for a write access if WRITE.  The page is filled by the usual lazy
+ * loaders, so it behaves exactly like a page set up eagerly by
+ * vm_alloc_page_with_initializer().  File contents of a VM_SHARED
+ * area are mapped from the text cache instead, unless the access
+ * writes. */
+bool
+vma_claim_page (struct vma *vma, void *upage, bool write) {
+	ASSERT (pg_ofs (upage) == 0);
+	ASSERT (upage >= vma->start && upage < vma->end);
+
+	/* Zero-filled anonymous memory that covers a whole aligned 2 MiB
+	 * region is mapped with a huge page when possible. */
+	void *huge = (void *) ((uint64_t) upage & ~(HUGE_PGSIZE - 1));
+	if (VM_TYPE (vma->type) == VM_ANON
+			&& huge >= vma->start && huge + HUGE_PGSIZE <= vma->end
+			&& (size_t) (huge - vma->start) >= vma->read_bytes
+			&& vm_claim_huge_page (huge, vma->writable))
+		return true;
+
+	size_t page_ofs = (size_t) (upage - vma->start);
+	size_t page_read_bytes = 0;
+	if (page_ofs < vma->read_bytes)
+		page_read_bytes = vma->read_bytes - page_ofs < PGSIZE
+			? vma->read_bytes - page_ofs : PGSIZE;
+
+	if ((vma->type & VM_SHARED) && page_read_bytes > 0 && !write)
+		return vm_claim_shared_page (upage, vma->file, vma->offset + page_ofs,
+				page_read_bytes, vma->writable);
+
+	struct load_info *load_info = malloc (sizeof *load_info);
+	if (load_info == NULL)
+		return false;
+	load_info->file = vma->file;
+	load_info->page_read_bytes = page_read_bytes;
+	load_info->page_zero_bytes = PGSIZE - page_read_bytes;
+	load_info->ofs = vma->offset + page_ofs;
+
+	vm_initializer *init = VM_TYPE (vma->type) == VM_FILE
+		? lazy_load_file_segment : lazy_load_segment;
+	if (!vm_alloc_page_with_initializer (vma->type & ~VM_SHARED, upage,
+				vma->writable, init, load_info)) {
+		free (load_info);
+		return false;
+	}
+	return vm_claim_page (upage);
+}
+
+static bool
+vma_less (const struct rb_elem *a_, const struct rb_elem *b_,
+		void *aux UNUSED) {
+	const struct vma *a = rb_entry (a_, struct vma, elem);
+	const struct vma *b = rb_entry (b_, struct vma, elem);
+
+	return a->start < b->start;
+}
+
+static void
+vma_free (struct rb_elem *e, void *aux UNUSED) {
+	struct vma *vma = rb_entry (e, struct vma, elem);
+	file_close (vma->file);
+	free (vma);
+}